@@ -0,0 +1,373 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AuditLog.h"
+
+#include "ItemDataAsset.h"
+
+#include <HAL/FileManager.h>
+#include <HAL/IConsoleManager.h>
+#include <HAL/Runnable.h>
+#include <HAL/RunnableThread.h>
+#include <Misc/DateTime.h>
+#include <Misc/FileHelper.h>
+#include <Misc/Paths.h>
+#include <Misc/ScopeLock.h>
+
+static TAutoConsoleVariable<int32> CVarAudit(
+	TEXT("UnrealInventory.Audit"),
+	0,
+	TEXT("Record every change to an inventory on the server to the audit files in Saved/Audit, read them with the InventoryAudit commandlet."));
+
+static_assert(FMath::IsPowerOfTwo(UnrealInventory::Audit::RingCapacity), "The ring capacity has to be a power of two");
+
+/** The transaction running on a thread. */
+struct FCAuditTransaction
+{
+	uint64 Id = 0;
+	ECAuditOp Op = ECAuditOp::None;
+};
+
+static thread_local FCAuditTransaction GAuditTransaction;
+static std::atomic<uint64> GNextAuditTransaction{1};
+
+/**
+ * Single producer single consumer ring, only the owning thread writes records and only the drain thread reads them.
+ */
+struct FCAuditLog::FCAuditRing
+{
+	FCAuditRecord Records[UnrealInventory::Audit::RingCapacity];
+
+	/** Kept on their own cache lines so the two threads don't fight over them. */
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> Head{0};
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> Tail{0};
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> Dropped{0};
+};
+
+/**
+ * Writes out what was recorded every drain interval.
+ */
+class FCAuditDrain : public FRunnable
+{
+public:
+	explicit FCAuditDrain(FCAuditLog& Log) : m_Log(Log) {}
+
+	virtual uint32 Run() override
+	{
+		while (!m_bStop.load(std::memory_order_relaxed))
+		{
+			m_Log.Drain();
+			FPlatformProcess::SleepNoStats(UnrealInventory::Audit::DrainInterval);
+		}
+
+		return 0;
+	}
+
+	virtual void Stop() override { m_bStop.store(true, std::memory_order_relaxed); }
+
+private:
+	FCAuditLog& m_Log;
+	std::atomic<bool> m_bStop{false};
+};
+
+const TCHAR* LexToString(const ECAuditOp Op)
+{
+	switch (Op)
+	{
+	case ECAuditOp::None:
+		return TEXT("None");
+	case ECAuditOp::Equip:
+		return TEXT("Equip");
+	case ECAuditOp::Drop:
+		return TEXT("Drop");
+	case ECAuditOp::Trade:
+		return TEXT("Trade");
+	case ECAuditOp::Loot:
+		return TEXT("Loot");
+	case ECAuditOp::Craft:
+		return TEXT("Craft");
+	case ECAuditOp::Pickup:
+		return TEXT("Pickup");
+	case ECAuditOp::Storage:
+		return TEXT("Storage");
+	case ECAuditOp::Command:
+		return TEXT("Command");
+	default:
+		return TEXT("Unknown");
+	}
+}
+
+FCAuditLog& FCAuditLog::Get()
+{
+	static FCAuditLog Log;
+	return Log;
+}
+
+bool FCAuditLog::IsEnabled()
+{
+	return CVarAudit.GetValueOnAnyThread() != 0;
+}
+
+void FCAuditLog::Record(FCAuditRecord Record)
+{
+	if (m_bShutdown.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	if (!m_bStarted.load(std::memory_order_acquire))
+	{
+		Start();
+	}
+
+	FCAuditRing* Ring = GetThreadRing();
+	if (Ring == nullptr)
+	{
+		return;
+	}
+
+	Record.Cycles = FPlatformTime::Cycles64();
+	Record.Transaction = GAuditTransaction.Id;
+	Record.Op = GAuditTransaction.Op;
+
+	// Never wait for the drain thread, losing a record is better than a hitch
+	const uint64 Head = Ring->Head.load(std::memory_order_relaxed);
+	if (Head - Ring->Tail.load(std::memory_order_acquire) >= UnrealInventory::Audit::RingCapacity)
+	{
+		Ring->Dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	Ring->Records[Head & (UnrealInventory::Audit::RingCapacity - 1)] = Record;
+	Ring->Head.store(Head + 1, std::memory_order_release);
+}
+
+uint32 FCAuditLog::GetNameId(const FString& Name)
+{
+	FScopeLock Lock(&m_NamesLock);
+
+	if (const uint32* Id = m_NameIds.Find(Name))
+	{
+		return *Id;
+	}
+
+	// 0 is left for no name
+	const uint32 Id = m_NameIds.Num() + 1;
+	m_NameIds.Add(Name, Id);
+	m_PendingNames.Emplace(Id, Name);
+
+	return Id;
+}
+
+uint32 FCAuditLog::GetDescriptorId(const UCItemDescriptorBase* ItemDescriptor)
+{
+	if (ItemDescriptor == nullptr)
+	{
+		return 0;
+	}
+
+	if (ItemDescriptor->m_AuditId == 0)
+	{
+		ItemDescriptor->m_AuditId = GetNameId(ItemDescriptor->GetPathName());
+	}
+
+	return ItemDescriptor->m_AuditId;
+}
+
+void FCAuditLog::Shutdown()
+{
+	FScopeLock Lock(&m_StartLock);
+
+	if (m_bShutdown.exchange(true))
+	{
+		return;
+	}
+
+	if (m_Thread != nullptr)
+	{
+		// Kill waits for the thread to finish so nothing else drains from here on
+		m_Thread->Kill(true);
+		delete m_Thread;
+		m_Thread = nullptr;
+
+		delete m_Drain;
+		m_Drain = nullptr;
+
+		Drain();
+
+		const uint64 Dropped = GetDroppedCount();
+		if (Dropped > 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%llu inventory audit records were dropped because they were recorded faster than they could be written"), Dropped);
+		}
+	}
+
+	m_File.Reset();
+}
+
+uint64 FCAuditLog::GetDroppedCount() const
+{
+	FScopeLock Lock(&m_RingsLock);
+
+	uint64 Dropped = 0;
+	for (const FCAuditRing* Ring : m_Rings)
+	{
+		Dropped += Ring->Dropped.load(std::memory_order_relaxed);
+	}
+
+	return Dropped;
+}
+
+bool FCAuditLog::BeginTransaction(const ECAuditOp Op)
+{
+	if (GAuditTransaction.Id != 0)
+	{
+		return false;
+	}
+
+	GAuditTransaction.Id = GNextAuditTransaction.fetch_add(1, std::memory_order_relaxed);
+	GAuditTransaction.Op = Op;
+
+	return true;
+}
+
+void FCAuditLog::EndTransaction()
+{
+	GAuditTransaction = FCAuditTransaction();
+}
+
+FCAuditLog::FCAuditRing* FCAuditLog::GetThreadRing()
+{
+	static thread_local FCAuditRing* GAuditRing = nullptr;
+
+	if (GAuditRing == nullptr)
+	{
+		// Rings are never freed, a thread that's gone simply leaves an empty ring behind
+		FCAuditRing* Ring = new FCAuditRing();
+
+		FScopeLock Lock(&m_RingsLock);
+		m_Rings.Add(Ring);
+		GAuditRing = Ring;
+	}
+
+	return GAuditRing;
+}
+
+void FCAuditLog::Start()
+{
+	FScopeLock Lock(&m_StartLock);
+
+	if (m_bStarted.load(std::memory_order_relaxed) || m_bShutdown.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	m_Directory = FPaths::ProjectSavedDir() / TEXT("Audit");
+	m_Session = FDateTime::UtcNow().ToString(TEXT("Inventory-%Y.%m.%d-%H.%M.%S"));
+	IFileManager::Get().MakeDirectory(*m_Directory, true);
+
+	OpenFile();
+
+	m_Drain = new FCAuditDrain(*this);
+	m_Thread = FRunnableThread::Create(m_Drain, TEXT("InventoryAuditDrain"), 0, TPri_BelowNormal);
+
+	m_bStarted.store(true, std::memory_order_release);
+}
+
+void FCAuditLog::Drain()
+{
+	{
+		FScopeLock Lock(&m_RingsLock);
+
+		for (FCAuditRing* Ring : m_Rings)
+		{
+			const uint64 Tail = Ring->Tail.load(std::memory_order_relaxed);
+			const uint64 Head = Ring->Head.load(std::memory_order_acquire);
+
+			for (uint64 i = Tail; i < Head; ++i)
+			{
+				m_DrainBuffer.Add(Ring->Records[i & (UnrealInventory::Audit::RingCapacity - 1)]);
+			}
+
+			Ring->Tail.store(Head, std::memory_order_release);
+		}
+	}
+
+	TArray<TPair<uint32, FString>> Names;
+	{
+		FScopeLock Lock(&m_NamesLock);
+		Names = MoveTemp(m_PendingNames);
+		m_PendingNames.Reset();
+	}
+
+	// Names go out before the records that use them
+	if (Names.Num() > 0)
+	{
+		FString Text;
+		for (const TPair<uint32, FString>& Name : Names)
+		{
+			Text += FString::Printf(TEXT("%08x\t%s\n"), Name.Key, *Name.Value);
+		}
+
+		const FString Path = m_Directory / (m_Session + UnrealInventory::Audit::NamesExtension);
+		FFileHelper::SaveStringToFile(Text, *Path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append);
+	}
+
+	if (m_DrainBuffer.Num() == 0 || !m_File.IsValid())
+	{
+		m_DrainBuffer.Reset();
+		return;
+	}
+
+	const int64 Bytes = m_DrainBuffer.Num() * static_cast<int64>(sizeof(FCAuditRecord));
+	if (m_FileSize + Bytes > UnrealInventory::Audit::MaxFileSize)
+	{
+		OpenFile();
+	}
+
+	if (m_File.IsValid())
+	{
+		m_File->Serialize(m_DrainBuffer.GetData(), Bytes);
+		m_File->Flush();
+		m_FileSize += Bytes;
+	}
+
+	m_DrainBuffer.Reset();
+}
+
+void FCAuditLog::OpenFile()
+{
+	m_File.Reset();
+
+	const FString Path = m_Directory / FString::Printf(TEXT("%s-%03d%s"), *m_Session, m_FileIndex++, UnrealInventory::Audit::FileExtension);
+	m_File.Reset(IFileManager::Get().CreateFileWriter(*Path, FILEWRITE_AllowRead));
+
+	if (!m_File.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Couldn't open %s, inventory audit records are lost until the next file"), *Path);
+		return;
+	}
+
+	FCAuditFileHeader Header;
+	Header.BaseCycles = FPlatformTime::Cycles64();
+	Header.BaseUtcTicks = FDateTime::UtcNow().GetTicks();
+	Header.SecondsPerCycle = FPlatformTime::GetSecondsPerCycle64();
+
+	m_File->Serialize(&Header, sizeof(Header));
+	m_FileSize = sizeof(Header);
+
+	DeleteOldFiles();
+}
+
+void FCAuditLog::DeleteOldFiles()
+{
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *(m_Directory / (FString(TEXT("*")) + UnrealInventory::Audit::FileExtension)), true, false);
+
+	// The names start with the date so they sort oldest first
+	Files.Sort();
+
+	for (int32 i = 0; i < Files.Num() - UnrealInventory::Audit::MaxFiles; ++i)
+	{
+		IFileManager::Get().Delete(*(m_Directory / Files[i]));
+	}
+}
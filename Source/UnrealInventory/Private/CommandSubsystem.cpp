@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CommandSubsystem.h"
+
+#include "InventoryComponent.h"
+
+#include <Engine/NetConnection.h>
+#include <Engine/World.h>
+
+int32 UCCommandSubsystem::QueueCommands(UCInventoryComponent* Inventory, TArrayView<const FCInventoryCommand> Commands)
+{
+	if (Inventory == nullptr || Commands.Num() == 0 || !Inventory->GetOwner()->HasAuthority())
+	{
+		return 0;
+	}
+
+	const int32 Room = FMath::Max(0, m_MaxQueuedCommands - Inventory->m_QueuedCommands.Num());
+	int32 Count = FMath::Min(Commands.Num(), Room);
+
+	// Commands from the server itself aren't limited
+	if (const UNetConnection* Connection = Inventory->GetOwner()->GetNetConnection())
+	{
+		Count = TakeTokens(Connection, Count);
+	}
+
+	if (Count < Commands.Num())
+	{
+		UE_LOG(LogTemp, Verbose, TEXT("Dropped %d inventory commands for %s, the connection is sending them too fast"), Commands.Num() - Count, *Inventory->GetPathName());
+	}
+
+	if (Count == 0)
+	{
+		return 0;
+	}
+
+	if (Inventory->m_QueuedCommands.Num() == 0)
+	{
+		m_PendingInventories.Add(Inventory);
+	}
+
+	Inventory->m_QueuedCommands.Append(Commands.GetData(), Count);
+	return Count;
+}
+
+void UCCommandSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Move the inventories out first so commands queued while applying wait for the next frame
+	const TArray<TWeakObjectPtr<UCInventoryComponent>> Inventories = MoveTemp(m_PendingInventories);
+	m_PendingInventories.Reset();
+
+	for (const TWeakObjectPtr<UCInventoryComponent>& Inventory : Inventories)
+	{
+		if (Inventory.IsValid())
+		{
+			Inventory->ApplyQueuedCommands();
+		}
+	}
+
+	// Forget the buckets of connections that closed
+	for (auto It = m_Buckets.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+TStatId UCCommandSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCCommandSubsystem, STATGROUP_Tickables);
+}
+
+bool UCCommandSubsystem::IsTickable() const
+{
+	return Super::IsTickable() && m_PendingInventories.Num() > 0;
+}
+
+bool UCCommandSubsystem::DoesSupportWorldType(EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+int32 UCCommandSubsystem::TakeTokens(const UNetConnection* Connection, const int32 Count)
+{
+	const double Now = GetWorld()->GetRealTimeSeconds();
+
+	FCTokenBucket* Bucket = m_Buckets.Find(Connection);
+	if (Bucket == nullptr)
+	{
+		// New connections start with a full bucket
+		Bucket = &m_Buckets.Add(Connection, {static_cast<float>(m_CommandBurst), Now});
+	}
+
+	Bucket->Tokens = FMath::Min(Bucket->Tokens + static_cast<float>(Now - Bucket->LastRefillTime) * m_CommandsPerSecond, static_cast<float>(m_CommandBurst));
+	Bucket->LastRefillTime = Now;
+
+	const int32 Taken = FMath::Clamp(FMath::FloorToInt(Bucket->Tokens), 0, Count);
+	Bucket->Tokens -= Taken;
+
+	return Taken;
+}
@@ -0,0 +1,313 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Crafting.h"
+
+#include "InventoryComponent.h"
+
+FCCraftingContext::FCCraftingContext(TArrayView<UCInventoryComponent* const> Inventories)
+{
+	m_Inventories.Append(Inventories.GetData(), Inventories.Num());
+}
+
+FCCraftingContext::FCStackRefs& FCCraftingContext::FindStacks(const UCItemDescriptorBase* ItemDescriptor) const
+{
+	if (FCStackRefs* Stacks = m_Stacks.Find(ItemDescriptor))
+	{
+		return *Stacks;
+	}
+
+	// Only the stacks of this descriptor are looked at so resolving a recipe never has to scan the inventories
+	FCStackRefs& Stacks = m_Stacks.Add(ItemDescriptor);
+
+	for (int32 InventoryIndex = 0; InventoryIndex < m_Inventories.Num(); ++InventoryIndex)
+	{
+		const UCInventoryComponent* Inventory = m_Inventories[InventoryIndex];
+		if (Inventory == nullptr || ItemDescriptor == nullptr)
+		{
+			continue;
+		}
+
+		const TArray<FCItem>& Items = Inventory->GetInventory();
+		for (const int32 ItemIndex : Inventory->GetStackIndices(ItemDescriptor))
+		{
+			const FCItem& Item = Items[ItemIndex];
+			if (Item.IsItemValid())
+			{
+				Stacks.Add({InventoryIndex, ItemIndex, Item.Rarity, Item.Quantity, 0});
+			}
+		}
+	}
+
+	return Stacks;
+}
+
+int32 FCCraftingContext::GetAvailableQuantity(const FCItemConsumable& Consumable) const
+{
+	int32 Quantity = 0;
+
+	for (const FCStackRef& Stack : FindStacks(Consumable.ItemDescriptor))
+	{
+		if (Stack.Rarity >= Consumable.MinRarity)
+		{
+			Quantity += Stack.Available - Stack.Consumed;
+		}
+	}
+
+	return Quantity;
+}
+
+int32 FCCraftingContext::GetMaxCraftCount(const UCItemRecipe& Recipe) const
+{
+	int32 MaxCount = MAX_int32;
+
+	for (const FCItemConsumable& Input : Recipe.GetInputs())
+	{
+		if (Input.Quantity > 0)
+		{
+			MaxCount = FMath::Min(MaxCount, GetAvailableQuantity(Input) / Input.Quantity);
+		}
+	}
+
+	return MaxCount == MAX_int32 ? 0 : MaxCount;
+}
+
+bool FCCraftingContext::Consume(TArrayView<const FCItemConsumable> ConsumedItems, const int32 Count, TArray<FCItem>* OutConsumed)
+{
+	if (Count <= 0)
+	{
+		return false;
+	}
+
+	struct FCTakenAmount
+	{
+		FCStackRef* Stack;
+		int32 Quantity;
+	};
+
+	TArray<FCTakenAmount, TInlineAllocator<16>> Taken;
+
+	// Gather every descriptor up front, adding to m_Stacks while taking could move the stacks already taken from
+	for (const FCItemConsumable& Consumable : ConsumedItems)
+	{
+		FindStacks(Consumable.ItemDescriptor);
+	}
+
+	for (const FCItemConsumable& Consumable : ConsumedItems)
+	{
+		FCStackRefs& Stacks = FindStacks(Consumable.ItemDescriptor);
+		int32 Remaining = Consumable.Quantity * Count;
+
+		// Take from the last stacks first so removing emptied stacks shifts as little as possible
+		for (int32 i = Stacks.Num() - 1; i >= 0 && Remaining > 0; --i)
+		{
+			FCStackRef& Stack = Stacks[i];
+			if (Stack.Rarity < Consumable.MinRarity)
+			{
+				continue;
+			}
+
+			const int32 AmountToTake = FMath::Min(Remaining, Stack.Available - Stack.Consumed);
+			if (AmountToTake > 0)
+			{
+				Stack.Consumed += AmountToTake;
+				Remaining -= AmountToTake;
+				Taken.Add({&Stack, AmountToTake});
+			}
+		}
+
+		if (Remaining > 0)
+		{
+			// Not enough, give back everything taken so far
+			for (const FCTakenAmount& Amount : Taken)
+			{
+				Amount.Stack->Consumed -= Amount.Quantity;
+			}
+
+			return false;
+		}
+	}
+
+	if (OutConsumed != nullptr)
+	{
+		for (const FCTakenAmount& Amount : Taken)
+		{
+			FCItem& ConsumedItem = OutConsumed->Add_GetRef(m_Inventories[Amount.Stack->InventoryIndex]->GetInventory()[Amount.Stack->ItemIndex]);
+			ConsumedItem.Quantity = Amount.Quantity;
+		}
+	}
+
+	m_bHasConsumed = true;
+
+	return true;
+}
+
+int32 FCCraftingContext::Craft(const UCItemRecipe& Recipe, const int32 MaxCount)
+{
+	const int32 PossibleCount = GetMaxCraftCount(Recipe);
+	const int32 Count = MaxCount == INDEX_NONE ? PossibleCount : FMath::Min(MaxCount, PossibleCount);
+
+	if (Count <= 0 || !Consume(Recipe.GetInputs(), Count))
+	{
+		return 0;
+	}
+
+	for (const FCItem& Output : Recipe.GetOutputs())
+	{
+		AddOutput(Output, Count);
+	}
+
+	return Count;
+}
+
+void FCCraftingContext::AddOutput(const FCItem& Item, const int32 Count)
+{
+	if (!Item.IsItemValid() || Count <= 0)
+	{
+		return;
+	}
+
+	// Outputs that stack are merged so AddItem only has to find the existing stacks once
+	if (Item.Score == INDEX_NONE)
+	{
+		if (FCItem* ExistingOutput = m_Outputs.FindByPredicate([&Item](const FCItem& Other) { return Other == Item && Other.Score == INDEX_NONE; }))
+		{
+			ExistingOutput->Quantity += Item.Quantity * Count;
+			return;
+		}
+
+		FCItem& Output = m_Outputs.Add_GetRef(Item);
+		Output.Quantity *= Count;
+		return;
+	}
+
+	for (int32 i = 0; i < Count; ++i)
+	{
+		m_Outputs.Add(Item);
+	}
+}
+
+bool FCCraftingContext::Commit()
+{
+	if (m_Inventories.Num() == 0 || m_Inventories[0] == nullptr)
+	{
+		return false;
+	}
+
+	// Gather what to remove per inventory
+	TArray<TArray<TPair<int32, int32>>, TInlineAllocator<4>> Removals;
+	Removals.SetNum(m_Inventories.Num());
+
+	if (m_bHasConsumed)
+	{
+		for (const auto& Pair : m_Stacks)
+		{
+			for (const FCStackRef& Stack : Pair.Value)
+			{
+				if (Stack.Consumed > 0)
+				{
+					Removals[Stack.InventoryIndex].Emplace(Stack.ItemIndex, Stack.Consumed);
+				}
+			}
+		}
+	}
+
+	// Only the outputs can fail, so keep a copy of every inventory that loses items if there are any so everything can be restored.
+	// The output inventory only needs one if it loses items too, otherwise the outputs only top up its stacks and add new ones after them
+	const bool bNeedsSnapshots = m_Outputs.Num() > 0;
+
+	TArray<TArray<FCItem>, TInlineAllocator<4>> Snapshots;
+	Snapshots.SetNum(m_Inventories.Num());
+
+	for (int32 i = 0; i < m_Inventories.Num(); ++i)
+	{
+		if (bNeedsSnapshots && m_Inventories[i] != nullptr && Removals[i].Num() > 0)
+		{
+			Snapshots[i] = m_Inventories[i]->m_Inventory;
+		}
+	}
+
+	for (int32 i = 0; i < m_Inventories.Num(); ++i)
+	{
+		// Remove from the back so the indices of the remaining stacks stay valid
+		Removals[i].Sort([](const TPair<int32, int32>& A, const TPair<int32, int32>& B) { return A.Key > B.Key; });
+
+		for (const TPair<int32, int32>& Removal : Removals[i])
+		{
+			m_Inventories[i]->RemoveFromIndex(Removal.Key, Removal.Value);
+		}
+	}
+
+	UCInventoryComponent* OutputInventory = m_Inventories[0];
+	const bool bHasOutputSnapshot = Removals[0].Num() > 0;
+	const int32 FirstNewStack = OutputInventory->m_Inventory.Num();
+
+	TArray<TPair<int32, FCItem>, TInlineAllocator<8>> ToppedUpStacks;
+	if (!bHasOutputSnapshot)
+	{
+		for (const FCItem& Output : m_Outputs)
+		{
+			if (Output.Score != INDEX_NONE)
+			{
+				continue;
+			}
+
+			for (const int32 Index : OutputInventory->GetStackIndices(Output.ItemDescriptor))
+			{
+				const FCItem& Stack = OutputInventory->m_Inventory[Index];
+				if (Stack == Output && Stack.Score == INDEX_NONE && Stack.Quantity < Stack.ItemDescriptor->GetStackSize())
+				{
+					ToppedUpStacks.Emplace(Index, Stack);
+				}
+			}
+		}
+	}
+
+	for (const FCItem& Output : m_Outputs)
+	{
+		if (!OutputInventory->AddItem(Output))
+		{
+			if (!bHasOutputSnapshot)
+			{
+				RestoreOutputs(FirstNewStack, ToppedUpStacks);
+			}
+
+			for (int32 i = 0; i < m_Inventories.Num(); ++i)
+			{
+				if (m_Inventories[i] != nullptr && Removals[i].Num() > 0)
+				{
+					m_Inventories[i]->RestoreInventory(Snapshots[i]);
+				}
+			}
+
+			return false;
+		}
+	}
+
+	m_Stacks.Reset();
+	m_Outputs.Reset();
+	m_bHasConsumed = false;
+
+	return true;
+}
+
+void FCCraftingContext::RestoreOutputs(const int32 FirstNewStack, TArrayView<const TPair<int32, FCItem>> ToppedUpStacks)
+{
+	UCInventoryComponent* OutputInventory = m_Inventories[0];
+
+	// New stacks go first while the stacks before them are still where they were
+	for (int32 i = OutputInventory->m_Inventory.Num() - 1; i >= FirstNewStack; --i)
+	{
+		OutputInventory->RemoveFromIndex(i, OutputInventory->m_Inventory[i].Quantity);
+	}
+
+	for (const TPair<int32, FCItem>& ToppedUpStack : ToppedUpStacks)
+	{
+		FCItem& Stack = OutputInventory->m_Inventory[ToppedUpStack.Key];
+		if (!Stack.IsNetIdentical(ToppedUpStack.Value))
+		{
+			const FCItem OldItem = Stack;
+			Stack = ToppedUpStack.Value;
+			OutputInventory->NotifyItemReplaced(ToppedUpStack.Key, OldItem, Stack);
+		}
+	}
+}
@@ -2,11 +2,61 @@
 
 #include "InventoryComponent.h"
 
+#include "AuditLog.h"
+#include "CommandSubsystem.h"
 #include "Item.h"
-
+#include "ItemValuation.h"
+#include "LootOptimizer.h"
+#include "NetProfiler.h"
+#include "PickupSubsystem.h"
+#include "ProcessingSubsystem.h"
+#include "StorageComponent.h"
+
+#include <Algo/Sort.h>
+#include <Algo/StableSort.h>
+#include <Engine/NetDriver.h>
+#include <GameFramework/Pawn.h>
 #include <GameFramework/PlayerController.h>
-#include <Kismet/KismetMathLibrary.h>
+#include <GameFramework/PlayerState.h>
+#include <Net/Core/PushModel/PushModel.h>
 #include <Net/UnrealNetwork.h>
+#include <TimerManager.h>
+
+bool FCInventoryCommand::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	uint8 TypeValue = static_cast<uint8>(Type);
+	uint8 SlotValue = static_cast<uint8>(Slot);
+	uint8 TargetSlotValue = static_cast<uint8>(TargetSlot);
+
+	// Enums are sent with just enough bits for their largest value
+	Ar.SerializeBits(&TypeValue, 3);
+	Ar.SerializeBits(&SlotValue, 5);
+	Ar.SerializeBits(&TargetSlotValue, 5);
+
+	// INDEX_NONE is common so everything is offset by one to keep it in a single byte
+	uint32 PackedIndex = static_cast<uint32>(Index + 1);
+	uint32 PackedTargetIndex = static_cast<uint32>(TargetIndex + 1);
+	uint32 PackedQuantity = static_cast<uint32>(Quantity + 1);
+
+	Ar.SerializeIntPacked(PackedIndex);
+	Ar.SerializeIntPacked(PackedTargetIndex);
+	Ar.SerializeIntPacked(PackedQuantity);
+
+	if (Ar.IsLoading())
+	{
+		// Out of range values are rejected when the command is applied
+		Type = static_cast<ECInventoryCommandType>(FMath::Min<uint8>(TypeValue, static_cast<uint8>(ECInventoryCommandType::MAX)));
+		Slot = static_cast<ECItemSlot>(FMath::Min<uint8>(SlotValue, static_cast<uint8>(ECItemSlot::MAX)));
+		TargetSlot = static_cast<ECItemSlot>(FMath::Min<uint8>(TargetSlotValue, static_cast<uint8>(ECItemSlot::MAX)));
+
+		Index = static_cast<int32>(PackedIndex) - 1;
+		TargetIndex = static_cast<int32>(PackedTargetIndex) - 1;
+		Quantity = static_cast<int32>(PackedQuantity) - 1;
+	}
+
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
 
 UCInventoryComponent::UCInventoryComponent()
 {
@@ -20,15 +70,143 @@ void UCInventoryComponent::BeginPlay()
 	Super::BeginPlay();
 
 	// Reserve some memory for the inventory ahead of time to avoid a ton of allocations later
-	m_Inventory.Reserve(UnrealInventory::Items::DefaultArrayItemReserveSize);
+	switch (m_ReservePolicy)
+	{
+	case ECInventoryReservePolicy::Default:
+		m_Inventory.Reserve(FMath::Min(m_MaxItems, UnrealInventory::Items::DefaultArrayItemReserveSize));
+		break;
+	case ECInventoryReservePolicy::ExactCapacity:
+		m_Inventory.Reserve(m_MaxItems);
+		break;
+	case ECInventoryReservePolicy::Lazy:
+		break;
+	}
+
+	if (m_GenerationSeed == 0)
+	{
+		m_GenerationSeed = static_cast<int32>(UnrealInventory::Random::NewSeed());
+	}
 }
 
 void UCInventoryComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-	DOREPLIFETIME_CONDITION(UCInventoryComponent, m_EquippableInventory, COND_OwnerOnly);
-	DOREPLIFETIME_CONDITION(UCInventoryComponent, m_Inventory, COND_OwnerOnly);
+	// Everything is push based so idle inventories are never compared, every mutation has to mark the property dirty
+	FDoRepLifetimeParams Params;
+	Params.bIsPushBased = true;
+	Params.Condition = COND_OwnerOnly;
+
+	DOREPLIFETIME_WITH_PARAMS(UCInventoryComponent, m_EquippableInventory, Params);
+	DOREPLIFETIME_WITH_PARAMS(UCInventoryComponent, m_Inventory, Params);
+
+	// Processing stations are usually not owned by anyone so everyone gets the progress
+	Params.Condition = COND_None;
+	DOREPLIFETIME_WITH_PARAMS(UCInventoryComponent, m_ProcessingJobs, Params);
+}
+
+void UCInventoryComponent::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+	// Paged inventories send pages to each viewer instead, so don't even compare the arrays
+	const bool bReplicateInventory = !UsesPagedReplication();
+	DOREPLIFETIME_ACTIVE_OVERRIDE(UCInventoryComponent, m_EquippableInventory, bReplicateInventory);
+	DOREPLIFETIME_ACTIVE_OVERRIDE(UCInventoryComponent, m_Inventory, bReplicateInventory);
+
+	if (bReplicateInventory && FCNetProfiler::IsEnabled())
+	{
+		ProfileReplication();
+	}
+
+	if (UnrealInventory::Net::ShouldValidatePushModel())
+	{
+		ValidatePushModel();
+	}
+}
+
+void UCInventoryComponent::FlushOwnerDormancy()
+{
+	// Dormant owners such as storage nobody is looking at have to be woken up for a change to be sent
+	AActor* Owner = GetOwner();
+	if (Owner != nullptr && Owner->NetDormancy > DORM_Awake && Owner->HasAuthority())
+	{
+		Owner->FlushNetDormancy();
+	}
+}
+
+void UCInventoryComponent::ValidatePushModel()
+{
+	const uint32 InventoryHash = UnrealInventory::Net::GetReplicatedHash(m_Inventory);
+	const uint32 EquippableInventoryHash = UnrealInventory::Net::GetReplicatedHash(MakeArrayView(m_EquippableInventory));
+
+	uint32 ProcessingJobsHash = GetTypeHash(m_ProcessingJobs.Num());
+	for (const FCProcessingJob& Job : m_ProcessingJobs)
+	{
+		ProcessingJobsHash = HashCombine(ProcessingJobsHash, HashCombine(GetTypeHash(Job.JobId), GetTypeHash(Job.Remaining)));
+		ProcessingJobsHash = HashCombine(ProcessingJobsHash, HashCombine(GetTypeHash(Job.StartTime), GetTypeHash(Job.EndTime)));
+		ProcessingJobsHash = HashCombine(ProcessingJobsHash, PointerHash(Job.Recipe));
+	}
+
+	// There's nothing to compare against on the first net update
+	if (m_bPushModelValidated)
+	{
+		const auto Validate = [this](const uint32 Hash, const uint32 ValidatedHash, const bool bMarkedDirty, const TCHAR* PropertyName)
+		{
+			if (Hash != ValidatedHash && !bMarkedDirty)
+			{
+				UE_LOG(LogTemp, Error, TEXT("%s changed %s without marking it dirty, it won't replicate until something else does"), *GetPathName(), PropertyName);
+			}
+		};
+
+		Validate(InventoryHash, m_ValidatedInventoryHash, m_bInventoryMarkedDirty, TEXT("m_Inventory"));
+		Validate(EquippableInventoryHash, m_ValidatedEquippableInventoryHash, m_bEquippableInventoryMarkedDirty, TEXT("m_EquippableInventory"));
+		Validate(ProcessingJobsHash, m_ValidatedProcessingJobsHash, m_bProcessingJobsMarkedDirty, TEXT("m_ProcessingJobs"));
+	}
+
+	m_ValidatedInventoryHash = InventoryHash;
+	m_ValidatedEquippableInventoryHash = EquippableInventoryHash;
+	m_ValidatedProcessingJobsHash = ProcessingJobsHash;
+	m_bPushModelValidated = true;
+
+	m_bInventoryMarkedDirty = false;
+	m_bEquippableInventoryMarkedDirty = false;
+	m_bProcessingJobsMarkedDirty = false;
+}
+
+void UCInventoryComponent::MarkInventoryDirty(const ECItemSlot Slot)
+{
+	if (!UsesPagedReplication())
+	{
+		FlushOwnerDormancy();
+	}
+
+	if (Slot == ECItemSlot::None)
+	{
+		MARK_PROPERTY_DIRTY_FROM_NAME(UCInventoryComponent, m_Inventory, this);
+		m_bInventoryMarkedDirty = true;
+	}
+	else if (Slot < ECItemSlot::MAX)
+	{
+		// Only the slot that changed is compared
+		MARK_PROPERTY_DIRTY_FROM_NAME_STATIC_ARRAY_INDEX(UCInventoryComponent, m_EquippableInventory, static_cast<uint8>(Slot), this);
+		m_bEquippableInventoryMarkedDirty = true;
+	}
+}
+
+void UCInventoryComponent::ProfileReplication()
+{
+	FCNetProfiler& Profiler = FCNetProfiler::Get();
+
+	if (const UNetDriver* NetDriver = GetNetDriver())
+	{
+		Profiler.SampleConnections(NetDriver->ClientConnections.Num());
+	}
+
+	// Both arrays only replicate to the owner
+	const FName ClassName = GetClass()->GetFName();
+	Profiler.ProfileItems(ClassName, GET_MEMBER_NAME_CHECKED(UCInventoryComponent, m_Inventory), m_Inventory, m_ProfiledInventory, true);
+	Profiler.ProfileItems(ClassName, GET_MEMBER_NAME_CHECKED(UCInventoryComponent, m_EquippableInventory), MakeArrayView(m_EquippableInventory), m_ProfiledEquippableInventory, false);
 }
 
 bool UCInventoryComponent::AddItem(const FCItem& Item, const ECItemSlot Slot)
@@ -39,11 +217,22 @@ bool UCInventoryComponent::AddItem(const FCItem& Item, const ECItemSlot Slot)
 		return false;
 	}
 
+	// Swapping out an equipped item is two changes that belong together
+	FCAuditScope AuditScope(Slot != ECItemSlot::None ? ECAuditOp::Equip : ECAuditOp::None);
+
 	if (!CanAddItemToSlot(Item.ItemDescriptor, Slot))
 	{
 		return false;
 	}
 
+	// Items start decaying once they're in an inventory
+	if (Item.Health >= 0.0f && Item.HealthTimestamp < 0.0f)
+	{
+		FCItem StampedItem = Item;
+		StampedItem.HealthTimestamp = UCItemStatics::GetServerTime(this);
+		return AddItem(StampedItem, Slot);
+	}
+
 	// Just add the item to the inventory
 	if (Slot == ECItemSlot::None)
 	{
@@ -54,7 +243,24 @@ bool UCInventoryComponent::AddItem(const FCItem& Item, const ECItemSlot Slot)
 			const TArray<UCInventoryComponent::FCItemLocation> ExistingItems = FindItemLocation(Item.ItemDescriptor);
 
 			int32 Quantity = Item.Quantity;
-			const int32 MaxQuantity = Item.ItemDescriptor->GetStackSize();
+			const int32 MaxQuantity = FMath::Max(1, Item.ItemDescriptor->GetStackSize());
+
+			// Work out how many new stacks are needed before anything changes, an add that doesn't fit leaves the inventory alone
+			int32 FreeRoom = 0;
+			for (const auto& ItemLocation : ExistingItems)
+			{
+				const FCItem& ExistingItem = m_Inventory[ItemLocation.Index];
+				if (ExistingItem.Rarity == Item.Rarity && ExistingItem.Score == INDEX_NONE)
+				{
+					FreeRoom += FMath::Max(0, MaxQuantity - ExistingItem.Quantity);
+				}
+			}
+
+			const int32 AmountOfItemsToCreate = FMath::DivideAndRoundUp(FMath::Max(0, Quantity - FreeRoom), MaxQuantity);
+			if (m_Inventory.Num() + AmountOfItemsToCreate > GetMaxItems())
+			{
+				return false;
+			}
 
 			for (const auto& ItemLocation : ExistingItems)
 			{
@@ -82,6 +288,8 @@ bool UCInventoryComponent::AddItem(const FCItem& Item, const ECItemSlot Slot)
 					ExistingItem.Quantity = NewQuantity;
 					Quantity -= AmountToAdd;
 
+					NotifyChange(ECInventoryChangeType::Changed, ECItemSlot::None, ItemLocation.Index, ExistingItem, AmountToAdd);
+
 					if (Quantity <= 0)
 					{
 						return true;
@@ -89,11 +297,9 @@ bool UCInventoryComponent::AddItem(const FCItem& Item, const ECItemSlot Slot)
 				}
 			}
 
-			// Create multiple new items in the inventory
-			if (Quantity > 0 && Quantity > MaxQuantity)
+			// Create new stacks for whatever didn't fit into the existing stacks
+			if (Quantity > 0)
 			{
-				const int32 AmountOfItemsToCreate = UKismetMathLibrary::FCeil(Quantity / (float)MaxQuantity);
-
 				for (int32 i = 0; i < AmountOfItemsToCreate; ++i)
 				{
 					if (Quantity <= 0)
@@ -109,21 +315,37 @@ bool UCInventoryComponent::AddItem(const FCItem& Item, const ECItemSlot Slot)
 					FCItem CopiedItem = Item;
 					CopiedItem.Quantity = AmountToAdd;
 
-					m_Inventory.Emplace(CopiedItem);
+					const int32 Index = m_Inventory.Emplace(CopiedItem);
+					NotifyChange(ECInventoryChangeType::Added, ECItemSlot::None, Index, CopiedItem, AmountToAdd);
 				}
 
 				return true;
 			}
 		}
 
-		return m_Inventory.Emplace(Item) != INDEX_NONE;
+		const int32 Index = m_Inventory.Emplace(Item);
+		NotifyChange(ECInventoryChangeType::Added, ECItemSlot::None, Index, Item, Item.Quantity);
+
+		return Index != INDEX_NONE;
 	}
 	else if (HasItemInEquippableSlot(Slot))
 	{
 		// if the item is in an equippable slot then we should replace the item in the slot
 		FCItem& ItemToMove = m_EquippableInventory[static_cast<uint8>(Slot)];
-		m_Inventory.Emplace(ItemToMove);
+		const int32 Index = m_Inventory.Emplace(ItemToMove);
+		NotifyChange(ECInventoryChangeType::Added, ECItemSlot::None, Index, ItemToMove, ItemToMove.Quantity);
+
 		ItemToMove = Item;
+		NotifyChange(ECInventoryChangeType::Equipped, Slot, INDEX_NONE, ItemToMove, ItemToMove.Quantity);
+
+		return true;
+	}
+	else if (Slot < ECItemSlot::MAX)
+	{
+		// The slot is empty so just equip the item
+		FCItem& EquippedItem = m_EquippableInventory[static_cast<uint8>(Slot)];
+		EquippedItem = Item;
+		NotifyChange(ECInventoryChangeType::Equipped, Slot, INDEX_NONE, EquippedItem, EquippedItem.Quantity);
 
 		return true;
 	}
@@ -131,269 +353,1678 @@ bool UCInventoryComponent::AddItem(const FCItem& Item, const ECItemSlot Slot)
 	return false;
 }
 
-bool UCInventoryComponent::RemoveItem(const FCItem& Item, const int32 Quantity, const ECItemSlot Slot)
+int32 UCInventoryComponent::AddItems(const TArray<FCItem>& Items, TArray<FCItem>& OutRemaining)
 {
+	OutRemaining.Reset();
+
 	if (!GetOwner()->HasAuthority())
 	{
-		UE_LOG(LogTemp, Warning, TEXT("You can't remove an item from the inventory without authority"));
-		return false;
+		UE_LOG(LogTemp, Warning, TEXT("You can't add items to the inventory without authority"));
+		OutRemaining = Items;
+		return 0;
 	}
 
-	return false;
+	// Merge the stackable items first so the existing stacks are only searched once per descriptor and rarity
+	TArray<FCItem> MergedItems;
+	MergedItems.Reserve(Items.Num());
+
+	TMap<TPair<const UCItemDescriptorBase*, ECItemRarity>, int32> StackableItems;
+
+	for (const auto& Item : Items)
+	{
+		if (!Item.IsItemValid())
+		{
+			continue;
+		}
+
+		if (Item.Score != INDEX_NONE)
+		{
+			MergedItems.Add(Item);
+			continue;
+		}
+
+		const TPair<const UCItemDescriptorBase*, ECItemRarity> Key(Item.ItemDescriptor, Item.Rarity);
+		if (const int32* MergedIndex = StackableItems.Find(Key))
+		{
+			MergedItems[*MergedIndex].Quantity += Item.Quantity;
+		}
+		else
+		{
+			StackableItems.Add(Key, MergedItems.Add(Item));
+		}
+	}
+
+	int32 AddedCount = 0;
+	for (const auto& Item : MergedItems)
+	{
+		if (AddItem(Item))
+		{
+			++AddedCount;
+		}
+		else
+		{
+			OutRemaining.Add(Item);
+		}
+	}
+
+	return AddedCount;
 }
 
-bool UCInventoryComponent::DropItem(FCItem& Item, const int32 Quantity)
+bool UCInventoryComponent::RemoveItem(const FCItem& Item, const int32 Quantity, const ECItemSlot Slot)
 {
 	if (!GetOwner()->HasAuthority())
 	{
-		UE_LOG(LogTemp, Warning, TEXT("You can't drop an item from the inventory without authority"));
+		UE_LOG(LogTemp, Warning, TEXT("You can't remove an item from the inventory without authority"));
 		return false;
 	}
 
-	if (!Item.IsItemValid())
+	if (!Item.IsItemValid() || Quantity <= 0)
 	{
 		return false;
 	}
 
-	if (ACItemActor* Pickup = CreatePickup(Item, Quantity))
+	if (Slot != ECItemSlot::None)
 	{
-		if (Quantity == INDEX_NONE || Quantity >= Item.Quantity)
+		FCItem& EquippedItem = m_EquippableInventory[static_cast<uint8>(Slot)];
+		if (!EquippedItem.IsItemValid() || EquippedItem != Item || EquippedItem.Quantity < Quantity)
 		{
-			const ECItemSlot Slot = GetItemSlot(Item, true);
-			if (Slot == ECItemSlot::None)
-			{
-				// Get the index of the item
-				int32 Index = INDEX_NONE;
-				m_Inventory.Find(Item, Index);
-
-				if (Index != INDEX_NONE)
-				{
-					m_Inventory.RemoveAt(Index);
-				}
-			}
-			else
-			{
-				Item.Reset();
-			}
+			return false;
 		}
-		else
-		{
-			const int32 ItemQuantity = Item.Quantity;
-			const int32 AmountToDrop = FMath::Min(ItemQuantity, Quantity);
-			const int32 NewStackSize = ItemQuantity - AmountToDrop;
 
-			Item.Quantity = NewStackSize;
+		EquippedItem.Quantity -= Quantity;
+		NotifyChange(ECInventoryChangeType::Equipped, Slot, INDEX_NONE, EquippedItem, -Quantity);
+
+		if (EquippedItem.Quantity <= 0)
+		{
+			EquippedItem.Reset();
 		}
 
 		return true;
 	}
 
-	return false;
-}
+	// Items with a score are unique so only remove that exact item, otherwise any stack of the same item will do
+	const auto IsMatch = [&Item](const FCItem& InventoryItem) { return InventoryItem == Item && (Item.Score == INDEX_NONE || InventoryItem.Score == Item.Score); };
 
-bool UCInventoryComponent::TradeItems(const TArray<FCItem>& ItemsToTrade, UCInventoryComponent* InventoryReceiver)
-{
-	if (!GetOwner()->HasAuthority())
+	int32 Available = 0;
+	for (const auto& InventoryItem : m_Inventory)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("You can't trade items without authority"));
-		return false;
+		if (IsMatch(InventoryItem))
+		{
+			Available += InventoryItem.Quantity;
+		}
 	}
 
-	if (InventoryReceiver == nullptr || InventoryReceiver == this)
+	if (Available < Quantity)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("You can't trade items if the inventory you're trading with is null or with yourself."));
 		return false;
 	}
 
-	for (const auto& Item : ItemsToTrade)
+	// Take from the back so emptied stacks shift as little as possible
+	int32 Remaining = Quantity;
+	for (int32 i = m_Inventory.Num() - 1; i >= 0 && Remaining > 0; --i)
 	{
-		if (MoveItemToInventory(Item, InventoryReceiver))
+		if (IsMatch(m_Inventory[i]))
 		{
-			continue;
+			const int32 AmountToRemove = FMath::Min(Remaining, m_Inventory[i].Quantity);
+			RemoveFromIndex(i, AmountToRemove);
+			Remaining -= AmountToRemove;
 		}
 	}
 
 	return true;
 }
 
-bool UCInventoryComponent::HasItemInEquippableSlot(const ECItemSlot Slot) const
+bool UCInventoryComponent::ConsumeItem(const TArray<FCItemConsumable>& ConsumedItems, TArray<FCItem>& OutItems)
 {
-	return Slot != ECItemSlot::None && m_EquippableInventory[static_cast<uint8>(Slot)].IsItemValid();
+	if (!GetOwner()->HasAuthority())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("You can't consume items without authority"));
+		return false;
+	}
+
+	OutItems.Reset();
+
+	UCInventoryComponent* Inventories[] = {this};
+	FCCraftingContext Context(Inventories);
+
+	return Context.Consume(ConsumedItems, 1, &OutItems) && Context.Commit();
 }
 
-bool UCInventoryComponent::CanAddItemToSlot(const UCItemDescriptorBase* Item, const ECItemSlot Slot) const
+int32 UCInventoryComponent::CraftRecipe(const UCItemRecipe* Recipe, const int32 MaxCount, const TArray<UCInventoryComponent*>& AdditionalSources)
 {
-	if (Item != nullptr)
+	if (!GetOwner()->HasAuthority())
 	{
-		if (m_Inventory.Num() >= UnrealInventory::Items::MaxItems)
-		{
-			return false;
-		}
+		UE_LOG(LogTemp, Warning, TEXT("You can't craft items without authority"));
+		return 0;
+	}
 
-		if (GetTotalWeight() >= UnrealInventory::Items::MaxWeight)
-		{
-			return false;
-		}
+	FCAuditScope AuditScope(ECAuditOp::Craft);
 
-		if (Slot == ECItemSlot::None)
-		{
-			return true;
-		}
+	if (Recipe == nullptr)
+	{
+		return 0;
+	}
 
-		const bool bHasSlot = (Item->GetItemSlot() & (1 << static_cast<int32>(Slot))) != 0;
-		if (bHasSlot)
+	TArray<UCInventoryComponent*, TInlineAllocator<4>> Inventories;
+	Inventories.Add(this);
+
+	for (UCInventoryComponent* Source : AdditionalSources)
+	{
+		if (Source != nullptr && Source != this)
 		{
-			return true;
+			Inventories.AddUnique(Source);
 		}
 	}
 
-	return false;
+	FCCraftingContext Context(Inventories);
+
+	const int32 Count = Context.Craft(*Recipe, MaxCount);
+	return Count > 0 && Context.Commit() ? Count : 0;
 }
 
-float UCInventoryComponent::GetTotalWeight() const
+bool UCInventoryComponent::DropItem(FCItem& Item, const int32 Quantity)
 {
-	float Weight = 0.0f;
+	if (!GetOwner()->HasAuthority())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("You can't drop an item from the inventory without authority"));
+		return false;
+	}
 
-	for (const auto& InventoryItem : m_Inventory)
+	FCAuditScope AuditScope(ECAuditOp::Drop);
+
+	if (!Item.IsItemValid())
 	{
-		Weight += InventoryItem.GetTotalWeight();
+		return false;
 	}
 
-	return Weight;
-}
+	ECItemSlot Slot = ECItemSlot::None;
+	int32 Index = INDEX_NONE;
+	FCItem* StoredItem = FindStoredItem(Item, Slot, Index);
+	if (StoredItem == nullptr)
+	{
+		return false;
+	}
 
-bool UCInventoryComponent::GetItemsFromCategory(const ECItemCategory Category, TArray<FCItem>& OutItems)
-{
-	OutItems.Empty();
-	OutItems.Reserve(UnrealInventory::TemporaryArrayReserveSize);
+	const int32 AmountToDrop = Quantity == INDEX_NONE ? StoredItem->Quantity : FMath::Min(Quantity, StoredItem->Quantity);
+	if (AmountToDrop <= 0 || !CreatePickup(*StoredItem, AmountToDrop))
+	{
+		return false;
+	}
 
-	for (const auto& InventoryItem : m_Inventory)
+	if (AmountToDrop >= StoredItem->Quantity)
 	{
-		if (InventoryItem.ItemDescriptor->GetItemCategory() == Category)
+		// Item may be the stored item itself, so reset it before removing shifts the next stack into its place
+		const FCItem DroppedItem = *StoredItem;
+		Item.Reset();
+
+		if (Slot == ECItemSlot::None)
 		{
-			OutItems.Add(InventoryItem);
+			NotifyChange(ECInventoryChangeType::Removed, ECItemSlot::None, Index, DroppedItem, -DroppedItem.Quantity);
+			m_Inventory.RemoveAt(Index);
 		}
+		else
+		{
+			NotifyChange(ECInventoryChangeType::Equipped, Slot, INDEX_NONE, DroppedItem, -DroppedItem.Quantity);
+			StoredItem->Reset();
+		}
+	}
+	else
+	{
+		StoredItem->Quantity -= AmountToDrop;
+		NotifyChange(Slot == ECItemSlot::None ? ECInventoryChangeType::Changed : ECInventoryChangeType::Equipped, Slot, Slot == ECItemSlot::None ? Index : INDEX_NONE, *StoredItem, -AmountToDrop);
+
+		// Item may be a copy so keep it in sync with the stored item
+		Item.Quantity = StoredItem->Quantity;
 	}
 
-	return OutItems.Num() > 0;
+	return true;
 }
 
-const FCItem& UCInventoryComponent::GetItemByIndex(const ECItemSlot Slot, const int32 Index)
+int32 UCInventoryComponent::StartProcessing(UCItemRecipe* Recipe, const int32 Count)
 {
-	static FCItem DefaultItem;
-	if (Slot == ECItemSlot::None)
+	if (!GetOwner()->HasAuthority())
 	{
-		return m_Inventory.IsValidIndex(Index) ? m_Inventory[Index] : DefaultItem;
+		UE_LOG(LogTemp, Warning, TEXT("You can't start processing without authority"));
+		return INDEX_NONE;
 	}
 
-	const uint8 Idx = static_cast<uint8>(Slot);
-	return m_EquippableInventory[Idx].IsItemValid() ? m_EquippableInventory[Idx] : DefaultItem;
+	UCProcessingSubsystem* Subsystem = GetWorld()->GetSubsystem<UCProcessingSubsystem>();
+	return Subsystem != nullptr ? Subsystem->StartJob(this, Recipe, Count) : INDEX_NONE;
 }
 
-int32 UCInventoryComponent::GetMatchingItemCount(const UCItemDescriptorBase* ItemToFind) const
+void UCInventoryComponent::CancelProcessing(const int32 JobId)
 {
-	int32 Count = 0;
-	for (const auto& InventoryItem : m_EquippableInventory)
+	if (!GetOwner()->HasAuthority())
 	{
-		if (ItemToFind == InventoryItem.ItemDescriptor)
-		{
-			Count += InventoryItem.Quantity;
-		}
+		UE_LOG(LogTemp, Warning, TEXT("You can't cancel processing without authority"));
+		return;
 	}
 
-	for (const auto& InventoryItem : m_Inventory)
+	if (UCProcessingSubsystem* Subsystem = GetWorld()->GetSubsystem<UCProcessingSubsystem>())
 	{
-		if (ItemToFind == InventoryItem.ItemDescriptor)
-		{
-			Count += InventoryItem.Quantity;
-		}
+		Subsystem->CancelJob(this, JobId);
 	}
+}
 
-	return Count;
+float UCInventoryComponent::GetProcessingProgress(const int32 JobId) const
+{
+	const FCProcessingJob* Job = m_ProcessingJobs.FindByPredicate([JobId](const FCProcessingJob& Other) { return Other.JobId == JobId; });
+	return Job != nullptr ? Job->GetProgress(UCItemStatics::GetServerTime(this)) : 0.0f;
 }
 
-ECItemSlot UCInventoryComponent::GetItemSlot(const FCItem& Item, const bool bSearchEquippables) const
+void UCInventoryComponent::OnRep_ProcessingJobs()
 {
-	int32 Index = INDEX_NONE;
-	m_Inventory.Find(Item, Index);
+	OnProcessingJobsChanged.Broadcast();
+}
 
-	if (Index != INDEX_NONE)
+void UCInventoryComponent::NotifyProcessingJobsChanged()
+{
+	MARK_PROPERTY_DIRTY_FROM_NAME(UCInventoryComponent, m_ProcessingJobs, this);
+	m_bProcessingJobsMarkedDirty = true;
+
+	FlushOwnerDormancy();
+
+	OnProcessingJobsChanged.Broadcast();
+}
+
+void UCInventoryComponent::ApplyDurabilityDamage(const TArray<FCDurabilityEvent>& Events)
+{
+	if (!GetOwner()->HasAuthority())
 	{
-		return ECItemSlot::None;
+		UE_LOG(LogTemp, Warning, TEXT("You can't damage items without authority"));
+		return;
 	}
 
-	if (bSearchEquippables)
+	const float Now = UCItemStatics::GetServerTime(this);
+
+	for (const auto& Event : Events)
 	{
-		for (const ECItemSlot Slot : TEnumRange<ECItemSlot>())
+		FCItem* Item = GetMutableItem(Event.Slot, Event.Index);
+		if (Item != nullptr && Item->Health >= 0.0f && Event.Amount > 0.0f)
 		{
-			const FCItem& InventoryItem = m_EquippableInventory[static_cast<uint8>(Slot)];
+			Item->PendingWear += Event.Amount;
+			CommitHealthIfGroupChanged(*Item, Event.Slot, Event.Index, Now);
+		}
+	}
+}
+
+void UCInventoryComponent::ApplyItemUse(const ECItemSlot Slot, const int32 Index, const int32 Uses)
+{
+	const FCItem* Item = GetItem(Slot, Index);
+	if (Item == nullptr || Uses <= 0)
+	{
+		return;
+	}
+
+	FCDurabilityEvent Event;
+	Event.Slot = Slot;
+	Event.Index = Index;
+	Event.Amount = Item->ItemDescriptor->GetDurabilityLossPerUse() * Uses;
+
+	ApplyDurabilityDamage({Event});
+}
+
+float UCInventoryComponent::GetItemHealth(const ECItemSlot Slot, const int32 Index) const
+{
+	const FCItem* Item = GetItem(Slot, Index);
+	return Item != nullptr ? Item->GetHealth(UCItemStatics::GetServerTime(this)) : -1.0f;
+}
+
+const FCItem* UCInventoryComponent::GetItem(const ECItemSlot Slot, const int32 Index) const
+{
+	if (Slot == ECItemSlot::None)
+	{
+		return m_Inventory.IsValidIndex(Index) && m_Inventory[Index].IsItemValid() ? &m_Inventory[Index] : nullptr;
+	}
+
+	if (Slot < ECItemSlot::MAX)
+	{
+		const FCItem& Item = m_EquippableInventory[static_cast<uint8>(Slot)];
+		return Item.IsItemValid() ? &Item : nullptr;
+	}
+
+	return nullptr;
+}
+
+void UCInventoryComponent::CommitHealthIfGroupChanged(FCItem& Item, const ECItemSlot Slot, const int32 Index, const float ServerTime)
+{
+	// The health clients can see is everything except the pending wear
+	const float CurrentHealth = Item.GetHealth(ServerTime);
+	const float VisibleHealth = FMath::Min(CurrentHealth + Item.PendingWear, UnrealInventory::Items::MaxHealth);
+
+	if (UCItemStatics::GetHealthGroup(CurrentHealth) != UCItemStatics::GetHealthGroup(VisibleHealth))
+	{
+		Item.CommitHealth(ServerTime);
+		NotifyChange(Slot == ECItemSlot::None ? ECInventoryChangeType::Changed : ECInventoryChangeType::Equipped, Slot, Slot == ECItemSlot::None ? Index : INDEX_NONE, Item, 0);
+	}
+}
+
+int32 UCInventoryComponent::MoveAllItemsTo(UCInventoryComponent* InventoryReceiver)
+{
+	if (!GetOwner()->HasAuthority())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("You can't move items without authority"));
+		return 0;
+	}
+
+	FCAuditScope AuditScope(ECAuditOp::Trade);
+
+	if (InventoryReceiver == nullptr || InventoryReceiver == this)
+	{
+		return 0;
+	}
+
+	int32 MovedCount = 0;
+
+	// Go from the back so removing a stack doesn't shift the ones we haven't looked at yet
+	for (int32 i = m_Inventory.Num() - 1; i >= 0; --i)
+	{
+		const FCItem Item = m_Inventory[i];
+		if (InventoryReceiver->AddItem(Item))
+		{
+			RemoveFromIndex(i, Item.Quantity);
+			++MovedCount;
+		}
+	}
+
+	return MovedCount;
+}
+
+int32 UCInventoryComponent::TakeBestFrom(UCInventoryComponent* Source)
+{
+	if (!GetOwner()->HasAuthority())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("You can't take items without authority"));
+		return 0;
+	}
+
+	FCAuditScope AuditScope(ECAuditOp::Loot);
+
+	if (Source == nullptr || Source == this)
+	{
+		return 0;
+	}
+
+	const float RemainingWeight = m_MaxWeight > 0.0f ? FMath::Max(0.0f, m_MaxWeight - m_TotalWeight) : TNumericLimits<float>::Max();
+	const int32 RemainingSlots = GetMaxItems() - m_Inventory.Num();
+
+	TArray<FCLootPick> Picks;
+	UnrealInventory::Loot::SelectBestLoot(m_Inventory, Source->m_Inventory, RemainingWeight, RemainingSlots, UCItemStatics::GetServerTime(this), Picks);
+
+	if (Picks.Num() == 0)
+	{
+		return 0;
+	}
+
+	// Merge the stackable picks the same way AddItems does so the existing stacks are only searched once per descriptor and rarity
+	TArray<FCItem> Items;
+	TMap<TPair<const UCItemDescriptorBase*, ECItemRarity>, int32> StackableItems;
+
+	for (const FCLootPick& Pick : Picks)
+	{
+		FCItem Item = Source->m_Inventory[Pick.Index];
+		Item.Quantity = Pick.Quantity;
+
+		if (Item.Score != INDEX_NONE)
+		{
+			Items.Add(Item);
+			continue;
+		}
+
+		const TPair<const UCItemDescriptorBase*, ECItemRarity> Key(Item.ItemDescriptor, Item.Rarity);
+		if (const int32* MergedIndex = StackableItems.Find(Key))
+		{
+			Items[*MergedIndex].Quantity += Item.Quantity;
+		}
+		else
+		{
+			StackableItems.Add(Key, Items.Add(Item));
+		}
+	}
+
+	// AddItem refuses anything once the inventory is full, so the items that only top up existing stacks go first and the one that fills the last slot goes last
+	TMap<TPair<const UCItemDescriptorBase*, ECItemRarity>, int32> FreeRoom;
+	for (const FCItem& Item : m_Inventory)
+	{
+		if (Item.Score == INDEX_NONE && Item.ItemDescriptor != nullptr)
+		{
+			FreeRoom.FindOrAdd(TPair<const UCItemDescriptorBase*, ECItemRarity>(Item.ItemDescriptor, Item.Rarity)) += FMath::Max(0, Item.ItemDescriptor->GetStackSize() - Item.Quantity);
+		}
+	}
+
+	Algo::StableSortBy(Items, [&FreeRoom](const FCItem& Item)
+	{
+		const int32* Room = Item.Score == INDEX_NONE ? FreeRoom.Find(TPair<const UCItemDescriptorBase*, ECItemRarity>(Item.ItemDescriptor, Item.Rarity)) : nullptr;
+		return Room != nullptr && *Room >= Item.Quantity ? 0 : 1;
+	});
+
+	const TArray<FCItem> Snapshot = m_Inventory;
+	const TArray<FCItem> SourceSnapshot = Source->m_Inventory;
+
+	for (const FCItem& Item : Items)
+	{
+		if (!AddItem(Item))
+		{
+			RestoreInventory(Snapshot);
+			return 0;
+		}
+	}
+
+	// Remove from the back so the indices of the remaining picks stay valid
+	Picks.Sort([](const FCLootPick& A, const FCLootPick& B) { return A.Index > B.Index; });
+
+	for (const FCLootPick& Pick : Picks)
+	{
+		if (!Source->RemoveFromIndex(Pick.Index, Pick.Quantity))
+		{
+			RestoreInventory(Snapshot);
+			Source->RestoreInventory(SourceSnapshot);
+			return 0;
+		}
+	}
+
+	return Picks.Num();
+}
+
+bool UCInventoryComponent::TradeItems(const TArray<FCItem>& ItemsToTrade, UCInventoryComponent* InventoryReceiver)
+{
+	if (!GetOwner()->HasAuthority())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("You can't trade items without authority"));
+		return false;
+	}
+
+	FCAuditScope AuditScope(ECAuditOp::Trade);
+
+	if (InventoryReceiver == nullptr || InventoryReceiver == this)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("You can't trade items if the inventory you're trading with is null or with yourself."));
+		return false;
+	}
+
+	for (const auto& Item : ItemsToTrade)
+	{
+		if (MoveItemToInventory(Item, InventoryReceiver))
+		{
+			continue;
+		}
+	}
+
+	return true;
+}
+
+void UCInventoryComponent::ViewStoragePage(UCStorageComponent* Storage, const int32 Page, const bool bView)
+{
+	// The server stops sending updates for the page, so what we have of it would only go stale
+	if (!bView && Storage != nullptr)
+	{
+		Storage->DropReceivedPage(Page);
+	}
+
+	ServerViewStoragePage(Storage, Page, bView);
+}
+
+void UCInventoryComponent::CloseStorage(UCStorageComponent* Storage)
+{
+	if (Storage != nullptr)
+	{
+		Storage->ClearReceivedPages();
+	}
+
+	ServerCloseStorage(Storage);
+}
+
+void UCInventoryComponent::TakeFromStorage(UCStorageComponent* Storage, const int32 Page, const int32 PageVersion, const int32 IndexInPage, const int32 Quantity)
+{
+	ServerTakeFromStorage(Storage, Page, PageVersion, IndexInPage, Quantity);
+}
+
+void UCInventoryComponent::DepositToStorage(UCStorageComponent* Storage, const int32 InventoryIndex, const int32 Quantity)
+{
+	ServerDepositToStorage(Storage, InventoryIndex, Quantity);
+}
+
+void UCInventoryComponent::ServerViewStoragePage_Implementation(UCStorageComponent* Storage, const int32 Page, const bool bView)
+{
+	if (Storage == nullptr)
+	{
+		return;
+	}
+
+	if (bView)
+	{
+		Storage->SubscribePage(this, Page);
+	}
+	else
+	{
+		Storage->UnsubscribePage(this, Page);
+	}
+}
+
+bool UCInventoryComponent::ServerViewStoragePage_Validate(UCStorageComponent* Storage, const int32 Page, const bool bView)
+{
+	return Page >= 0;
+}
+
+void UCInventoryComponent::ServerCloseStorage_Implementation(UCStorageComponent* Storage)
+{
+	if (Storage != nullptr)
+	{
+		Storage->RemoveViewer(this);
+	}
+}
+
+void UCInventoryComponent::ServerTakeFromStorage_Implementation(UCStorageComponent* Storage, const int32 Page, const int32 PageVersion, const int32 IndexInPage, const int32 Quantity)
+{
+	if (Storage != nullptr)
+	{
+		Storage->TakeItem(this, Page, PageVersion, IndexInPage, Quantity);
+	}
+}
+
+bool UCInventoryComponent::ServerTakeFromStorage_Validate(UCStorageComponent* Storage, const int32 Page, const int32 PageVersion, const int32 IndexInPage, const int32 Quantity)
+{
+	return Page >= 0 && IndexInPage >= 0 && Quantity > 0;
+}
+
+void UCInventoryComponent::ServerDepositToStorage_Implementation(UCStorageComponent* Storage, const int32 InventoryIndex, const int32 Quantity)
+{
+	if (Storage != nullptr)
+	{
+		Storage->DepositItem(this, InventoryIndex, Quantity);
+	}
+}
+
+bool UCInventoryComponent::ServerDepositToStorage_Validate(UCStorageComponent* Storage, const int32 InventoryIndex, const int32 Quantity)
+{
+	return InventoryIndex >= 0 && Quantity > 0;
+}
+
+void UCInventoryComponent::QueueCommand(const FCInventoryCommand& Command)
+{
+	if (GetOwner()->HasAuthority())
+	{
+		if (UCCommandSubsystem* Subsystem = GetWorld()->GetSubsystem<UCCommandSubsystem>())
+		{
+			Subsystem->QueueCommands(this, MakeArrayView(&Command, 1));
+		}
+
+		return;
+	}
+
+	m_QueuedCommands.Add(Command);
+
+	if (!m_bCommandSendScheduled)
+	{
+		if (UWorld* World = GetWorld())
+		{
+			m_bCommandSendScheduled = true;
+			World->GetTimerManager().SetTimerForNextTick(this, &UCInventoryComponent::SendQueuedCommands);
+		}
+	}
+}
+
+void UCInventoryComponent::SendQueuedCommands()
+{
+	m_bCommandSendScheduled = false;
+
+	for (int32 First = 0; First < m_QueuedCommands.Num(); First += UnrealInventory::Commands::MaxCommandsPerBatch)
+	{
+		const int32 Count = FMath::Min(m_QueuedCommands.Num() - First, UnrealInventory::Commands::MaxCommandsPerBatch);
+		ServerExecuteCommands(TArray<FCInventoryCommand>(m_QueuedCommands.GetData() + First, Count));
+	}
+
+	m_QueuedCommands.Reset();
+}
+
+void UCInventoryComponent::ServerExecuteCommands_Implementation(const TArray<FCInventoryCommand>& Commands)
+{
+	if (UCCommandSubsystem* Subsystem = GetWorld()->GetSubsystem<UCCommandSubsystem>())
+	{
+		Subsystem->QueueCommands(this, Commands);
+	}
+}
+
+bool UCInventoryComponent::ServerExecuteCommands_Validate(const TArray<FCInventoryCommand>& Commands)
+{
+	// Only reject what no honest client can send, anything else is checked against the inventory when it's applied
+	return Commands.Num() <= UnrealInventory::Commands::MaxCommandsPerBatch;
+}
+
+void UCInventoryComponent::ApplyQueuedCommands()
+{
+	// Move the commands out first so anything queued while applying waits for the next pass
+	const TArray<FCInventoryCommand> Commands = MoveTemp(m_QueuedCommands);
+	m_QueuedCommands.Reset();
+
+	int32 Rejected = 0;
+	for (const FCInventoryCommand& Command : Commands)
+	{
+		if (!ExecuteCommand(Command))
+		{
+			++Rejected;
+		}
+	}
+
+	if (Rejected > 0)
+	{
+		UE_LOG(LogTemp, Verbose, TEXT("Rejected %d of %d inventory commands for %s"), Rejected, Commands.Num(), *GetPathName());
+	}
+}
+
+bool UCInventoryComponent::ExecuteCommand(const FCInventoryCommand& Command)
+{
+	if (!GetOwner()->HasAuthority())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("You can't execute an inventory command without authority"));
+		return false;
+	}
+
+	FCAuditScope AuditScope(ECAuditOp::Command);
+
+	switch (Command.Type)
+	{
+	case ECInventoryCommandType::Move:
+	{
+		if (!m_Inventory.IsValidIndex(Command.Index) || !m_Inventory.IsValidIndex(Command.TargetIndex) || Command.Index == Command.TargetIndex)
+		{
+			return false;
+		}
+
+		const FCItem& Item = m_Inventory[Command.Index];
+		const FCItem& Target = m_Inventory[Command.TargetIndex];
+		if (!Item.IsItemValid())
+		{
+			return false;
+		}
+
+		// Merge into the target stack the same way AddItem would
+		if (Item == Target && Item.Score == INDEX_NONE && Target.Score == INDEX_NONE && Target.Quantity < Target.ItemDescriptor->GetStackSize())
+		{
+			const int32 AmountToMove = FMath::Min(Item.Quantity, Target.ItemDescriptor->GetStackSize() - Target.Quantity);
+
+			m_Inventory[Command.TargetIndex].Quantity += AmountToMove;
+			NotifyChange(ECInventoryChangeType::Changed, ECItemSlot::None, Command.TargetIndex, m_Inventory[Command.TargetIndex], AmountToMove);
+
+			return RemoveFromIndex(Command.Index, AmountToMove);
+		}
+
+		const FCItem OldItem = Item;
+		const FCItem OldTarget = Target;
+		m_Inventory.Swap(Command.Index, Command.TargetIndex);
+
+		// Each side is replaced the same way as everywhere else so the tracked weight and value stay exact and the events replay in order
+		NotifyItemReplaced(Command.Index, OldItem, OldTarget);
+		NotifyItemReplaced(Command.TargetIndex, OldTarget, OldItem);
+
+		return true;
+	}
+	case ECInventoryCommandType::Split:
+	{
+		if (!m_Inventory.IsValidIndex(Command.Index) || m_Inventory.Num() >= m_MaxItems)
+		{
+			return false;
+		}
+
+		FCItem& Item = m_Inventory[Command.Index];
+		if (!Item.IsItemValid() || Command.Quantity <= 0 || Command.Quantity >= Item.Quantity)
+		{
+			return false;
+		}
+
+		FCItem NewStack = Item;
+		NewStack.Quantity = Command.Quantity;
+
+		Item.Quantity -= Command.Quantity;
+		NotifyChange(ECInventoryChangeType::Changed, ECItemSlot::None, Command.Index, Item, -Command.Quantity);
+
+		const int32 Index = m_Inventory.Add(NewStack);
+		NotifyChange(ECInventoryChangeType::Added, ECItemSlot::None, Index, NewStack, NewStack.Quantity);
+
+		return true;
+	}
+	case ECInventoryCommandType::Drop:
+	{
+		const FCItem* Item = GetItem(Command.Slot, Command.Index);
+		if (Item == nullptr)
+		{
+			return false;
+		}
+
+		const FCItem DroppedItem = *Item;
+		const int32 Quantity = Command.Quantity == INDEX_NONE ? DroppedItem.Quantity : Command.Quantity;
+		if (Quantity <= 0 || Quantity > DroppedItem.Quantity || !CreatePickup(DroppedItem, Quantity))
+		{
+			return false;
+		}
+
+		return Command.Slot == ECItemSlot::None ? RemoveFromIndex(Command.Index, Quantity) : RemoveItem(DroppedItem, Quantity, Command.Slot);
+	}
+	case ECInventoryCommandType::Equip:
+	{
+		if (!m_Inventory.IsValidIndex(Command.Index) || Command.TargetSlot == ECItemSlot::None || Command.TargetSlot >= ECItemSlot::MAX)
+		{
+			return false;
+		}
+
+		const FCItem Item = m_Inventory[Command.Index];
+		if (!Item.IsItemValid())
+		{
+			return false;
+		}
+
+		// Do what CanAddItemToSlot does up front with the stack already counted as taken out, so a request that can't work never touches the inventory
+		const bool bFitsSlot = (Item.ItemDescriptor->GetItemSlot() & (1 << static_cast<int32>(Command.TargetSlot))) != 0;
+		const bool bHasRoom = m_Inventory.Num() - 1 < GetMaxItems() && (m_MaxWeight <= 0.0f || GetTotalWeight() - Item.GetTotalWeight() < m_MaxWeight);
+		if (!bFitsSlot || !bHasRoom)
+		{
+			return false;
+		}
+
+		// Take the item out first so whatever is equipped already has room to go back into the inventory
+		RemoveFromIndex(Command.Index, Item.Quantity);
+
+		if (!AddItem(Item, Command.TargetSlot))
+		{
+			// AddItem only fails before it changes anything when equipping, so putting the stack back where it was is all there is to undo
+			m_Inventory.Insert(Item, Command.Index);
+			NotifyChange(ECInventoryChangeType::Added, ECItemSlot::None, Command.Index, Item, Item.Quantity);
+			return false;
+		}
+
+		return true;
+	}
+	case ECInventoryCommandType::Unequip:
+	{
+		if (Command.Slot == ECItemSlot::None || Command.Slot >= ECItemSlot::MAX || !HasItemInEquippableSlot(Command.Slot))
+		{
+			return false;
+		}
+
+		const FCItem Item = m_EquippableInventory[static_cast<uint8>(Command.Slot)];
+		return AddItem(Item) && RemoveItem(Item, Item.Quantity, Command.Slot);
+	}
+	case ECInventoryCommandType::Use:
+	{
+		if (GetItem(Command.Slot, Command.Index) == nullptr || Command.Quantity <= 0)
+		{
+			return false;
+		}
+
+		ApplyItemUse(Command.Slot, Command.Index, Command.Quantity);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+void UCInventoryComponent::ClientReceiveStoragePage_Implementation(UCStorageComponent* Storage, const FCStoragePage& Page)
+{
+	if (Storage != nullptr)
+	{
+		Storage->ReceivePage(Page);
+	}
+}
+
+bool UCInventoryComponent::HasItemInEquippableSlot(const ECItemSlot Slot) const
+{
+	return Slot != ECItemSlot::None && m_EquippableInventory[static_cast<uint8>(Slot)].IsItemValid();
+}
+
+bool UCInventoryComponent::CanAddItemToSlot(const UCItemDescriptorBase* Item, const ECItemSlot Slot) const
+{
+	if (Item != nullptr)
+	{
+		if (m_Inventory.Num() >= GetMaxItems())
+		{
+			return false;
+		}
+
+		if (m_MaxWeight > 0.0f && GetTotalWeight() >= m_MaxWeight)
+		{
+			return false;
+		}
+
+		if (Slot == ECItemSlot::None)
+		{
+			return true;
+		}
+
+		const bool bHasSlot = (Item->GetItemSlot() & (1 << static_cast<int32>(Slot))) != 0;
+		if (bHasSlot)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+float UCInventoryComponent::GetTotalWeight() const
+{
+	return m_TotalWeight;
+}
+
+float UCInventoryComponent::GetTotalValue() const
+{
+	FCItemValuation& Valuation = FCItemValuation::Get();
+
+	if (m_bInventoryValueDirty)
+	{
+		m_InventoryValue = Valuation.GetTotalValue(m_Inventory);
+		m_bInventoryValueDirty = false;
+	}
+
+	// There are only a handful of equippable slots so they're cheaper to value on demand than to track
+	return static_cast<float>(m_InventoryValue + Valuation.GetTotalValue(MakeArrayView(m_EquippableInventory)));
+}
+
+bool UCInventoryComponent::GetItemsFromCategory(const ECItemCategory Category, TArray<FCItem>& OutItems)
+{
+	FCInventorySearchQuery Query;
+	Query.Categories.Add(Category);
+
+	const TConstArrayView<int32> Indices = SearchInventory(Query);
+
+	OutItems.Empty(Indices.Num());
+	for (const int32 Index : Indices)
+	{
+		OutItems.Add(m_Inventory[Index]);
+	}
+
+	return OutItems.Num() > 0;
+}
+
+int32 UCInventoryComponent::SearchInventory(const FCInventorySearchQuery& Query, TArray<int32>& OutIndices) const
+{
+	const TConstArrayView<int32> Indices = SearchInventory(Query);
+
+	OutIndices.Reset(Indices.Num());
+	OutIndices.Append(Indices.GetData(), Indices.Num());
+
+	return OutIndices.Num();
+}
+
+TConstArrayView<int32> UCInventoryComponent::SearchInventory(const FCInventorySearchQuery& Query) const
+{
+	return m_SearchIndex.Search(m_Inventory, Query);
+}
+
+const FCItem& UCInventoryComponent::GetItemByIndex(const ECItemSlot Slot, const int32 Index)
+{
+	static FCItem DefaultItem;
+	if (Slot == ECItemSlot::None)
+	{
+		return m_Inventory.IsValidIndex(Index) ? m_Inventory[Index] : DefaultItem;
+	}
+
+	const uint8 Idx = static_cast<uint8>(Slot);
+	return m_EquippableInventory[Idx].IsItemValid() ? m_EquippableInventory[Idx] : DefaultItem;
+}
+
+int32 UCInventoryComponent::GetMatchingItemCount(const UCItemDescriptorBase* ItemToFind) const
+{
+	int32 Count = 0;
+	for (const auto& InventoryItem : m_EquippableInventory)
+	{
+		if (ItemToFind == InventoryItem.ItemDescriptor)
+		{
+			Count += InventoryItem.Quantity;
+		}
+	}
+
+	for (const auto& InventoryItem : m_Inventory)
+	{
+		if (ItemToFind == InventoryItem.ItemDescriptor)
+		{
+			Count += InventoryItem.Quantity;
+		}
+	}
+
+	return Count;
+}
+
+ECItemSlot UCInventoryComponent::GetItemSlot(const FCItem& Item, const bool bSearchEquippables) const
+{
+	int32 Index = INDEX_NONE;
+	m_Inventory.Find(Item, Index);
+
+	if (Index != INDEX_NONE)
+	{
+		return ECItemSlot::None;
+	}
+
+	if (bSearchEquippables)
+	{
+		for (const ECItemSlot Slot : TEnumRange<ECItemSlot>())
+		{
+			const FCItem& InventoryItem = m_EquippableInventory[static_cast<uint8>(Slot)];
 			if (Item == InventoryItem)
 			{
-				return Slot;
+				return Slot;
+			}
+		}
+	}
+
+	return ECItemSlot::Invalid;
+}
+
+int32 UCInventoryComponent::GetItemIndex(const FCItem& Item) const
+{
+	int32 Index = INDEX_NONE;
+	m_Inventory.Find(Item, Index);
+	return Index;
+}
+
+void UCInventoryComponent::GenerateItemScore(FCItem& Item)
+{
+	if (Item.ItemDescriptor != nullptr && Item.Score == INDEX_NONE)
+	{
+		Item.GenerateScore(NextItemSeed());
+	}
+}
+
+TArray<UCInventoryComponent::FCItemLocation> UCInventoryComponent::FindItemLocation(const UCItemDescriptorBase* Item, const bool bSearchEquippables) const
+{
+	TArray<UCInventoryComponent::FCItemLocation> TmpLocations;
+	TmpLocations.Reserve(UnrealInventory::TemporaryArrayReserveSize);
+
+	for (const int32 i : GetStackIndices(Item))
+	{
+		TmpLocations.Add({i, ECItemSlot::None, m_Inventory[i].Quantity});
+	}
+
+	if (bSearchEquippables)
+	{
+		for (const ECItemSlot Slot : TEnumRange<ECItemSlot>())
+		{
+			const int32 Index = static_cast<uint8>(Slot);
+			const FCItem& InventoryItem = m_EquippableInventory[Index];
+			if (Item == InventoryItem.ItemDescriptor)
+			{
+				TmpLocations.Add({Index, Slot, InventoryItem.Quantity});
+			}
+		}
+	}
+
+	return TmpLocations;
+}
+
+TConstArrayView<int32> UCInventoryComponent::GetStackIndices(const UCItemDescriptorBase* Item) const
+{
+	if (m_bDescriptorStacksDirty)
+	{
+		m_DescriptorStacks.Reset();
+
+		for (int32 i = 0; i < m_Inventory.Num(); ++i)
+		{
+			m_DescriptorStacks.FindOrAdd(m_Inventory[i].ItemDescriptor).Add(i);
+		}
+
+		m_DescriptorStacksNum = m_Inventory.Num();
+		m_bDescriptorStacksDirty = false;
+	}
+
+	const auto* Stacks = m_DescriptorStacks.Find(Item);
+	return Stacks != nullptr ? TConstArrayView<int32>(*Stacks) : TConstArrayView<int32>();
+}
+
+void UCInventoryComponent::UpdateDescriptorStacks(const ECInventoryChangeType Type, const int32 Index, const FCItem& Item)
+{
+	// The index is rebuilt from scratch anyway, nothing to keep up to date
+	if (m_bDescriptorStacksDirty || Type == ECInventoryChangeType::Changed)
+	{
+		return;
+	}
+
+	// A stack appended after it was added to the array
+	if (Type == ECInventoryChangeType::Added && Index == m_DescriptorStacksNum && Index == m_Inventory.Num() - 1 && m_Inventory[Index].ItemDescriptor == Item.ItemDescriptor)
+	{
+		m_DescriptorStacks.FindOrAdd(Item.ItemDescriptor).Add(Index);
+		++m_DescriptorStacksNum;
+		return;
+	}
+
+	// The last stack before it's taken out of the array
+	if (Type == ECInventoryChangeType::Removed && Index == m_DescriptorStacksNum - 1 && Index == m_Inventory.Num() - 1 && m_Inventory[Index].ItemDescriptor == Item.ItemDescriptor)
+	{
+		auto* Stacks = m_DescriptorStacks.Find(Item.ItemDescriptor);
+		if (Stacks != nullptr && Stacks->Num() > 0 && Stacks->Last() == Index)
+		{
+			Stacks->Pop(EAllowShrinking::No);
+			if (Stacks->Num() == 0)
+			{
+				m_DescriptorStacks.Remove(Item.ItemDescriptor);
+			}
+
+			--m_DescriptorStacksNum;
+			return;
+		}
+	}
+
+	// Anything in the middle of the array moves the stacks after it around
+	m_bDescriptorStacksDirty = true;
+}
+
+FCItem* UCInventoryComponent::FindStoredItem(const FCItem& Item, ECItemSlot& OutSlot, int32& OutIndex)
+{
+	// Native callers usually pass the stored item itself
+	if (m_Inventory.Num() > 0 && &Item >= m_Inventory.GetData() && &Item < m_Inventory.GetData() + m_Inventory.Num())
+	{
+		OutSlot = ECItemSlot::None;
+		OutIndex = static_cast<int32>(&Item - m_Inventory.GetData());
+		return &m_Inventory[OutIndex];
+	}
+
+	if (&Item >= m_EquippableInventory && &Item < m_EquippableInventory + static_cast<int32>(ECItemSlot::MAX))
+	{
+		OutIndex = static_cast<int32>(&Item - m_EquippableInventory);
+		OutSlot = static_cast<ECItemSlot>(OutIndex);
+		return OutSlot != ECItemSlot::None ? &m_EquippableInventory[OutIndex] : nullptr;
+	}
+
+	// Otherwise it's a copy, match the whole stack so another stack of the same item isn't picked
+	for (int32 i = 0; i < m_Inventory.Num(); ++i)
+	{
+		if (m_Inventory[i].IsIdentical(Item))
+		{
+			OutSlot = ECItemSlot::None;
+			OutIndex = i;
+			return &m_Inventory[i];
+		}
+	}
+
+	for (const ECItemSlot Slot : TEnumRange<ECItemSlot>())
+	{
+		FCItem& EquippedItem = m_EquippableInventory[static_cast<uint8>(Slot)];
+		if (EquippedItem.IsIdentical(Item))
+		{
+			OutSlot = Slot;
+			OutIndex = static_cast<int32>(Slot);
+			return &EquippedItem;
+		}
+	}
+
+	OutSlot = ECItemSlot::Invalid;
+	OutIndex = INDEX_NONE;
+	return nullptr;
+}
+
+#if 0
+int32 UCInventoryComponent::FindItem(const FCItem& Item, const bool bSearchEquippables /*= false*/) const
+{
+	int32 Index = INDEX_NONE;
+	m_Inventory.Find(Item, Index);
+
+	if (bSearchEquippables)
+	{
+		for (const ECItemSlot Slot : TEnumRange<ECItemSlot>())
+		{
+			const int32 Index = static_cast<uint8>(Slot);
+			const FCItem& InventoryItem = m_EquippableInventory[Index];
+			if (Item == InventoryItem.ItemDescriptor)
+			{
+				TmpLocations.Add({ Index, Slot, InventoryItem.Quantity });
+			}
+		}
+	}
+}
+#endif  // 0
+
+int32 UCInventoryComponent::CompactAndSort()
+{
+	return CompactAndSort(m_SortRules);
+}
+
+int32 UCInventoryComponent::CompactAndSort(const TArray<FCInventorySortRule>& SortRules)
+{
+	if (!GetOwner()->HasAuthority())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("You can't sort the inventory without authority"));
+		return 0;
+	}
+
+	struct FSortEntry
+	{
+		FCItem Item;
+
+		/** The lowest index this entry came from, used to keep the sort stable so items that are already in place don't move. */
+		int32 SourceIndex = INDEX_NONE;
+	};
+
+	TArray<FSortEntry> Entries;
+	Entries.Reserve(m_Inventory.Num());
+
+	// Merge all stackable items with the same descriptor and rarity into a single entry
+	TMap<TPair<const UCItemDescriptorBase*, ECItemRarity>, int32> StackableEntries;
+	StackableEntries.Reserve(m_Inventory.Num());
+
+	for (int32 i = 0; i < m_Inventory.Num(); ++i)
+	{
+		const FCItem& InventoryItem = m_Inventory[i];
+		if (!InventoryItem.IsItemValid())
+		{
+			continue;
+		}
+
+		// Items with a score don't stack, see AddItem
+		if (InventoryItem.Score != INDEX_NONE || InventoryItem.ItemDescriptor->GetStackSize() <= 1)
+		{
+			Entries.Add({InventoryItem, i});
+			continue;
+		}
+
+		const TPair<const UCItemDescriptorBase*, ECItemRarity> Key(InventoryItem.ItemDescriptor, InventoryItem.Rarity);
+		if (const int32* EntryIndex = StackableEntries.Find(Key))
+		{
+			Entries[*EntryIndex].Item.Quantity += InventoryItem.Quantity;
+		}
+		else
+		{
+			StackableEntries.Add(Key, Entries.Add({InventoryItem, i}));
+		}
+	}
+
+	const auto Compare = [&SortRules](const FSortEntry& A, const FSortEntry& B)
+	{
+		for (const auto& Rule : SortRules)
+		{
+			float ValueA = 0.0f;
+			float ValueB = 0.0f;
+
+			switch (Rule.Key)
+			{
+			case ECInventorySortKey::Category:
+				ValueA = static_cast<float>(A.Item.ItemDescriptor->GetItemCategory());
+				ValueB = static_cast<float>(B.Item.ItemDescriptor->GetItemCategory());
+				break;
+			case ECInventorySortKey::Rarity:
+				ValueA = static_cast<float>(A.Item.Rarity);
+				ValueB = static_cast<float>(B.Item.Rarity);
+				break;
+			case ECInventorySortKey::Score:
+				ValueA = static_cast<float>(A.Item.Score);
+				ValueB = static_cast<float>(B.Item.Score);
+				break;
+			case ECInventorySortKey::Weight:
+				ValueA = A.Item.ItemDescriptor->GetRarityData(A.Item.Rarity).Weight;
+				ValueB = B.Item.ItemDescriptor->GetRarityData(B.Item.Rarity).Weight;
+				break;
 			}
+
+			if (ValueA != ValueB)
+			{
+				return Rule.bDescending ? ValueA > ValueB : ValueA < ValueB;
+			}
+		}
+
+		// Otherwise keep the current order so items that are already sorted don't move
+		return A.SourceIndex < B.SourceIndex;
+	};
+
+	Algo::Sort(Entries, Compare);
+
+	// Build the target layout, splitting merged entries back into full stacks followed by a single partial stack
+	TArray<FCItem> Target;
+	Target.Reserve(m_Inventory.Num());
+
+	for (const auto& Entry : Entries)
+	{
+		const int32 MaxQuantity = FMath::Max(1, Entry.Item.ItemDescriptor->GetStackSize());
+
+		int32 Quantity = Entry.Item.Quantity;
+		while (Quantity > 0)
+		{
+			FCItem& Stack = Target.Add_GetRef(Entry.Item);
+			Stack.Quantity = FMath::Min(Quantity, MaxQuantity);
+			Quantity -= Stack.Quantity;
 		}
 	}
 
-	return ECItemSlot::Invalid;
+	// Only write the indices that actually differ, anything that's already in place is left alone
+	int32 WrittenCount = 0;
+	const int32 CommonNum = FMath::Min(Target.Num(), m_Inventory.Num());
+
+	for (int32 i = 0; i < CommonNum; ++i)
+	{
+		if (!m_Inventory[i].IsNetIdentical(Target[i]))
+		{
+			NotifyItemReplaced(i, m_Inventory[i], Target[i]);
+			m_Inventory[i] = MoveTemp(Target[i]);
+			++WrittenCount;
+		}
+	}
+
+	for (int32 i = CommonNum; i < Target.Num(); ++i)
+	{
+		NotifyChange(ECInventoryChangeType::Added, ECItemSlot::None, i, Target[i], Target[i].Quantity);
+		m_Inventory.Emplace(MoveTemp(Target[i]));
+		++WrittenCount;
+	}
+
+	for (int32 i = m_Inventory.Num() - 1; i >= Target.Num(); --i)
+	{
+		NotifyChange(ECInventoryChangeType::Removed, ECItemSlot::None, i, m_Inventory[i], -m_Inventory[i].Quantity);
+		++WrittenCount;
+	}
+
+	m_Inventory.SetNum(Target.Num(), EAllowShrinking::No);
+
+	return WrittenCount;
 }
 
-int32 UCInventoryComponent::GetItemIndex(const FCItem& Item) const
+void UCInventoryComponent::FlushChanges()
 {
-	int32 Index = INDEX_NONE;
-	m_Inventory.Find(Item, Index);
-	return Index;
+	m_bFlushScheduled = false;
+
+	if (m_PendingChanges.Num() > 0)
+	{
+		// Move the changes out first so listeners that modify the inventory queue up for the next flush
+		const TArray<FCInventoryChange> Changes = MoveTemp(m_PendingChanges);
+		m_PendingChanges.Reset();
+		m_PendingChangeIndices.Reset();
+		m_LastPendingRowChange = INDEX_NONE;
+
+		for (const auto& Change : Changes)
+		{
+			BroadcastChange(Change);
+		}
+
+		OnChangesFlushedNative.Broadcast(Changes);
+		OnChangesFlushed.Broadcast(Changes);
+	}
+
+	const float NewWeight = GetTotalWeight();
+	if (!FMath::IsNearlyEqual(NewWeight, m_LastBroadcastWeight))
+	{
+		const float OldWeight = m_LastBroadcastWeight;
+		m_LastBroadcastWeight = NewWeight;
+
+		OnWeightChangedNative.Broadcast(OldWeight, NewWeight);
+		OnWeightChanged.Broadcast(OldWeight, NewWeight);
+	}
+
+	if (m_bEquipmentChanged)
+	{
+		m_bEquipmentChanged = false;
+
+		const FCEquipmentStats& Stats = GetEquipmentStats();
+		OnEquipmentStatsChangedNative.Broadcast(Stats);
+		OnEquipmentStatsChanged.Broadcast(Stats);
+	}
 }
 
-TArray<UCInventoryComponent::FCItemLocation> UCInventoryComponent::FindItemLocation(const UCItemDescriptorBase* Item, const bool bSearchEquippables) const
+const FCEquipmentStats& UCInventoryComponent::GetEquipmentStats() const
 {
-	TArray<UCInventoryComponent::FCItemLocation> TmpLocations;
-	TmpLocations.Reserve(UnrealInventory::TemporaryArrayReserveSize);
+	if (m_bEquipmentStatsDirty)
+	{
+		RebuildEquipmentStats();
+	}
+
+	return m_EquipmentStats;
+}
+
+void UCInventoryComponent::RebuildEquipmentStats() const
+{
+	m_EquipmentStats = FCEquipmentStats();
+	m_bEquipmentStatsDirty = false;
+
+	int32 ScoredCount = 0;
+
+	for (const ECItemSlot Slot : TEnumRange<ECItemSlot>())
+	{
+		const uint8 Idx = static_cast<uint8>(Slot);
+		const FCItem& Item = m_EquippableInventory[Idx];
+
+		if (!Item.IsItemValid())
+		{
+			continue;
+		}
+
+		++m_EquipmentStats.EquippedCount;
+		++m_EquipmentStats.RarityCounts[static_cast<uint8>(Item.Rarity)];
+		m_EquipmentStats.TotalWeight += Item.GetTotalWeight();
+
+		if (Item.Score != INDEX_NONE)
+		{
+			++ScoredCount;
+			m_EquipmentStats.TotalScore += Item.Score;
+			m_EquipmentStats.SlotModifiers[Idx] = Item.Score * m_RarityStatMultipliers[static_cast<uint8>(Item.Rarity)];
+		}
+	}
+
+	m_EquipmentStats.GearScore = ScoredCount > 0 ? m_EquipmentStats.TotalScore / static_cast<float>(ScoredCount) : 0.0f;
+}
+
+void UCInventoryComponent::OnRep_EquippableInventory()
+{
+	for (const ECItemSlot Slot : TEnumRange<ECItemSlot>())
+	{
+		const uint8 Idx = static_cast<uint8>(Slot);
+		const FCItem& OldItem = m_LastEquippableInventory[Idx];
+		const FCItem& NewItem = m_EquippableInventory[Idx];
+
+		if (!OldItem.IsIdentical(NewItem) && (OldItem.IsItemValid() || NewItem.IsItemValid()))
+		{
+			const int32 OldQuantity = OldItem.IsItemValid() ? OldItem.Quantity : 0;
+			const int32 NewQuantity = NewItem.IsItemValid() ? NewItem.Quantity : 0;
+
+			NotifyChange(ECInventoryChangeType::Equipped, Slot, INDEX_NONE, NewItem.IsItemValid() ? NewItem : OldItem, NewQuantity - OldQuantity);
+			m_LastEquippableInventory[Idx] = NewItem;
+		}
+	}
+}
+
+void UCInventoryComponent::OnRep_Inventory(const TArray<FCItem>& OldInventory)
+{
+	NotifyInventoryDiff(OldInventory);
+}
+
+void UCInventoryComponent::NotifyInventoryDiff(const TArray<FCItem>& OldInventory)
+{
+	// The array was replaced as a whole, the changes below don't describe how it got there
+	m_bDescriptorStacksDirty = true;
+
+	// A stack is the same stack as long as what it is stays the same, its quantity and health may still have changed
+	using FCStackKey = TTuple<const UCItemDescriptorBase*, ECItemRarity, int32, int32>;
+	const auto GetStackKey = [](const FCItem& Item) { return FCStackKey(Item.ItemDescriptor, Item.Rarity, Item.Seed, Item.Score); };
+
+	struct FCStackCandidates
+	{
+		TArray<int32, TInlineAllocator<2>> Indices;
+		int32 Next = 0;
+	};
+
+	TMap<FCStackKey, FCStackCandidates> NewStacks;
+	NewStacks.Reserve(m_Inventory.Num());
 
 	for (int32 i = 0; i < m_Inventory.Num(); ++i)
 	{
-		const FCItem& InventoryItem = m_Inventory[i];
-		if (Item == InventoryItem.ItemDescriptor)
+		NewStacks.FindOrAdd(GetStackKey(m_Inventory[i])).Indices.Add(i);
+	}
+
+	// Matches have to keep their order so the events can be replayed, a stack that moved past another one is removed and added again
+	TArray<int32> OldToNew;
+	OldToNew.Init(INDEX_NONE, OldInventory.Num());
+	TBitArray<> NewMatched(false, m_Inventory.Num());
+	int32 LastNewIndex = INDEX_NONE;
+
+	for (int32 i = 0; i < OldInventory.Num(); ++i)
+	{
+		FCStackCandidates* Candidates = NewStacks.Find(GetStackKey(OldInventory[i]));
+		if (Candidates == nullptr)
+		{
+			continue;
+		}
+
+		while (Candidates->Next < Candidates->Indices.Num() && Candidates->Indices[Candidates->Next] <= LastNewIndex)
+		{
+			++Candidates->Next;
+		}
+
+		if (Candidates->Next < Candidates->Indices.Num())
 		{
-			TmpLocations.Add({i, ECItemSlot::None, InventoryItem.Quantity});
+			LastNewIndex = Candidates->Indices[Candidates->Next++];
+			OldToNew[i] = LastNewIndex;
+			NewMatched[LastNewIndex] = true;
 		}
 	}
 
-	if (bSearchEquippables)
+	// Removals from the back so every index is still valid when it's replayed, then additions from the front, then changes at their new index
+	for (int32 i = OldInventory.Num() - 1; i >= 0; --i)
 	{
-		for (const ECItemSlot Slot : TEnumRange<ECItemSlot>())
+		if (OldToNew[i] == INDEX_NONE)
 		{
-			const int32 Index = static_cast<uint8>(Slot);
-			const FCItem& InventoryItem = m_EquippableInventory[Index];
-			if (Item == InventoryItem.ItemDescriptor)
-			{
-				TmpLocations.Add({Index, Slot, InventoryItem.Quantity});
-			}
+			NotifyChange(ECInventoryChangeType::Removed, ECItemSlot::None, i, OldInventory[i], -OldInventory[i].Quantity);
 		}
 	}
 
-	return TmpLocations;
+	for (int32 i = 0; i < m_Inventory.Num(); ++i)
+	{
+		if (!NewMatched[i])
+		{
+			NotifyChange(ECInventoryChangeType::Added, ECItemSlot::None, i, m_Inventory[i], m_Inventory[i].Quantity);
+		}
+	}
+
+	for (int32 i = 0; i < OldInventory.Num(); ++i)
+	{
+		if (OldToNew[i] != INDEX_NONE && !OldInventory[i].IsIdentical(m_Inventory[OldToNew[i]]))
+		{
+			NotifyItemReplaced(OldToNew[i], OldInventory[i], m_Inventory[OldToNew[i]]);
+		}
+	}
 }
 
-#if 0
-int32 UCInventoryComponent::FindItem(const FCItem& Item, const bool bSearchEquippables /*= false*/) const
+void UCInventoryComponent::RestoreInventory(const TArray<FCItem>& Snapshot)
 {
-	int32 Index = INDEX_NONE;
-	m_Inventory.Find(Item, Index);
+	const TArray<FCItem> CurrentInventory = MoveTemp(m_Inventory);
+	m_Inventory = Snapshot;
 
-	if (bSearchEquippables)
+	NotifyInventoryDiff(CurrentInventory);
+}
+
+void UCInventoryComponent::NotifyChange(const ECInventoryChangeType Type, const ECItemSlot Slot, const int32 Index, const FCItem& Item, const int32 QuantityDelta, const FCItem* OldItem)
+{
+	FCInventoryChange Change;
+	Change.Type = Type;
+	Change.Slot = Slot;
+	Change.Index = Index;
+	Change.ItemDescriptor = Item.ItemDescriptor;
+	Change.Rarity = Item.Rarity;
+	Change.QuantityDelta = QuantityDelta;
+
+	MarkInventoryDirty(Slot);
+
+	if (FCAuditLog::IsEnabled() && GetOwnerRole() == ROLE_Authority)
 	{
-		for (const ECItemSlot Slot : TEnumRange<ECItemSlot>())
+		RecordAudit(Change);
+	}
+
+	if (Slot == ECItemSlot::None && Item.ItemDescriptor != nullptr)
+	{
+		m_TrackedStackCount = FMath::Max(0, m_TrackedStackCount + (Type == ECInventoryChangeType::Added ? 1 : Type == ECInventoryChangeType::Removed ? -1 : 0));
+		m_TotalWeight += Item.ItemDescriptor->GetRarityData(Item.Rarity).Weight * QuantityDelta;
+
+		// Don't let float error accumulate
+		if (m_TrackedStackCount == 0 || m_TotalWeight < 0.0f)
 		{
-			const int32 Index = static_cast<uint8>(Slot);
-			const FCItem& InventoryItem = m_EquippableInventory[Index];
-			if (Item == InventoryItem.ItemDescriptor)
-			{
-				TmpLocations.Add({ Index, Slot, InventoryItem.Quantity });
-			}
+			m_TotalWeight = 0.0f;
+		}
+
+		FCItemValuation& Valuation = FCItemValuation::Get();
+
+		if (OldItem != nullptr && OldItem->ItemDescriptor != nullptr)
+		{
+			// The health may have changed along with the quantity, so take the old stack out at its own health group
+			m_InventoryValue += Valuation.GetValue(Item) - Valuation.GetValue(*OldItem);
+		}
+		else if (QuantityDelta != 0)
+		{
+			m_InventoryValue += Valuation.GetUnitValue(Item.ItemDescriptor, Item.Rarity, static_cast<ECItemHealthGroup>(FCItemValuation::GetHealthGroupIndex(Item.Health))) * QuantityDelta;
+		}
+		else
+		{
+			// A change without a quantity is a new health group, the old value isn't known anymore
+			m_bInventoryValueDirty = true;
+		}
+
+		if (m_TrackedStackCount == 0 || m_InventoryValue < 0.0)
+		{
+			m_InventoryValue = 0.0;
+		}
+	}
+
+	if (Slot == ECItemSlot::None)
+	{
+		// Removals are recorded before the item is taken out, everything after it moves down a row
+		if (Type == ECInventoryChangeType::Changed)
+		{
+			m_SearchIndex.MarkRowDirty(Index);
+		}
+		else
+		{
+			m_SearchIndex.MarkRowsDirtyFrom(Index);
+		}
+
+		UpdateDescriptorStacks(Type, Index, Item);
+	}
+	else
+	{
+		m_bEquipmentStatsDirty = true;
+		m_bEquipmentChanged = true;
+	}
+
+	PostInventoryChange(Change);
+
+	// Coalesce with the last pending change to the same item so a batch of changes results in a single event,
+	// as long as no row was added or removed since then
+	const uint64 PendingKey = GetPendingChangeKey(Change);
+	const int32* LastPendingIndex = m_PendingChangeIndices.Find(PendingKey);
+
+	if (LastPendingIndex != nullptr && *LastPendingIndex > m_LastPendingRowChange && Change.CanCoalesceWith(m_PendingChanges[*LastPendingIndex]))
+	{
+		m_PendingChanges[*LastPendingIndex].QuantityDelta += QuantityDelta;
+	}
+	else
+	{
+		const int32 PendingIndex = m_PendingChanges.Add(Change);
+		m_PendingChangeIndices.Add(PendingKey, PendingIndex);
+
+		if (Type == ECInventoryChangeType::Added || Type == ECInventoryChangeType::Removed)
+		{
+			m_LastPendingRowChange = PendingIndex;
+		}
+	}
+
+	if (!m_bFlushScheduled)
+	{
+		if (UWorld* World = GetWorld())
+		{
+			m_bFlushScheduled = true;
+			World->GetTimerManager().SetTimerForNextTick(this, &UCInventoryComponent::FlushChanges);
 		}
 	}
 }
-#endif  // 0
+
+void UCInventoryComponent::RecordAudit(const FCInventoryChange& Change)
+{
+	FCAuditLog& AuditLog = FCAuditLog::Get();
+
+	// Players may not have a player state or a net id yet when their first change is recorded
+	if (!m_bAuditOwnerResolved)
+	{
+		FString OwnerName;
+		m_bAuditOwnerResolved = GetAuditOwnerName(OwnerName);
+
+		if (m_bAuditOwnerResolved || m_AuditOwnerId == 0)
+		{
+			m_AuditOwnerId = AuditLog.GetNameId(OwnerName);
+		}
+	}
+
+	FCAuditRecord Record;
+	Record.Owner = m_AuditOwnerId;
+	Record.ItemDescriptor = AuditLog.GetDescriptorId(Change.ItemDescriptor);
+	Record.QuantityDelta = Change.QuantityDelta;
+	Record.ChangeType = static_cast<uint8>(Change.Type);
+	Record.Slot = static_cast<uint8>(Change.Slot);
+	Record.Rarity = static_cast<uint8>(Change.Rarity);
+
+	AuditLog.Record(Record);
+}
+
+bool UCInventoryComponent::GetAuditOwnerName(FString& OutName) const
+{
+	const AActor* Owner = GetOwner();
+
+	// Players are recorded by their net id so they can be followed across sessions
+	const APlayerState* PlayerState = Cast<APlayerState>(Owner);
+	const APawn* Pawn = Cast<APawn>(Owner);
+	const AController* Controller = Cast<AController>(Owner);
+
+	if (Pawn != nullptr)
+	{
+		PlayerState = Pawn->GetPlayerState();
+	}
+	else if (Controller != nullptr)
+	{
+		PlayerState = Controller->PlayerState;
+	}
+
+	if (PlayerState != nullptr && PlayerState->GetUniqueId().IsValid())
+	{
+		OutName = PlayerState->GetUniqueId().ToString();
+		return true;
+	}
+
+	OutName = GetPathName();
+
+	// Anything that is or may still become a player's is only resolved once the net id is known, a pawn may not be possessed yet
+	const bool bMaybePlayer = Cast<APlayerState>(Owner) != nullptr || (Pawn != nullptr && (Pawn->GetController() == nullptr || Pawn->IsPlayerControlled()))
+		|| (Controller != nullptr && Controller->IsPlayerController());
+	return !bMaybePlayer;
+}
+
+bool UCInventoryComponent::RemoveFromIndex(const int32 Index, const int32 Quantity)
+{
+	if (!m_Inventory.IsValidIndex(Index) || Quantity <= 0)
+	{
+		return false;
+	}
+
+	FCItem& Item = m_Inventory[Index];
+	if (Quantity >= Item.Quantity)
+	{
+		NotifyChange(ECInventoryChangeType::Removed, ECItemSlot::None, Index, Item, -Item.Quantity);
+		m_Inventory.RemoveAt(Index);
+	}
+	else
+	{
+		Item.Quantity -= Quantity;
+		NotifyChange(ECInventoryChangeType::Changed, ECItemSlot::None, Index, Item, -Quantity);
+	}
+
+	return true;
+}
+
+void UCInventoryComponent::NotifyItemReplaced(const int32 Index, const FCItem& OldItem, const FCItem& NewItem)
+{
+	if (OldItem == NewItem)
+	{
+		NotifyChange(ECInventoryChangeType::Changed, ECItemSlot::None, Index, NewItem, NewItem.Quantity - OldItem.Quantity, &OldItem);
+	}
+	else
+	{
+		// A different item is at this index now, most likely because something before it was removed or moved
+		NotifyChange(ECInventoryChangeType::Removed, ECItemSlot::None, Index, OldItem, -OldItem.Quantity);
+		NotifyChange(ECInventoryChangeType::Added, ECItemSlot::None, Index, NewItem, NewItem.Quantity);
+	}
+}
+
+void UCInventoryComponent::BroadcastChange(const FCInventoryChange& Change)
+{
+	switch (Change.Type)
+	{
+	case ECInventoryChangeType::Added:
+		OnItemAddedNative.Broadcast(Change);
+		OnItemAdded.Broadcast(Change.Index, Change.Slot, Change.QuantityDelta);
+		break;
+	case ECInventoryChangeType::Changed:
+		OnItemChangedNative.Broadcast(Change);
+		OnItemChanged.Broadcast(Change.Index, Change.Slot, Change.QuantityDelta);
+		break;
+	case ECInventoryChangeType::Removed:
+		OnItemRemovedNative.Broadcast(Change);
+		OnItemRemoved.Broadcast(Change.Index, Change.Slot, Change.QuantityDelta);
+		break;
+	case ECInventoryChangeType::Equipped:
+		OnItemEquippedNative.Broadcast(Change);
+		OnItemEquipped.Broadcast(Change.Slot, GetEquippableItemBySlot(Change.Slot));
+		break;
+	}
+}
 
 bool UCInventoryComponent::MoveItemToInventory(const FCItem& Item, UCInventoryComponent* InventoryReceiver)
 {
@@ -405,19 +2036,16 @@ bool UCInventoryComponent::MoveItemToInventory(const FCItem& Item, UCInventoryCo
 	return InventoryReceiver->AddItem(Item, ECItemSlot::None) && RemoveItem(Item, Item.Quantity);
 }
 
-ACItemActor* UCInventoryComponent::CreatePickup(const FCItem& Item, const int32 Quantity)
+bool UCInventoryComponent::CreatePickup(const FCItem& Item, const int32 Quantity)
 {
-	FTransform Transform;
-	if (ACItemActor* Pickup = GetWorld()->SpawnActorDeferred<ACItemActor>(Item.ItemDescriptor->GetPickupClass(), Transform))
-	{
-		Pickup->SetItemDescriptor(Item.ItemDescriptor);
-		Pickup->SetQuantity(Quantity);
-		Pickup->SetRarity(Item.Rarity);
-
-		Pickup->FinishSpawning(Transform);
+	const int32 PickupQuantity = Quantity == INDEX_NONE ? Item.Quantity : FMath::Min(Quantity, Item.Quantity);
+	const FTransform Transform(GetOwner()->GetActorLocation());
 
-		return Pickup;
+	// The subsystem may spawn the pickup as something other than an actor
+	if (UCPickupSubsystem* Subsystem = GetWorld()->GetSubsystem<UCPickupSubsystem>())
+	{
+		return Subsystem->SpawnPickup(Item, PickupQuantity, Transform);
 	}
 
-	return nullptr;
+	return ACItemActor::SpawnPickup(GetWorld(), Item, PickupQuantity, Transform) != nullptr;
 }
@@ -0,0 +1,364 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InventorySearch.h"
+
+#include <Internationalization/Culture.h>
+#include <Internationalization/Internationalization.h>
+
+void FCInventorySearchIndex::MarkRowDirty(const int32 Row)
+{
+	if (Row >= 0 && Row < m_FirstDirtyRow)
+	{
+		m_DirtyRows.Add(Row);
+	}
+}
+
+void FCInventorySearchIndex::MarkRowsDirtyFrom(const int32 Row)
+{
+	m_FirstDirtyRow = FMath::Min(m_FirstDirtyRow, FMath::Max(Row, 0));
+}
+
+void FCInventorySearchIndex::Reset()
+{
+	m_Rows.Empty();
+
+	for (TBitArray<>& Rows : m_CategoryRows)
+	{
+		Rows.Empty();
+	}
+
+	for (TBitArray<>& Rows : m_RarityRows)
+	{
+		Rows.Empty();
+	}
+
+	for (TBitArray<>& Rows : m_SlotRows)
+	{
+		Rows.Empty();
+	}
+
+	m_Titles.Empty();
+	m_TitleIds.Empty();
+	m_TitleGrams.Empty();
+	m_Culture.Empty();
+
+	m_FirstDirtyRow = 0;
+	m_DirtyRows.Empty();
+}
+
+TConstArrayView<int32> FCInventorySearchIndex::Search(TArrayView<const FCItem> Items, const FCInventorySearchQuery& Query)
+{
+	Sync(Items);
+
+	m_Results.Reset();
+
+	// Every filter narrows down a mask of rows, a filter that isn't set lets everything through
+	TBitArray<> Mask(true, m_Rows.Num());
+
+	const auto ApplyFilter = [&Mask](const TBitArray<>* RowSets, const int32 RowSetCount, const auto& IsInFilter)
+	{
+		TBitArray<> Union(false, Mask.Num());
+		for (int32 i = 0; i < RowSetCount; ++i)
+		{
+			if (IsInFilter(i))
+			{
+				Union.CombineWithBitwiseOR(RowSets[i], EBitwiseOperatorFlags::MaintainSize);
+			}
+		}
+
+		Mask.CombineWithBitwiseAND(Union, EBitwiseOperatorFlags::MaintainSize);
+	};
+
+	if (Query.Categories.Num() > 0)
+	{
+		ApplyFilter(m_CategoryRows, UE_ARRAY_COUNT(m_CategoryRows), [&Query](const int32 i) { return Query.Categories.Contains(static_cast<ECItemCategory>(i)); });
+	}
+
+	if (Query.Rarities.Num() > 0)
+	{
+		ApplyFilter(m_RarityRows, UE_ARRAY_COUNT(m_RarityRows), [&Query](const int32 i) { return Query.Rarities.Contains(static_cast<ECItemRarity>(i)); });
+	}
+
+	if (Query.ItemSlots != 0)
+	{
+		ApplyFilter(m_SlotRows, UE_ARRAY_COUNT(m_SlotRows), [&Query](const int32 i) { return (Query.ItemSlots & (1 << i)) != 0; });
+	}
+
+	// Match the words against the handful of distinct titles instead of against every row
+	TBitArray<> Titles;
+	const FString Text = NormalizeText(FText::AsCultureInvariant(Query.Text));
+	const bool bFilterText = !Text.IsEmpty();
+	if (bFilterText)
+	{
+		TArray<FString> Words;
+		Text.ParseIntoArray(Words, TEXT(" "));
+
+		Titles.Init(true, m_Titles.Num());
+		for (const FString& Word : Words)
+		{
+			TBitArray<> WordTitles(false, m_Titles.Num());
+			FindTitles(Word, WordTitles);
+			Titles.CombineWithBitwiseAND(WordTitles, EBitwiseOperatorFlags::MaintainSize);
+		}
+	}
+
+	for (TConstSetBitIterator<> It(Mask); It; ++It)
+	{
+		const FCSearchRow& Row = m_Rows[It.GetIndex()];
+
+		// Rows without a valid item are never in the index
+		if (Row.Title == INDEX_NONE || (bFilterText && !Titles[Row.Title]))
+		{
+			continue;
+		}
+
+		if (Query.bFilterScore && (Row.Score == INDEX_NONE || Row.Score < Query.ScoreRange.X || Row.Score > Query.ScoreRange.Y))
+		{
+			continue;
+		}
+
+		m_Results.Add(It.GetIndex());
+	}
+
+	return m_Results;
+}
+
+FString FCInventorySearchIndex::NormalizeText(const FText& Text)
+{
+	const FString Lower = Text.ToLower().ToString();
+
+	FString Normalized;
+	Normalized.Reserve(Lower.Len());
+
+	for (const TCHAR Char : Lower)
+	{
+		if (FChar::IsAlnum(Char))
+		{
+			Normalized.AppendChar(Char);
+		}
+		else if (Normalized.Len() > 0 && Normalized[Normalized.Len() - 1] != TEXT(' '))
+		{
+			Normalized.AppendChar(TEXT(' '));
+		}
+	}
+
+	Normalized.TrimEndInline();
+	return Normalized;
+}
+
+void FCInventorySearchIndex::Sync(TArrayView<const FCItem> Items)
+{
+	// Titles are lowercased in the current culture, they have to be indexed again once it changes
+	const FString Culture = FInternationalization::Get().GetCurrentLanguage()->GetName();
+	if (Culture != m_Culture)
+	{
+		Reset();
+		m_Culture = Culture;
+	}
+
+	for (const int32 Row : m_DirtyRows)
+	{
+		if (Row < m_FirstDirtyRow && Items.IsValidIndex(Row) && !m_Rows[Row].Matches(Items[Row]))
+		{
+			ClearRow(Row);
+			SetRow(Row, Items[Row]);
+		}
+	}
+
+	m_DirtyRows.Reset();
+
+	// Anything that changed the amount of items without saying so is caught here
+	const int32 FirstDirtyRow = FMath::Min3(m_FirstDirtyRow, m_Rows.Num(), Items.Num());
+
+	for (int32 Row = FirstDirtyRow; Row < m_Rows.Num(); ++Row)
+	{
+		if (Row >= Items.Num() || !m_Rows[Row].Matches(Items[Row]))
+		{
+			ClearRow(Row);
+		}
+	}
+
+	const int32 OldNum = m_Rows.Num();
+	const int32 NewNum = Items.Num();
+	if (NewNum != OldNum)
+	{
+		const auto Resize = [OldNum, NewNum](TBitArray<>& Rows)
+		{
+			if (NewNum > OldNum)
+			{
+				Rows.Add(false, NewNum - OldNum);
+			}
+			else
+			{
+				Rows.RemoveAt(NewNum, OldNum - NewNum);
+			}
+		};
+
+		for (TBitArray<>& Rows : m_CategoryRows)
+		{
+			Resize(Rows);
+		}
+
+		for (TBitArray<>& Rows : m_RarityRows)
+		{
+			Resize(Rows);
+		}
+
+		for (TBitArray<>& Rows : m_SlotRows)
+		{
+			Resize(Rows);
+		}
+
+		m_Rows.SetNum(NewNum);
+	}
+
+	for (int32 Row = FirstDirtyRow; Row < NewNum; ++Row)
+	{
+		if (m_Rows[Row].Title == INDEX_NONE)
+		{
+			SetRow(Row, Items[Row]);
+		}
+	}
+
+	m_FirstDirtyRow = MAX_int32;
+}
+
+void FCInventorySearchIndex::SetRow(const int32 Row, const FCItem& Item)
+{
+	if (Item.ItemDescriptor == nullptr || Item.Rarity >= ECItemRarity::MAX)
+	{
+		return;
+	}
+
+	FCSearchRow& SearchRow = m_Rows[Row];
+	SearchRow.ItemDescriptor = Item.ItemDescriptor;
+	SearchRow.Title = GetTitle(Item.ItemDescriptor);
+	SearchRow.Score = Item.Score;
+	SearchRow.ItemSlots = Item.ItemDescriptor->GetItemSlot();
+	SearchRow.Category = Item.ItemDescriptor->GetItemCategory();
+	SearchRow.Rarity = Item.Rarity;
+
+	SetRowBits(Row, true);
+}
+
+void FCInventorySearchIndex::ClearRow(const int32 Row)
+{
+	if (m_Rows[Row].Title != INDEX_NONE)
+	{
+		SetRowBits(Row, false);
+		m_Rows[Row] = FCSearchRow();
+	}
+}
+
+void FCInventorySearchIndex::SetRowBits(const int32 Row, const bool bValue)
+{
+	const FCSearchRow& SearchRow = m_Rows[Row];
+
+	m_CategoryRows[static_cast<int32>(SearchRow.Category)][Row] = bValue;
+	m_RarityRows[static_cast<int32>(SearchRow.Rarity)][Row] = bValue;
+
+	for (int32 Slot = 0; Slot < UE_ARRAY_COUNT(m_SlotRows); ++Slot)
+	{
+		if ((SearchRow.ItemSlots & (1 << Slot)) != 0)
+		{
+			m_SlotRows[Slot][Row] = bValue;
+		}
+	}
+}
+
+int32 FCInventorySearchIndex::GetTitle(const UCItemDescriptorBase* ItemDescriptor)
+{
+	if (const int32* Title = m_TitleIds.Find(TObjectKey<UCItemDescriptorBase>(ItemDescriptor)))
+	{
+		return *Title;
+	}
+
+	const int32 Title = m_Titles.Add(NormalizeText(ItemDescriptor->GetTitle()));
+	m_TitleIds.Add(TObjectKey<UCItemDescriptorBase>(ItemDescriptor), Title);
+
+	const auto AddGram = [this, Title](const TCHAR* Chars, const int32 Count)
+	{
+		TArray<int32>& Titles = m_TitleGrams.FindOrAdd(GetGramKey(Chars, Count));
+		if (Titles.Num() == 0 || Titles.Last() != Title)
+		{
+			Titles.Add(Title);
+		}
+	};
+
+	const FString& Text = m_Titles[Title];
+	for (int32 i = 0; i < Text.Len(); ++i)
+	{
+		if (Text[i] == TEXT(' '))
+		{
+			continue;
+		}
+
+		// Short prefixes are only indexed where a word starts
+		if (i == 0 || Text[i - 1] == TEXT(' '))
+		{
+			for (int32 Count = 1; Count < UnrealInventory::Search::GramSize && i + Count <= Text.Len() && Text[i + Count - 1] != TEXT(' '); ++Count)
+			{
+				AddGram(&Text[i], Count);
+			}
+		}
+
+		if (i + UnrealInventory::Search::GramSize <= Text.Len())
+		{
+			AddGram(&Text[i], UnrealInventory::Search::GramSize);
+		}
+	}
+
+	return Title;
+}
+
+void FCInventorySearchIndex::FindTitles(const FString& Word, TBitArray<>& OutTitles) const
+{
+	if (Word.Len() < UnrealInventory::Search::GramSize)
+	{
+		if (const TArray<int32>* Titles = m_TitleGrams.Find(GetGramKey(*Word, Word.Len())))
+		{
+			for (const int32 Title : *Titles)
+			{
+				OutTitles[Title] = true;
+			}
+		}
+
+		return;
+	}
+
+	// Start from the rarest gram of the word, every title containing the word has to contain all of them
+	const TArray<int32>* Candidates = nullptr;
+	for (int32 i = 0; i + UnrealInventory::Search::GramSize <= Word.Len(); ++i)
+	{
+		const TArray<int32>* Titles = m_TitleGrams.Find(GetGramKey(&Word[i], UnrealInventory::Search::GramSize));
+		if (Titles == nullptr)
+		{
+			return;
+		}
+
+		if (Candidates == nullptr || Titles->Num() < Candidates->Num())
+		{
+			Candidates = Titles;
+		}
+	}
+
+	for (const int32 Title : *Candidates)
+	{
+		if (m_Titles[Title].Contains(Word, ESearchCase::CaseSensitive))
+		{
+			OutTitles[Title] = true;
+		}
+	}
+}
+
+uint64 FCInventorySearchIndex::GetGramKey(const TCHAR* Chars, const int32 Count)
+{
+	// Code points fit into 21 bits, shorter prefixes are padded with zeroes which never show up in a title
+	uint64 Key = 0;
+	for (int32 i = 0; i < UnrealInventory::Search::GramSize; ++i)
+	{
+		Key = (Key << 21) | (i < Count ? static_cast<uint64>(Chars[i]) & 0x1FFFFF : 0);
+	}
+
+	return Key;
+}
@@ -3,6 +3,16 @@
 
 #include "Item.h"
 
+#include "AuditLog.h"
+#include "InventoryComponent.h"
+#include "ItemDataAsset.h"
+#include "NetProfiler.h"
+#include "PickupSubsystem.h"
+
+#include <Engine/NetDriver.h>
+#include <Net/Core/PushModel/PushModel.h>
+#include <Net/UnrealNetwork.h>
+
 ACItemActor::ACItemActor()
 {
 	PrimaryActorTick.bCanEverTick = false;
@@ -13,14 +23,189 @@ ACItemActor::ACItemActor()
 void ACItemActor::BeginPlay()
 {
 	Super::BeginPlay();
+
+	if (!HasAuthority())
+	{
+		return;
+	}
+
+	if (UCPickupSubsystem* Subsystem = GetWorld()->GetSubsystem<UCPickupSubsystem>())
+	{
+		Subsystem->RegisterPickup(this);
+
+		if (USceneComponent* Root = GetRootComponent())
+		{
+			Root->TransformUpdated.AddUObject(this, &ACItemActor::OnPickupMoved);
+		}
+	}
+
+	// Dynamic actors are still sent once before they go dormant so clients get the initial state
+	if (m_bDormantWhenIdle)
+	{
+		SetNetDormancy(DORM_DormantAll);
+	}
+}
+
+void ACItemActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (USceneComponent* Root = GetRootComponent())
+	{
+		Root->TransformUpdated.RemoveAll(this);
+	}
+
+	// The world may already be gone when the pickup is torn down with it
+	const UWorld* World = GetWorld();
+	if (UCPickupSubsystem* Subsystem = World != nullptr ? World->GetSubsystem<UCPickupSubsystem>() : nullptr)
+	{
+		Subsystem->UnregisterPickup(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+ACItemActor* ACItemActor::SpawnPickup(UWorld* World, const FCItem& Item, const int32 Quantity, const FTransform& Transform)
+{
+	if (World == nullptr || Item.ItemDescriptor == nullptr)
+	{
+		return nullptr;
+	}
+
+	const TSubclassOf<ACItemActor> PickupClass = Item.ItemDescriptor->GetPickupClass();
+	if (PickupClass == nullptr)
+	{
+		return nullptr;
+	}
+
+	if (ACItemActor* Pickup = World->SpawnActorDeferred<ACItemActor>(PickupClass, Transform))
+	{
+		Pickup->m_ItemState = Item;
+		Pickup->SetItemDescriptor(Item.ItemDescriptor);
+		Pickup->SetQuantity(Quantity);
+		Pickup->SetRarity(Item.Rarity);
+
+		Pickup->FinishSpawning(Transform);
+
+		return Pickup;
+	}
+
+	return nullptr;
+}
+
+FCItem ACItemActor::GetItem() const
+{
+	FCItem Item = m_ItemState;
+	Item.ItemDescriptor = m_ItemDescriptor;
+	Item.Quantity = m_Quantity;
+	Item.Rarity = m_Rarity;
+
+	return Item;
+}
+
+void ACItemActor::OnPickupMoved(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	if (UCPickupSubsystem* Subsystem = GetWorld()->GetSubsystem<UCPickupSubsystem>())
+	{
+		Subsystem->UpdatePickupCell(this);
+	}
+}
+
+bool ACItemActor::PickUp(UCInventoryComponent* Inventory)
+{
+	if (!HasAuthority())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("You can't pick up an item without authority"));
+		return false;
+	}
+
+	FCAuditScope AuditScope(ECAuditOp::Pickup);
+
+	if (Inventory == nullptr || m_ItemDescriptor == nullptr || m_Quantity <= 0)
+	{
+		return false;
+	}
+
+	if (!Inventory->AddItem(GetItem()))
+	{
+		return false;
+	}
+
+	// Destroying a dormant actor is still sent to clients so there's nothing to flush
+	Destroy();
+
+	return true;
 }
 
 void ACItemActor::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-	DOREPLIFETIME(ACItemActor, m_Quantity);
-	DOREPLIFETIME(ACItemActor, m_Rarity);
+	// Pickups hardly ever change once they're spawned so they're only compared after being marked dirty
+	FDoRepLifetimeParams Params;
+	Params.bIsPushBased = true;
+
+	DOREPLIFETIME_WITH_PARAMS(ACItemActor, m_Quantity, Params);
+	DOREPLIFETIME_WITH_PARAMS(ACItemActor, m_Rarity, Params);
+}
+
+void ACItemActor::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+	if (FCNetProfiler::IsEnabled())
+	{
+		ProfileReplication();
+	}
+
+	if (UnrealInventory::Net::ShouldValidatePushModel())
+	{
+		ValidatePushModel();
+	}
+}
+
+void ACItemActor::ValidatePushModel()
+{
+	if (m_bPushModelValidated)
+	{
+		if (m_Quantity != m_ValidatedQuantity && !m_bQuantityMarkedDirty)
+		{
+			UE_LOG(LogTemp, Error, TEXT("%s changed m_Quantity without marking it dirty, it won't replicate until something else does"), *GetPathName());
+		}
+
+		if (m_Rarity != m_ValidatedRarity && !m_bRarityMarkedDirty)
+		{
+			UE_LOG(LogTemp, Error, TEXT("%s changed m_Rarity without marking it dirty, it won't replicate until something else does"), *GetPathName());
+		}
+	}
+
+	m_ValidatedQuantity = m_Quantity;
+	m_ValidatedRarity = m_Rarity;
+	m_bPushModelValidated = true;
+
+	m_bQuantityMarkedDirty = false;
+	m_bRarityMarkedDirty = false;
+}
+
+void ACItemActor::ProfileReplication()
+{
+	FCNetProfiler& Profiler = FCNetProfiler::Get();
+
+	// Pickups replicate to everyone, relevancy is ignored so this is the worst case
+	const UNetDriver* NetDriver = GetNetDriver();
+	const int32 Connections = NetDriver != nullptr ? NetDriver->ClientConnections.Num() : 0;
+	Profiler.SampleConnections(Connections);
+
+	const FName ClassName = ACItemActor::StaticClass()->GetFName();
+
+	// Both properties are plain values the engine compares itself, there's no compare cost of ours worth timing so only the bits are recorded
+	const bool bQuantityChanged = m_Quantity != m_ProfiledQuantity;
+	Profiler.RecordProperty(ClassName, GET_MEMBER_NAME_CHECKED(ACItemActor, m_Quantity), bQuantityChanged ? UnrealInventory::Net::ElementHeaderBits + 32 : 0, 0, Connections);
+	m_ProfiledQuantity = m_Quantity;
+
+	// Enums are sent with just enough bits for their largest value
+	const bool bRarityChanged = m_Rarity != m_ProfiledRarity;
+	const int32 RarityBits = FMath::CeilLogTwo(static_cast<uint32>(ECItemRarity::MAX) + 1);
+	Profiler.RecordProperty(ClassName, GET_MEMBER_NAME_CHECKED(ACItemActor, m_Rarity), bRarityChanged ? UnrealInventory::Net::ElementHeaderBits + RarityBits : 0, 0, Connections);
+	m_ProfiledRarity = m_Rarity;
 }
 
 void ACItemActor::SetQuantity(const int32 NewQuantity)
@@ -30,7 +215,16 @@ void ACItemActor::SetQuantity(const int32 NewQuantity)
 		ServerSetQuantity(NewQuantity);
 	}
 
+	// Wake the pickup up for one update so clients see the change, it goes back to sleep on its own afterwards
+	if (HasAuthority() && m_Quantity != NewQuantity)
+	{
+		FlushNetDormancy();
+	}
+
 	m_Quantity = NewQuantity;
+
+	MARK_PROPERTY_DIRTY_FROM_NAME(ACItemActor, m_Quantity, this);
+	m_bQuantityMarkedDirty = true;
 }
 
 void ACItemActor::SetRarity(const ECItemRarity NewRarity)
@@ -40,7 +234,15 @@ void ACItemActor::SetRarity(const ECItemRarity NewRarity)
 		ServerSetRarity(NewRarity);
 	}
 
+	if (HasAuthority() && m_Rarity != NewRarity)
+	{
+		FlushNetDormancy();
+	}
+
 	m_Rarity = NewRarity;
+
+	MARK_PROPERTY_DIRTY_FROM_NAME(ACItemActor, m_Rarity, this);
+	m_bRarityMarkedDirty = true;
 }
 
 void ACItemActor::ServerSetQuantity_Implementation(const int32 NewQuantity)
@@ -50,7 +252,7 @@ void ACItemActor::ServerSetQuantity_Implementation(const int32 NewQuantity)
 
 bool ACItemActor::ServerSetQuantity_Validate(const int32 NewQuantity)
 {
-	return true;
+	return NewQuantity > 0 && (m_ItemDescriptor == nullptr || NewQuantity <= m_ItemDescriptor->GetStackSize());
 }
 
 void ACItemActor::ServerSetRarity_Implementation(const ECItemRarity NewRarity)
@@ -60,6 +262,6 @@ void ACItemActor::ServerSetRarity_Implementation(const ECItemRarity NewRarity)
 
 bool ACItemActor::ServerSetRarity_Validate(const ECItemRarity NewRarity)
 {
-	return true;
+	return NewRarity < ECItemRarity::MAX;
 }
 
@@ -3,11 +3,318 @@
 
 #include "ItemDataAsset.h"
 
+#include "ItemValuation.h"
+#include "NetProfiler.h"
+
+#include <AssetRegistry/AssetData.h>
+#include <Engine/Engine.h>
+#include <Engine/World.h>
+#include <GameFramework/GameStateBase.h>
+#include <UObject/AssetRegistryTagsContext.h>
+#include <UObject/ObjectSaveContext.h>
+
+#if WITH_EDITOR
+#include <Misc/DataValidation.h>
+#endif
+
+const FName FCItemDescriptorSummary::ScoreRangesTag(TEXT("ScoreRanges"));
+const FName FCItemDescriptorSummary::WeightsTag(TEXT("Weights"));
+
 const FCItemRarityData& UCItemDescriptorBase::GetRarityData(const ECItemRarity Rarity) const
 {
 	return m_Rarity[static_cast<uint8>(Rarity)];
 }
 
+void UCItemDescriptorBase::PostLoad()
+{
+	Super::PostLoad();
+
+	FCItemValuation::Get().Register(this);
+}
+
+void UCItemDescriptorBase::BeginDestroy()
+{
+	FCItemValuation::Get().Unregister(this);
+
+	Super::BeginDestroy();
+}
+
+void UCItemDescriptorBase::PreSave(FObjectPreSaveContext ObjectSaveContext)
+{
+	Super::PreSave(ObjectSaveContext);
+
+#if WITH_EDITOR
+	if (!ObjectSaveContext.IsCooking())
+	{
+		return;
+	}
+
+	// A cooked build can't be fixed by hand, so data that breaks the inventory fails the cook instead of shipping. The asset is left as it is
+	TArray<FText> Errors;
+	FCItemDescriptorSummary(*this).Validate(Errors);
+
+	for (const FText& Error : Errors)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Can't cook %s: %s"), *GetPathName(), *Error.ToString());
+	}
+#endif
+}
+
+void UCItemDescriptorBase::GetAssetRegistryTags(FAssetRegistryTagsContext Context) const
+{
+	Super::GetAssetRegistryTags(Context);
+
+	// The rarity data can't be searchable on its own, so it's written out here for the validation commandlet
+	const FCItemDescriptorSummary Summary(*this);
+	Context.AddTag(FAssetRegistryTag(FCItemDescriptorSummary::ScoreRangesTag, Summary.GetScoreRangesTag(), FAssetRegistryTag::TT_Hidden));
+	Context.AddTag(FAssetRegistryTag(FCItemDescriptorSummary::WeightsTag, Summary.GetWeightsTag(), FAssetRegistryTag::TT_Hidden));
+}
+
+#if WITH_EDITOR
+void UCItemDescriptorBase::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	// Keep the valuation table in sync with the values being edited
+	FCItemValuation::Get().Register(this);
+}
+
+EDataValidationResult UCItemDescriptorBase::IsDataValid(FDataValidationContext& Context) const
+{
+	EDataValidationResult Result = Super::IsDataValid(Context);
+
+	TArray<FText> Errors;
+	FCItemDescriptorSummary(*this).Validate(Errors);
+
+	for (const FText& Error : Errors)
+	{
+		Context.AddError(Error);
+	}
+
+	return Errors.Num() > 0 ? EDataValidationResult::Invalid : CombineDataValidationResults(Result, EDataValidationResult::Valid);
+}
+#endif
+
+FCItemDescriptorSummary::FCItemDescriptorSummary(const UCItemDescriptorBase& ItemDescriptor)
+	: StackSize(ItemDescriptor.m_StackSize), ItemSlot(ItemDescriptor.m_ItemSlot), bHasPickupClass(!ItemDescriptor.m_PickupClass.IsNull())
+{
+	for (int32 i = 0; i < static_cast<int32>(ECItemRarity::MAX); ++i)
+	{
+		ScoreRanges[i] = ItemDescriptor.m_Rarity[i].ScoreRange;
+		Weights[i] = ItemDescriptor.m_Rarity[i].Weight;
+	}
+}
+
+bool FCItemDescriptorSummary::Read(const FAssetData& AssetData)
+{
+	FString PickupClass;
+	FString ScoreRangesValue;
+	FString WeightsValue;
+
+	if (!AssetData.GetTagValue(GET_MEMBER_NAME_CHECKED(UCItemDescriptorBase, m_StackSize), StackSize) ||
+		!AssetData.GetTagValue(GET_MEMBER_NAME_CHECKED(UCItemDescriptorBase, m_ItemSlot), ItemSlot) ||
+		!AssetData.GetTagValue(GET_MEMBER_NAME_CHECKED(UCItemDescriptorBase, m_PickupClass), PickupClass) ||
+		!AssetData.GetTagValue(ScoreRangesTag, ScoreRangesValue) ||
+		!AssetData.GetTagValue(WeightsTag, WeightsValue))
+	{
+		return false;
+	}
+
+	bHasPickupClass = !PickupClass.IsEmpty() && PickupClass != TEXT("None");
+
+	TArray<FString> Ranges;
+	TArray<FString> RarityWeights;
+	ScoreRangesValue.ParseIntoArray(Ranges, TEXT(" "));
+	WeightsValue.ParseIntoArray(RarityWeights, TEXT(" "));
+
+	if (Ranges.Num() != static_cast<int32>(ECItemRarity::MAX) || RarityWeights.Num() != static_cast<int32>(ECItemRarity::MAX))
+	{
+		return false;
+	}
+
+	for (int32 i = 0; i < static_cast<int32>(ECItemRarity::MAX); ++i)
+	{
+		FString Min;
+		FString Max;
+		if (!Ranges[i].Split(TEXT(","), &Min, &Max))
+		{
+			return false;
+		}
+
+		ScoreRanges[i] = FIntPoint(FCString::Atoi(*Min), FCString::Atoi(*Max));
+		Weights[i] = FCString::Atof(*RarityWeights[i]);
+	}
+
+	return true;
+}
+
+void FCItemDescriptorSummary::Validate(TArray<FText>& OutErrors) const
+{
+	if (StackSize < 1)
+	{
+		OutErrors.Add(FText::FromString(FString::Printf(TEXT("Max Stack Size is %d, it has to be at least 1"), StackSize)));
+	}
+
+	if ((ItemSlot & ~((1 << static_cast<int32>(ECItemSlot::MAX)) - 1)) != 0)
+	{
+		OutErrors.Add(FText::FromString(FString::Printf(TEXT("Item Slot 0x%x has bits set that aren't a slot"), ItemSlot)));
+	}
+
+	if (!bHasPickupClass)
+	{
+		OutErrors.Add(FText::FromString(TEXT("There's no Pickup Class so the item can't be dropped into the world")));
+	}
+
+	for (int32 i = 0; i < static_cast<int32>(ECItemRarity::MAX); ++i)
+	{
+		const FString Rarity = StaticEnum<ECItemRarity>()->GetNameStringByIndex(i);
+
+		if (ScoreRanges[i].X > ScoreRanges[i].Y)
+		{
+			OutErrors.Add(FText::FromString(FString::Printf(TEXT("The %s Score Range %d-%d is inverted"), *Rarity, ScoreRanges[i].X, ScoreRanges[i].Y)));
+		}
+
+		if (Weights[i] < 0.0f)
+		{
+			OutErrors.Add(FText::FromString(FString::Printf(TEXT("The %s Weight is %g, it can't be negative"), *Rarity, Weights[i])));
+		}
+	}
+}
+
+FString FCItemDescriptorSummary::GetScoreRangesTag() const
+{
+	FString Value;
+	for (const FIntPoint& ScoreRange : ScoreRanges)
+	{
+		Value += FString::Printf(TEXT("%s%d,%d"), Value.IsEmpty() ? TEXT("") : TEXT(" "), ScoreRange.X, ScoreRange.Y);
+	}
+
+	return Value;
+}
+
+FString FCItemDescriptorSummary::GetWeightsTag() const
+{
+	FString Value;
+	for (const float Weight : Weights)
+	{
+		Value += FString::Printf(TEXT("%s%g"), Value.IsEmpty() ? TEXT("") : TEXT(" "), Weight);
+	}
+
+	return Value;
+}
+
+bool FCItem::Identical(const FCItem* Other, uint32 PortFlags) const
+{
+	if (!FCNetProfiler::IsEnabled())
+	{
+		return IsNetIdentical(*Other);
+	}
+
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	const bool bIdentical = IsNetIdentical(*Other);
+	FCNetProfiler::Get().RecordItemCompare(bIdentical, FPlatformTime::Cycles64() - StartCycles);
+
+	return bIdentical;
+}
+
+bool FCItem::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	bOutSuccess = true;
+
+	UObject* Descriptor = ItemDescriptor;
+	bOutSuccess &= Map->SerializeObject(Ar, UCItemDescriptorBase::StaticClass(), Descriptor);
+
+	uint32 PackedQuantity = static_cast<uint32>(FMath::Max(Quantity, 0));
+	Ar.SerializeIntPacked(PackedQuantity);
+
+	uint8 RarityValue = static_cast<uint8>(Rarity);
+	Ar.SerializeBits(&RarityValue, 3);
+
+	// Only send what the item actually uses. The score is left out if the client can rebuild it from the seed, it's sent as well
+	// when the rarity, the score range or the score itself changed since it was generated
+	const bool bHasSeed = Seed != 0;
+	uint8 bHasHealth = Health >= 0.0f ? 1 : 0;
+	uint8 bHasSeedBit = bHasSeed ? 1 : 0;
+	uint8 bHasScore = (bHasSeed ? GetSeededScore() != Score : Score != INDEX_NONE) ? 1 : 0;
+
+	Ar.SerializeBits(&bHasHealth, 1);
+	Ar.SerializeBits(&bHasSeedBit, 1);
+	Ar.SerializeBits(&bHasScore, 1);
+
+	if (bHasHealth)
+	{
+		Ar << Health;
+		Ar << HealthTimestamp;
+	}
+
+	if (bHasSeedBit)
+	{
+		Ar << Seed;
+	}
+
+	if (bHasScore)
+	{
+		uint32 PackedScore = static_cast<uint32>(Score);
+		Ar.SerializeIntPacked(PackedScore);
+
+		if (Ar.IsLoading())
+		{
+			Score = static_cast<int32>(PackedScore);
+		}
+	}
+
+	if (Ar.IsLoading())
+	{
+		ItemDescriptor = Cast<UCItemDescriptorBase>(Descriptor);
+		Quantity = static_cast<int32>(PackedQuantity);
+		Rarity = static_cast<ECItemRarity>(FMath::Min<uint8>(RarityValue, static_cast<uint8>(ECItemRarity::MAX) - 1));
+
+		if (!bHasHealth)
+		{
+			Health = -1.0f;
+			HealthTimestamp = -1.0f;
+		}
+
+		if (bHasSeedBit)
+		{
+			// The score isn't sent if it's what the seed gives
+			if (!bHasScore)
+			{
+				Score = GetSeededScore();
+			}
+		}
+		else
+		{
+			Seed = 0;
+
+			if (!bHasScore)
+			{
+				Score = INDEX_NONE;
+			}
+		}
+	}
+
+	// Ar isn't always a bit writer, demo recording for one saves through other archives, so the size is measured separately
+	if (Ar.IsSaving() && FCNetProfiler::IsEnabled())
+	{
+		FCNetProfiler::Get().RecordItemSerialize(*this);
+	}
+
+	return true;
+}
+
+float UCItemStatics::GetServerTime(const UObject* WorldContextObject)
+{
+	const UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull);
+	if (World == nullptr)
+	{
+		return 0.0f;
+	}
+
+	const AGameStateBase* GameState = World->GetGameState();
+	return GameState != nullptr ? GameState->GetServerWorldTimeSeconds() : World->GetTimeSeconds();
+}
+
 TSubclassOf<ACItemActor> UCItemDescriptorBase::GetPickupClass() const
 {
 	if (m_PickupClass.IsPending())
@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ItemRandom.h"
+
+#include "ItemDataAsset.h"
+
+#include <Async/ParallelFor.h>
+#include <Misc/Guid.h>
+
+#include <atomic>
+
+namespace UnrealInventory
+{
+	namespace Random
+	{
+		/** Batches smaller than this aren't worth spreading over the task graph. */
+		static constexpr int32 ParallelBatchSize = 1024;
+
+		uint32 NewSeed()
+		{
+			// Every call hashes a new counter value against a salt that's different every session
+			static const uint32 SessionSalt = []()
+			{
+				const FGuid Guid = FGuid::NewGuid();
+				return Guid.A ^ Guid.B ^ Guid.C ^ Guid.D;
+			}();
+			static std::atomic<uint32> Counter{0};
+
+			return Hash(SessionSalt, Counter.fetch_add(1, std::memory_order_relaxed)) | 1u;
+		}
+
+		void GenerateScores(TArrayView<FCItem> Items, const uint32 Seed, const uint32 FirstIndex)
+		{
+			const auto GenerateScore = [&Items, Seed, FirstIndex](const int32 Index)
+			{
+				FCItem& Item = Items[Index];
+				if (Item.ItemDescriptor != nullptr && Item.ItemDescriptor->GetStackSize() <= 1 && Item.Score == INDEX_NONE)
+				{
+					Item.GenerateScore(Hash(Seed, FirstIndex + Index));
+				}
+			};
+
+			if (Items.Num() < ParallelBatchSize)
+			{
+				for (int32 i = 0; i < Items.Num(); ++i)
+				{
+					GenerateScore(i);
+				}
+			}
+			else
+			{
+				ParallelFor(Items.Num(), GenerateScore);
+			}
+		}
+	};
+};
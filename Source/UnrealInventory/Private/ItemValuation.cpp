@@ -0,0 +1,171 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ItemValuation.h"
+
+#include "InventoryComponent.h"
+
+#include <Async/ParallelFor.h>
+#include <Engine/World.h>
+#include <HAL/IConsoleManager.h>
+#include <UObject/UObjectIterator.h>
+
+namespace UnrealInventory
+{
+	namespace Valuation
+	{
+		/** Items per task when a batch is spread over worker threads, smaller batches aren't worth it. */
+		static constexpr int32 ParallelBatchSize = 4096;
+	};
+};
+
+FCItemValuation& FCItemValuation::Get()
+{
+	static FCItemValuation Valuation;
+	return Valuation;
+}
+
+void FCItemValuation::Register(const UCItemDescriptorBase* ItemDescriptor)
+{
+	if (ItemDescriptor == nullptr || ItemDescriptor->HasAnyFlags(RF_ClassDefaultObject))
+	{
+		return;
+	}
+
+	check(IsInGameThread());
+
+	if (ItemDescriptor->m_ValuationRow == INDEX_NONE)
+	{
+		if (m_FreeRows.Num() > 0)
+		{
+			ItemDescriptor->m_ValuationRow = m_FreeRows.Pop(EAllowShrinking::No);
+		}
+		else
+		{
+			ItemDescriptor->m_ValuationRow = m_Values.Num() / RowStride;
+			m_Values.AddZeroed(RowStride);
+		}
+	}
+
+	float* Row = &m_Values[ItemDescriptor->m_ValuationRow * RowStride];
+	for (int32 Rarity = 0; Rarity < static_cast<int32>(ECItemRarity::MAX); ++Rarity)
+	{
+		const FCItemRarityData& RarityData = ItemDescriptor->GetRarityData(static_cast<ECItemRarity>(Rarity));
+		for (int32 HealthGroup = 0; HealthGroup < RarityStride; ++HealthGroup)
+		{
+			Row[Rarity * RarityStride + HealthGroup] = RarityData.Value[HealthGroup];
+		}
+	}
+}
+
+void FCItemValuation::Unregister(const UCItemDescriptorBase* ItemDescriptor)
+{
+	if (ItemDescriptor == nullptr || ItemDescriptor->m_ValuationRow == INDEX_NONE)
+	{
+		return;
+	}
+
+	check(IsInGameThread());
+
+	m_FreeRows.Add(ItemDescriptor->m_ValuationRow);
+	ItemDescriptor->m_ValuationRow = INDEX_NONE;
+}
+
+int32 FCItemValuation::GetRow(const UCItemDescriptorBase* ItemDescriptor)
+{
+	if (ItemDescriptor->m_ValuationRow == INDEX_NONE)
+	{
+		Register(ItemDescriptor);
+	}
+
+	return ItemDescriptor->m_ValuationRow;
+}
+
+float FCItemValuation::GetUnitValue(const UCItemDescriptorBase* ItemDescriptor, const ECItemRarity Rarity, const ECItemHealthGroup HealthGroup)
+{
+	if (ItemDescriptor == nullptr || Rarity >= ECItemRarity::MAX || HealthGroup >= ECItemHealthGroup::MAX)
+	{
+		return 0.0f;
+	}
+
+	return m_Values[GetRow(ItemDescriptor) * RowStride + static_cast<int32>(Rarity) * RarityStride + static_cast<int32>(HealthGroup)];
+}
+
+float FCItemValuation::GetValue(const FCItem& Item, const float Health)
+{
+	if (Item.ItemDescriptor == nullptr)
+	{
+		return 0.0f;
+	}
+
+	return m_Values[GetRow(Item.ItemDescriptor) * RowStride + static_cast<int32>(Item.Rarity) * RarityStride + GetHealthGroupIndex(Health)] * Item.Quantity;
+}
+
+void FCItemValuation::GetValues(TArrayView<const FCItem> Items, TArrayView<float> OutValues)
+{
+	check(OutValues.Num() >= Items.Num());
+
+	// Give every descriptor a row up front so the table is only read from here on
+	for (const FCItem& Item : Items)
+	{
+		if (Item.ItemDescriptor != nullptr)
+		{
+			GetRow(Item.ItemDescriptor);
+		}
+	}
+
+	const auto GetBatchValues = [this, &Items, &OutValues](const int32 Batch)
+	{
+		const int32 First = Batch * UnrealInventory::Valuation::ParallelBatchSize;
+		const int32 End = FMath::Min(First + UnrealInventory::Valuation::ParallelBatchSize, Items.Num());
+
+		for (int32 i = First; i < End; ++i)
+		{
+			OutValues[i] = GetValueFromRow(Items[i]);
+		}
+	};
+
+	const int32 BatchCount = FMath::DivideAndRoundUp(Items.Num(), UnrealInventory::Valuation::ParallelBatchSize);
+	if (BatchCount <= 1)
+	{
+		GetBatchValues(0);
+	}
+	else
+	{
+		ParallelFor(BatchCount, GetBatchValues);
+	}
+}
+
+double FCItemValuation::GetTotalValue(TArrayView<const FCItem> Items)
+{
+	TArray<float> Values;
+	Values.SetNumUninitialized(Items.Num());
+	GetValues(Items, Values);
+
+	double Total = 0.0;
+	for (const float Value : Values)
+	{
+		Total += Value;
+	}
+
+	return Total;
+}
+
+static FAutoConsoleCommandWithWorld GEconomyValueCommand(
+	TEXT("UnrealInventory.Economy.Value"),
+	TEXT("Log how many inventories there are in the world and what everything in them is worth."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		int32 InventoryCount = 0;
+		double TotalValue = 0.0;
+
+		for (TObjectIterator<UCInventoryComponent> It; It; ++It)
+		{
+			if (It->GetWorld() == World && !It->HasAnyFlags(RF_ClassDefaultObject))
+			{
+				++InventoryCount;
+				TotalValue += It->GetTotalValue();
+			}
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("%d inventories worth %.0f in total."), InventoryCount, TotalValue);
+	}));
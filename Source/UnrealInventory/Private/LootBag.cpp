@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "LootBag.h"
+
+#include "LootTable.h"
+#include "StorageComponent.h"
+
+ACLootBagActor::ACLootBagActor()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	SetReplicates(true);
+
+	m_Storage = CreateDefaultSubobject<UCStorageComponent>(TEXT("Storage"));
+}
+
+void ACLootBagActor::GenerateLoot(const UCLootTable* LootTable, const int32 Seed)
+{
+	if (LootTable == nullptr || !HasAuthority())
+	{
+		return;
+	}
+
+	TArray<FCItem> Items;
+	LootTable->GenerateLoot(Seed, Items);
+
+	AddLoot(Items);
+}
+
+bool ACLootBagActor::AddLoot(const TArray<FCItem>& Items)
+{
+	TArray<FCItem> Remaining;
+	m_Storage->AddItems(Items, Remaining);
+
+	return Remaining.Num() == 0;
+}
+
+int32 ACLootBagActor::TakeAll(UCInventoryComponent* Looter)
+{
+	if (Looter == nullptr || !HasAuthority())
+	{
+		return 0;
+	}
+
+	const int32 MovedCount = m_Storage->MoveAllItemsTo(Looter);
+
+	if (m_Storage->GetInventory().Num() == 0)
+	{
+		Destroy();
+	}
+
+	return MovedCount;
+}
+
+int32 ACLootBagActor::TakeBest(UCInventoryComponent* Looter)
+{
+	if (Looter == nullptr || !HasAuthority())
+	{
+		return 0;
+	}
+
+	const int32 TakenCount = Looter->TakeBestFrom(m_Storage);
+
+	if (m_Storage->GetInventory().Num() == 0)
+	{
+		Destroy();
+	}
+
+	return TakenCount;
+}
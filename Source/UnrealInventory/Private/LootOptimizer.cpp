@@ -0,0 +1,431 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "LootOptimizer.h"
+
+#include "ItemDataAsset.h"
+#include "ItemValuation.h"
+
+/** Part of a candidate stack, runs of a group are sorted by value so the best units are always taken first. */
+struct FCLootRun
+{
+	int32 Index = INDEX_NONE;
+	int32 Quantity = 0;
+	float UnitValue = 0.0f;
+};
+
+/** Every stackable candidate of one descriptor and rarity, they all end up in the same stacks once they're added. */
+struct FCLootGroup
+{
+	const UCItemDescriptorBase* ItemDescriptor = nullptr;
+	ECItemRarity Rarity = ECItemRarity::Common;
+
+	float UnitWeight = 0.0f;
+	int32 StackSize = 1;
+
+	/** How many units fit into the stacks already in the inventory. */
+	int32 FreeRoom = 0;
+
+	TArray<FCLootRun, TInlineAllocator<4>> Runs;
+	int32 TotalUnits = 0;
+	int32 TakenUnits = 0;
+
+	/** How many new stacks the taken units need. */
+	int32 GetSlots(const int32 Units) const { return FMath::DivideAndRoundUp(FMath::Max(0, Units - FreeRoom), StackSize); }
+};
+
+/** A choice for the solver, either the units of a group that fill one stack or a whole item that doesn't stack. */
+struct FCLootBlock
+{
+	/** INDEX_NONE for items that don't stack. */
+	int32 Group = INDEX_NONE;
+	int32 Candidate = INDEX_NONE;
+
+	int32 Units = 0;
+	int32 Slots = 0;
+	float Weight = 0.0f;
+	float Value = 0.0f;
+
+	double Density = 0.0;
+};
+
+static float GetUnitValue(const FCItem& Item, const float ServerTime)
+{
+	const ECItemHealthGroup HealthGroup = static_cast<ECItemHealthGroup>(FCItemValuation::GetHealthGroupIndex(Item.GetHealth(ServerTime)));
+	return FCItemValuation::Get().GetUnitValue(Item.ItemDescriptor, Item.Rarity, HealthGroup);
+}
+
+/** Add up the weight, slots and value of the chosen blocks, returns false if they don't fit. */
+static bool MeasureBlocks(TArrayView<const FCLootBlock> Blocks, const TBitArray<>& Chosen, const float RemainingWeight, const int32 RemainingSlots, float& OutValue)
+{
+	double Weight = 0.0;
+	int32 Slots = 0;
+	OutValue = 0.0f;
+
+	for (TConstSetBitIterator<> It(Chosen); It; ++It)
+	{
+		const FCLootBlock& Block = Blocks[It.GetIndex()];
+		Weight += Block.Weight;
+		Slots += Block.Slots;
+		OutValue += Block.Value;
+	}
+
+	return Weight <= RemainingWeight && Slots <= RemainingSlots;
+}
+
+/** Take every block from First on that still fits, in order. */
+static void FillGreedy(TArrayView<const FCLootBlock> Blocks, const int32 First, TBitArray<>& Chosen, double& Weight, int32& Slots, const float RemainingWeight, const int32 RemainingSlots, int32* OutBreak = nullptr)
+{
+	for (int32 i = First; i < Blocks.Num(); ++i)
+	{
+		const FCLootBlock& Block = Blocks[i];
+		if (Weight + Block.Weight <= RemainingWeight && Slots + Block.Slots <= RemainingSlots)
+		{
+			Chosen[i] = true;
+			Weight += Block.Weight;
+			Slots += Block.Slots;
+		}
+		else if (OutBreak != nullptr && *OutBreak == INDEX_NONE)
+		{
+			*OutBreak = i;
+		}
+	}
+}
+
+/** 0/1 knapsack over the core blocks with the weight split into buckets, the chosen blocks are written to Chosen. */
+static void SolveCore(TArrayView<const FCLootBlock> Blocks, const int32 Start, const int32 End, const float RemainingWeight, const int32 RemainingSlots, TBitArray<>& Chosen)
+{
+	const int32 Count = End - Start;
+	const int32 SlotCapacity = FMath::Clamp(RemainingSlots, 0, Count);
+
+	// Without a weight limit only the slots matter
+	const bool bWeightLimited = RemainingWeight < TNumericLimits<float>::Max();
+	const int32 WeightCapacity = bWeightLimited ? UnrealInventory::Loot::WeightBuckets : 0;
+	const float BucketSize = bWeightLimited ? RemainingWeight / UnrealInventory::Loot::WeightBuckets : 0.0f;
+
+	TArray<int32, TInlineAllocator<UnrealInventory::Loot::CoreSize>> BlockBuckets;
+	BlockBuckets.SetNumUninitialized(Count);
+
+	for (int32 i = 0; i < Count; ++i)
+	{
+		const float Weight = Blocks[Start + i].Weight;
+		if (!bWeightLimited || Weight <= 0.0f)
+		{
+			BlockBuckets[i] = 0;
+		}
+		else
+		{
+			// Round up so whatever the buckets say fits really does
+			BlockBuckets[i] = BucketSize > 0.0f ? FMath::CeilToInt(Weight / BucketSize) : WeightCapacity + 1;
+		}
+	}
+
+	const int32 Stride = WeightCapacity + 1;
+	const int32 TableSize = (SlotCapacity + 1) * Stride;
+
+	TArray<float> Values;
+	Values.SetNumZeroed(TableSize);
+
+	TBitArray<> Keep(false, Count * TableSize);
+
+	for (int32 i = 0; i < Count; ++i)
+	{
+		const FCLootBlock& Block = Blocks[Start + i];
+		const int32 BlockBucket = BlockBuckets[i];
+
+		if (BlockBucket > WeightCapacity || Block.Slots > SlotCapacity)
+		{
+			continue;
+		}
+
+		for (int32 Slot = SlotCapacity; Slot >= Block.Slots; --Slot)
+		{
+			for (int32 Bucket = WeightCapacity; Bucket >= BlockBucket; --Bucket)
+			{
+				const float Candidate = Values[(Slot - Block.Slots) * Stride + Bucket - BlockBucket] + Block.Value;
+				float& Best = Values[Slot * Stride + Bucket];
+
+				if (Candidate > Best)
+				{
+					Best = Candidate;
+					Keep[i * TableSize + Slot * Stride + Bucket] = true;
+				}
+			}
+		}
+	}
+
+	int32 Slot = SlotCapacity;
+	int32 Bucket = WeightCapacity;
+
+	for (int32 i = Count - 1; i >= 0; --i)
+	{
+		if (Keep[i * TableSize + Slot * Stride + Bucket])
+		{
+			Chosen[Start + i] = true;
+			Slot -= Blocks[Start + i].Slots;
+			Bucket -= BlockBuckets[i];
+		}
+	}
+}
+
+float UnrealInventory::Loot::SelectBestLoot(TArrayView<const FCItem> Inventory, TArrayView<const FCItem> Candidates, const float RemainingWeight, const int32 RemainingSlots, const float ServerTime, TArray<FCLootPick>& OutPicks)
+{
+	OutPicks.Reset();
+
+	if (RemainingWeight <= 0.0f || RemainingSlots <= 0 || Candidates.Num() == 0)
+	{
+		return 0.0f;
+	}
+
+	// Group the stackable candidates, they all go into the same stacks no matter which stack they came from
+	TArray<FCLootGroup> Groups;
+	TMap<TPair<const UCItemDescriptorBase*, ECItemRarity>, int32> GroupIndices;
+	TArray<FCLootBlock> Blocks;
+
+	for (int32 i = 0; i < Candidates.Num(); ++i)
+	{
+		const FCItem& Candidate = Candidates[i];
+		if (!Candidate.IsItemValid())
+		{
+			continue;
+		}
+
+		const float UnitValue = GetUnitValue(Candidate, ServerTime);
+		if (UnitValue <= 0.0f)
+		{
+			continue;
+		}
+
+		if (Candidate.Score != INDEX_NONE)
+		{
+			FCLootBlock& Block = Blocks.AddDefaulted_GetRef();
+			Block.Candidate = i;
+			Block.Units = Candidate.Quantity;
+			Block.Slots = 1;
+			Block.Weight = Candidate.GetTotalWeight();
+			Block.Value = UnitValue * Candidate.Quantity;
+			continue;
+		}
+
+		const TPair<const UCItemDescriptorBase*, ECItemRarity> Key(Candidate.ItemDescriptor, Candidate.Rarity);
+		int32& GroupIndex = GroupIndices.FindOrAdd(Key, INDEX_NONE);
+		if (GroupIndex == INDEX_NONE)
+		{
+			GroupIndex = Groups.AddDefaulted();
+
+			FCLootGroup& Group = Groups[GroupIndex];
+			Group.ItemDescriptor = Candidate.ItemDescriptor;
+			Group.Rarity = Candidate.Rarity;
+			Group.UnitWeight = Candidate.ItemDescriptor->GetRarityData(Candidate.Rarity).Weight;
+			Group.StackSize = FMath::Max(1, Candidate.ItemDescriptor->GetStackSize());
+		}
+
+		FCLootGroup& Group = Groups[GroupIndex];
+		Group.Runs.Add({i, Candidate.Quantity, UnitValue});
+		Group.TotalUnits += Candidate.Quantity;
+	}
+
+	// The same rules AddItem uses to top up stacks
+	for (const FCItem& Item : Inventory)
+	{
+		if (Item.Score != INDEX_NONE)
+		{
+			continue;
+		}
+
+		if (const int32* GroupIndex = GroupIndices.Find(TPair<const UCItemDescriptorBase*, ECItemRarity>(Item.ItemDescriptor, Item.Rarity)))
+		{
+			FCLootGroup& Group = Groups[*GroupIndex];
+			Group.FreeRoom += FMath::Max(0, Group.StackSize - Item.Quantity);
+		}
+	}
+
+	// Split every group into the units that top up existing stacks and then one block per new stack, best units first
+	for (int32 GroupIndex = 0; GroupIndex < Groups.Num(); ++GroupIndex)
+	{
+		FCLootGroup& Group = Groups[GroupIndex];
+		Group.Runs.Sort([](const FCLootRun& A, const FCLootRun& B) { return A.UnitValue > B.UnitValue; });
+
+		int32 RunIndex = 0;
+		int32 RunUsed = 0;
+		int32 UnitsLeft = Group.TotalUnits;
+
+		auto AddBlock = [&](const int32 Units, const int32 Slots)
+		{
+			FCLootBlock& Block = Blocks.AddDefaulted_GetRef();
+			Block.Group = GroupIndex;
+			Block.Units = Units;
+			Block.Slots = Slots;
+			Block.Weight = Group.UnitWeight * Units;
+
+			for (int32 Remaining = Units; Remaining > 0;)
+			{
+				const FCLootRun& Run = Group.Runs[RunIndex];
+				const int32 Taken = FMath::Min(Remaining, Run.Quantity - RunUsed);
+
+				Block.Value += Run.UnitValue * Taken;
+				Remaining -= Taken;
+				RunUsed += Taken;
+
+				if (RunUsed == Run.Quantity)
+				{
+					++RunIndex;
+					RunUsed = 0;
+				}
+			}
+
+			UnitsLeft -= Units;
+		};
+
+		if (Group.FreeRoom > 0)
+		{
+			AddBlock(FMath::Min(Group.FreeRoom, UnitsLeft), 0);
+		}
+
+		while (UnitsLeft > 0)
+		{
+			AddBlock(FMath::Min(Group.StackSize, UnitsLeft), 1);
+		}
+	}
+
+	// Weight and slots are weighed against how much of each is left so neither is preferred
+	const bool bWeightLimited = RemainingWeight < TNumericLimits<float>::Max();
+	for (FCLootBlock& Block : Blocks)
+	{
+		const double Cost = (bWeightLimited ? Block.Weight / RemainingWeight : 0.0) + static_cast<double>(Block.Slots) / RemainingSlots;
+		Block.Density = Cost > 0.0 ? Block.Value / Cost : TNumericLimits<double>::Max();
+	}
+
+	Blocks.StableSort([](const FCLootBlock& A, const FCLootBlock& B) { return A.Density > B.Density; });
+
+	TBitArray<> Chosen(false, Blocks.Num());
+	double ChosenWeight = 0.0;
+	int32 ChosenSlots = 0;
+	int32 Break = INDEX_NONE;
+
+	FillGreedy(Blocks, 0, Chosen, ChosenWeight, ChosenSlots, RemainingWeight, RemainingSlots, &Break);
+
+	// Greedy is only off around where it first ran out of room, everything well before that is worth taking and everything well after it isn't
+	if (Break != INDEX_NONE)
+	{
+		const int32 Start = FMath::Max(0, Break - CoreSize / 2);
+		const int32 End = FMath::Min(Blocks.Num(), Start + CoreSize);
+
+		TBitArray<> Refined(false, Blocks.Num());
+		double RefinedWeight = 0.0;
+		int32 RefinedSlots = 0;
+
+		for (int32 i = 0; i < Start; ++i)
+		{
+			Refined[i] = true;
+			RefinedWeight += Blocks[i].Weight;
+			RefinedSlots += Blocks[i].Slots;
+		}
+
+		const float CoreWeight = bWeightLimited ? static_cast<float>(RemainingWeight - RefinedWeight) : RemainingWeight;
+		SolveCore(Blocks, Start, End, CoreWeight, RemainingSlots - RefinedSlots, Refined);
+
+		RefinedWeight = 0.0;
+		RefinedSlots = 0;
+		for (TConstSetBitIterator<> It(Refined); It; ++It)
+		{
+			RefinedWeight += Blocks[It.GetIndex()].Weight;
+			RefinedSlots += Blocks[It.GetIndex()].Slots;
+		}
+
+		FillGreedy(Blocks, End, Refined, RefinedWeight, RefinedSlots, RemainingWeight, RemainingSlots);
+
+		float GreedyValue = 0.0f;
+		float RefinedValue = 0.0f;
+		MeasureBlocks(Blocks, Chosen, RemainingWeight, RemainingSlots, GreedyValue);
+
+		if (MeasureBlocks(Blocks, Refined, RemainingWeight, RemainingSlots, RefinedValue) && RefinedValue > GreedyValue)
+		{
+			Chosen = MoveTemp(Refined);
+			ChosenWeight = RefinedWeight;
+			ChosenSlots = RefinedSlots;
+		}
+	}
+
+	for (TConstSetBitIterator<> It(Chosen); It; ++It)
+	{
+		const FCLootBlock& Block = Blocks[It.GetIndex()];
+		if (Block.Group != INDEX_NONE)
+		{
+			Groups[Block.Group].TakenUnits += Block.Units;
+		}
+		else
+		{
+			OutPicks.Add({Block.Candidate, Block.Units});
+		}
+	}
+
+	// A group can end up needing fewer new stacks than its blocks counted if it skipped the block that tops up the existing stacks
+	ChosenSlots = OutPicks.Num();
+	for (const FCLootGroup& Group : Groups)
+	{
+		ChosenSlots += Group.GetSlots(Group.TakenUnits);
+	}
+
+	// Whole blocks can leave room for part of a stack, top up the best groups with whatever still fits
+	TArray<int32> GroupOrder;
+	for (int32 GroupIndex = 0; GroupIndex < Groups.Num(); ++GroupIndex)
+	{
+		if (Groups[GroupIndex].TakenUnits < Groups[GroupIndex].TotalUnits)
+		{
+			GroupOrder.Add(GroupIndex);
+		}
+	}
+
+	GroupOrder.Sort([&Groups](const int32 A, const int32 B)
+	{
+		return Groups[A].Runs[0].UnitValue * Groups[B].UnitWeight > Groups[B].Runs[0].UnitValue * Groups[A].UnitWeight;
+	});
+
+	for (const int32 GroupIndex : GroupOrder)
+	{
+		FCLootGroup& Group = Groups[GroupIndex];
+
+		const int32 GroupSlots = Group.GetSlots(Group.TakenUnits);
+		const int32 RoomWithoutSlot = Group.FreeRoom + GroupSlots * Group.StackSize - Group.TakenUnits;
+
+		int32 Extra = FMath::Min(Group.TotalUnits - Group.TakenUnits, FMath::Max(0, RoomWithoutSlot) + (RemainingSlots - ChosenSlots) * Group.StackSize);
+		if (bWeightLimited && Group.UnitWeight > 0.0f)
+		{
+			Extra = FMath::Min(Extra, FMath::FloorToInt((RemainingWeight - ChosenWeight) / Group.UnitWeight));
+		}
+
+		if (Extra <= 0)
+		{
+			continue;
+		}
+
+		ChosenSlots += Group.GetSlots(Group.TakenUnits + Extra) - GroupSlots;
+		ChosenWeight += Group.UnitWeight * Extra;
+		Group.TakenUnits += Extra;
+	}
+
+	// The taken units of a group always come from its most valuable runs
+	float TotalValue = 0.0f;
+	for (const FCLootGroup& Group : Groups)
+	{
+		int32 UnitsLeft = Group.TakenUnits;
+		for (const FCLootRun& Run : Group.Runs)
+		{
+			if (UnitsLeft <= 0)
+			{
+				break;
+			}
+
+			const int32 Taken = FMath::Min(UnitsLeft, Run.Quantity);
+			OutPicks.Add({Run.Index, Taken});
+			UnitsLeft -= Taken;
+		}
+	}
+
+	for (const FCLootPick& Pick : OutPicks)
+	{
+		TotalValue += GetUnitValue(Candidates[Pick.Index], ServerTime) * Pick.Quantity;
+	}
+
+	return TotalValue;
+}
@@ -0,0 +1,270 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "LootTable.h"
+
+#include <HAL/IConsoleManager.h>
+#include <Misc/ScopeLock.h>
+
+namespace UnrealInventory
+{
+	namespace Loot
+	{
+		/** Nested tables deeper than this are ignored so a table that references itself can't recurse forever. */
+		static constexpr int32 MaxNestingDepth = 8;
+	};
+};
+
+void FCAliasTable::Build(TArrayView<const float> Weights)
+{
+	const int32 Count = Weights.Num();
+
+	m_Probabilities.Reset();
+	m_Aliases.Reset();
+
+	float TotalWeight = 0.0f;
+	for (const float Weight : Weights)
+	{
+		TotalWeight += FMath::Max(0.0f, Weight);
+	}
+
+	if (Count == 0 || TotalWeight <= 0.0f)
+	{
+		return;
+	}
+
+	m_Probabilities.SetNumUninitialized(Count);
+	m_Aliases.SetNumUninitialized(Count);
+
+	TArray<float, TInlineAllocator<32>> Scaled;
+	TArray<int32, TInlineAllocator<32>> Small;
+	TArray<int32, TInlineAllocator<32>> Large;
+	Scaled.SetNumUninitialized(Count);
+
+	for (int32 i = 0; i < Count; ++i)
+	{
+		Scaled[i] = FMath::Max(0.0f, Weights[i]) * Count / TotalWeight;
+		(Scaled[i] < 1.0f ? Small : Large).Add(i);
+	}
+
+	while (Small.Num() > 0 && Large.Num() > 0)
+	{
+		const int32 Less = Small.Pop(EAllowShrinking::No);
+		const int32 More = Large.Pop(EAllowShrinking::No);
+
+		m_Probabilities[Less] = Scaled[Less];
+		m_Aliases[Less] = More;
+
+		Scaled[More] = (Scaled[More] + Scaled[Less]) - 1.0f;
+		(Scaled[More] < 1.0f ? Small : Large).Add(More);
+	}
+
+	// Whatever is left over is 1 give or take float error
+	for (const int32 Index : Large)
+	{
+		m_Probabilities[Index] = 1.0f;
+		m_Aliases[Index] = Index;
+	}
+
+	for (const int32 Index : Small)
+	{
+		m_Probabilities[Index] = 1.0f;
+		m_Aliases[Index] = Index;
+	}
+}
+
+int32 FCAliasTable::Sample(const FRandomStream& Stream) const
+{
+	if (!IsValid())
+	{
+		return INDEX_NONE;
+	}
+
+	const int32 Column = Stream.RandHelper(m_Probabilities.Num());
+	return Stream.GetFraction() < m_Probabilities[Column] ? Column : m_Aliases[Column];
+}
+
+void UCLootTable::GenerateLoot(const int32 Seed, TArray<FCItem>& OutItems) const
+{
+	OutItems.Reset();
+	GenerateLoot(FRandomStream(Seed), OutItems);
+}
+
+void UCLootTable::GenerateLoot(const FRandomStream& Stream, TArray<FCItem>& OutItems) const
+{
+	const int32 FirstIndex = OutItems.Num();
+	GenerateLootInternal(Stream, OutItems, 0);
+
+	// Scores only depend on the seed and the item's position in the batch so they're generated in one pass afterwards.
+	// The seed is drawn from the stream so every batch drawn from the same stream gets its own scores
+	UnrealInventory::Random::GenerateScores(MakeArrayView(OutItems).Slice(FirstIndex, OutItems.Num() - FirstIndex), Stream.GetUnsignedInt(), FirstIndex);
+}
+
+void UCLootTable::Roll(const FRandomStream& Stream, TArray<FCItem>& OutItems) const
+{
+	RollInternal(Stream, OutItems, 0);
+}
+
+void UCLootTable::BuildAliasTables() const
+{
+	FScopeLock Lock(&m_AliasTablesLock);
+
+	TArray<float, TInlineAllocator<32>> Weights;
+	Weights.Reserve(m_Entries.Num());
+
+	for (const auto& Entry : m_Entries)
+	{
+		Weights.Add(Entry.Weight);
+	}
+
+	m_EntryTable.Build(Weights);
+
+	m_RarityTables.SetNum(m_GuaranteedEntries.Num() + m_Entries.Num());
+
+	int32 TableIndex = 0;
+	for (const auto* Entries : {&m_GuaranteedEntries, &m_Entries})
+	{
+		for (const auto& Entry : *Entries)
+		{
+			m_RarityTables[TableIndex++].Build(MakeArrayView(Entry.RarityWeights, static_cast<int32>(ECItemRarity::MAX)));
+		}
+	}
+
+	m_bAliasTablesBuilt.store(true, std::memory_order_release);
+}
+
+void UCLootTable::EnsureAliasTablesBuilt() const
+{
+	if (m_bAliasTablesBuilt.load(std::memory_order_acquire))
+	{
+		return;
+	}
+
+	// Another thread may have built them while this one waited for the lock
+	FScopeLock Lock(&m_AliasTablesLock);
+	if (!m_bAliasTablesBuilt.load(std::memory_order_relaxed))
+	{
+		BuildAliasTables();
+	}
+}
+
+void UCLootTable::PostLoad()
+{
+	Super::PostLoad();
+
+	BuildAliasTables();
+}
+
+#if WITH_EDITOR
+void UCLootTable::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	BuildAliasTables();
+}
+#endif
+
+void UCLootTable::GenerateEntry(const FCLootEntry& Entry, const int32 EntryIndex, const bool bGuaranteed, const FRandomStream& Stream, TArray<FCItem>& OutItems, const int32 Depth) const
+{
+	if (Entry.NestedTable != nullptr)
+	{
+		if (Depth < UnrealInventory::Loot::MaxNestingDepth)
+		{
+			Entry.NestedTable->GenerateLootInternal(Stream, OutItems, Depth + 1);
+		}
+
+		return;
+	}
+
+	if (Entry.ItemDescriptor == nullptr)
+	{
+		return;
+	}
+
+	const int32 Quantity = Stream.RandRange(Entry.QuantityRange.X, FMath::Max(Entry.QuantityRange.X, Entry.QuantityRange.Y));
+	if (Quantity <= 0)
+	{
+		return;
+	}
+
+	const FCAliasTable& RarityTable = m_RarityTables[bGuaranteed ? EntryIndex : m_GuaranteedEntries.Num() + EntryIndex];
+	const int32 Rarity = RarityTable.Sample(Stream);
+
+	FCItem& Item = OutItems.AddDefaulted_GetRef();
+	Item.ItemDescriptor = Entry.ItemDescriptor;
+	Item.Quantity = Quantity;
+	Item.Rarity = Rarity != INDEX_NONE ? static_cast<ECItemRarity>(Rarity) : ECItemRarity::Common;
+}
+
+void UCLootTable::GenerateLootInternal(const FRandomStream& Stream, TArray<FCItem>& OutItems, const int32 Depth) const
+{
+	EnsureAliasTablesBuilt();
+
+	for (int32 i = 0; i < m_GuaranteedEntries.Num(); ++i)
+	{
+		GenerateEntry(m_GuaranteedEntries[i], i, true, Stream, OutItems, Depth);
+	}
+
+	const int32 RollCount = Stream.RandRange(m_RollCount.X, FMath::Max(m_RollCount.X, m_RollCount.Y));
+	for (int32 i = 0; i < RollCount; ++i)
+	{
+		RollInternal(Stream, OutItems, Depth);
+	}
+}
+
+void UCLootTable::RollInternal(const FRandomStream& Stream, TArray<FCItem>& OutItems, const int32 Depth) const
+{
+	EnsureAliasTablesBuilt();
+
+	const int32 EntryIndex = m_EntryTable.Sample(Stream);
+	if (EntryIndex != INDEX_NONE)
+	{
+		GenerateEntry(m_Entries[EntryIndex], EntryIndex, false, Stream, OutItems, Depth);
+	}
+}
+
+static FAutoConsoleCommand GLootBenchmarkCommand(
+	TEXT("UnrealInventory.Loot.Benchmark"),
+	TEXT("Roll a loot table a number of times and log how long it took. Usage: UnrealInventory.Loot.Benchmark <LootTablePath> [Rolls=1000000] [Seed=0]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		if (Args.Num() < 1)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UnrealInventory.Loot.Benchmark <LootTablePath> [Rolls=1000000] [Seed=0]"));
+			return;
+		}
+
+		const UCLootTable* Table = LoadObject<UCLootTable>(nullptr, *Args[0]);
+		if (Table == nullptr)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Couldn't load loot table %s"), *Args[0]);
+			return;
+		}
+
+		const int32 Rolls = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1000000;
+		const int32 Seed = Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 0;
+
+		const FRandomStream Stream(Seed);
+
+		TArray<FCItem> Items;
+		Items.Reserve(1024);
+
+		int64 ItemCount = 0;
+		const double StartTime = FPlatformTime::Seconds();
+
+		for (int32 i = 0; i < Rolls; ++i)
+		{
+			Table->Roll(Stream, Items);
+
+			// Don't let the array grow forever, we only care about the cost of rolling
+			if (Items.Num() >= 1024)
+			{
+				ItemCount += Items.Num();
+				Items.Reset();
+			}
+		}
+
+		ItemCount += Items.Num();
+
+		const double Elapsed = FPlatformTime::Seconds() - StartTime;
+		UE_LOG(LogTemp, Display, TEXT("Rolled %s %d times generating %lld items in %.3f ms (%.1f ns per roll)"), *Table->GetName(), Rolls, ItemCount, Elapsed * 1000.0, Rolls > 0 ? Elapsed * 1e9 / Rolls : 0.0);
+	}));
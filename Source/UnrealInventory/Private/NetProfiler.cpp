@@ -0,0 +1,291 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NetProfiler.h"
+
+#include "ItemDataAsset.h"
+
+#include <HAL/IConsoleManager.h>
+#include <Misc/DateTime.h>
+#include <Misc/FileHelper.h>
+#include <Misc/Paths.h>
+
+static TAutoConsoleVariable<int32> CVarNetProfile(
+	TEXT("UnrealInventory.Net.Profile"),
+	0,
+	TEXT("Record what the inventory costs to replicate, see UnrealInventory.Net.ProfileDump."));
+
+static TAutoConsoleVariable<int32> CVarValidatePushModel(
+	TEXT("UnrealInventory.Net.ValidatePushModel"),
+	0,
+	TEXT("Log an error when a push model property changed without being marked dirty. Hashes every replicated inventory each net update so it's slow."));
+
+bool UnrealInventory::Net::ShouldValidatePushModel()
+{
+	return CVarValidatePushModel.GetValueOnAnyThread() != 0;
+}
+
+uint32 UnrealInventory::Net::GetReplicatedHash(TArrayView<const FCItem> Items)
+{
+	uint32 Hash = GetTypeHash(Items.Num());
+
+	for (const FCItem& Item : Items)
+	{
+		Hash = HashCombine(Hash, PointerHash(Item.ItemDescriptor));
+		Hash = HashCombine(Hash, GetTypeHash(Item.Quantity));
+		Hash = HashCombine(Hash, GetTypeHash(Item.Health));
+		Hash = HashCombine(Hash, GetTypeHash(Item.HealthTimestamp));
+		Hash = HashCombine(Hash, GetTypeHash(Item.Score));
+		Hash = HashCombine(Hash, GetTypeHash(Item.Seed));
+		Hash = HashCombine(Hash, GetTypeHash(Item.Rarity));
+	}
+
+	return Hash;
+}
+
+static const FName GItemOwnerName(TEXT("FCItem"));
+static const FName GItemSerializeName(TEXT("NetSerialize"));
+static const FName GItemCompareName(TEXT("Identical"));
+
+FCNetProfiler& FCNetProfiler::Get()
+{
+	static FCNetProfiler Profiler;
+	return Profiler;
+}
+
+bool FCNetProfiler::IsEnabled()
+{
+	return CVarNetProfile.GetValueOnAnyThread() != 0;
+}
+
+void FCNetProfiler::RecordProperty(const FName Owner, const FName Property, const int64 Bits, const uint64 CompareCycles, const int32 Connections)
+{
+	FScopeLock Lock(&m_Lock);
+
+	FCNetPropertyStats& Stats = FindOrAddStats(Owner, Property);
+	++Stats.Compares;
+	Stats.CompareCycles += CompareCycles;
+
+	if (Bits > 0)
+	{
+		Stats.Bits += Bits * Connections;
+		Stats.Sends += Connections;
+	}
+	else
+	{
+		++Stats.UnchangedCompares;
+	}
+}
+
+int64 FCNetProfiler::ProfileItems(const FName Owner, const FName Property, TArrayView<const FCItem> Items, TArray<FCItem>& Shadow, const bool bDynamicArray, const int32 Connections)
+{
+	// Find what changed first so only the compare is timed, the same as the replication compare
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	TArray<int32, TInlineAllocator<16>> ChangedIndices;
+	for (int32 i = 0; i < Items.Num(); ++i)
+	{
+		if (!Shadow.IsValidIndex(i) || !Items[i].IsNetIdentical(Shadow[i]))
+		{
+			ChangedIndices.Add(i);
+		}
+	}
+
+	const bool bSizeChanged = Items.Num() != Shadow.Num();
+	const uint64 CompareCycles = FPlatformTime::Cycles64() - StartCycles;
+
+	int64 Bits = bDynamicArray && bSizeChanged ? UnrealInventory::Net::ArrayHeaderBits : 0;
+	for (const int32 Index : ChangedIndices)
+	{
+		Bits += UnrealInventory::Net::ElementHeaderBits + MeasureItemBits(Items[Index]);
+	}
+
+	if (Bits > 0 || bSizeChanged)
+	{
+		Shadow.Reset();
+		Shadow.Append(Items.GetData(), Items.Num());
+	}
+
+	RecordProperty(Owner, Property, Bits, CompareCycles, Connections);
+
+	return Bits;
+}
+
+int64 FCNetProfiler::MeasureItemBits(const FCItem& Item)
+{
+	if (m_bShutdown)
+	{
+		return 0;
+	}
+
+	if (!m_PackageMap.IsValid())
+	{
+		m_PackageMap.Reset(NewObject<UCNetProfilerPackageMap>());
+	}
+
+	FNetBitWriter Writer(m_PackageMap.Get(), 256);
+
+	FCItem Copy = Item;
+	bool bSuccess = false;
+
+	m_bMeasuring = true;
+	Copy.NetSerialize(Writer, m_PackageMap.Get(), bSuccess);
+	m_bMeasuring = false;
+
+	return Writer.GetNumBits();
+}
+
+void FCNetProfiler::RecordItemSerialize(const FCItem& Item)
+{
+	// Measuring serializes the item as well, that isn't a real send
+	if (m_bMeasuring)
+	{
+		return;
+	}
+
+	const int64 Bits = MeasureItemBits(Item);
+
+	FScopeLock Lock(&m_Lock);
+
+	FCNetPropertyStats& Stats = FindOrAddStats(GItemOwnerName, GItemSerializeName);
+	Stats.Bits += Bits;
+	++Stats.Sends;
+}
+
+void FCNetProfiler::RecordItemCompare(const bool bIdentical, const uint64 Cycles)
+{
+	FScopeLock Lock(&m_Lock);
+
+	FCNetPropertyStats& Stats = FindOrAddStats(GItemOwnerName, GItemCompareName);
+	++Stats.Compares;
+	Stats.UnchangedCompares += bIdentical ? 1 : 0;
+	Stats.CompareCycles += Cycles;
+}
+
+void FCNetProfiler::SampleConnections(const int32 Connections)
+{
+	FScopeLock Lock(&m_Lock);
+
+	m_MaxConnections = FMath::Max(m_MaxConnections, Connections);
+}
+
+void FCNetProfiler::Reset()
+{
+	FScopeLock Lock(&m_Lock);
+
+	m_Stats.Reset();
+	m_StartTime = 0.0;
+	m_LastRecordTime = 0.0;
+	m_MaxConnections = 0;
+}
+
+void FCNetProfiler::Shutdown()
+{
+	m_bShutdown = true;
+	m_PackageMap.Reset();
+}
+
+bool FCNetProfiler::Write(const FString& Path, const bool bJson) const
+{
+	FScopeLock Lock(&m_Lock);
+
+	const double Seconds = FMath::Max(m_LastRecordTime - m_StartTime, UE_SMALL_NUMBER);
+	const int32 Connections = FMath::Max(m_MaxConnections, 1);
+
+	TArray<TPair<FName, FName>> Keys;
+	m_Stats.GetKeys(Keys);
+
+	// Sorted so the files of two builds line up
+	Keys.Sort([](const TPair<FName, FName>& A, const TPair<FName, FName>& B)
+	{
+		return A.Key != B.Key ? A.Key.LexicalLess(B.Key) : A.Value.LexicalLess(B.Value);
+	});
+
+	FString Output;
+
+	if (bJson)
+	{
+		Output += FString::Printf(TEXT("{\n\t\"Seconds\": %.3f,\n\t\"Connections\": %d,\n\t\"Properties\": ["), Seconds, Connections);
+	}
+	else
+	{
+		Output += FString::Printf(TEXT("# Seconds=%.3f Connections=%d\n"), Seconds, Connections);
+		Output += TEXT("Owner,Property,Bytes,BytesPerSecond,BytesPerConnectionPerSecond,Sends,Compares,UnchangedCompares,CompareMs\n");
+	}
+
+	for (int32 i = 0; i < Keys.Num(); ++i)
+	{
+		const FCNetPropertyStats& Stats = m_Stats[Keys[i]];
+
+		const double Bytes = Stats.Bits / 8.0;
+		const double CompareMs = FPlatformTime::ToMilliseconds64(Stats.CompareCycles);
+
+		if (bJson)
+		{
+			Output += FString::Printf(TEXT("%s\n\t\t{\"Owner\": \"%s\", \"Property\": \"%s\", \"Bytes\": %.1f, \"BytesPerSecond\": %.3f, \"BytesPerConnectionPerSecond\": %.3f, \"Sends\": %lld, \"Compares\": %lld, \"UnchangedCompares\": %lld, \"CompareMs\": %.3f}"),
+				i > 0 ? TEXT(",") : TEXT(""), *Keys[i].Key.ToString(), *Keys[i].Value.ToString(), Bytes, Bytes / Seconds, Bytes / Seconds / Connections, Stats.Sends, Stats.Compares, Stats.UnchangedCompares, CompareMs);
+		}
+		else
+		{
+			Output += FString::Printf(TEXT("%s,%s,%.1f,%.3f,%.3f,%lld,%lld,%lld,%.3f\n"),
+				*Keys[i].Key.ToString(), *Keys[i].Value.ToString(), Bytes, Bytes / Seconds, Bytes / Seconds / Connections, Stats.Sends, Stats.Compares, Stats.UnchangedCompares, CompareMs);
+		}
+	}
+
+	if (bJson)
+	{
+		Output += TEXT("\n\t]\n}\n");
+	}
+
+	return FFileHelper::SaveStringToFile(Output, *Path);
+}
+
+FCNetPropertyStats& FCNetProfiler::FindOrAddStats(const FName Owner, const FName Property)
+{
+	m_LastRecordTime = FPlatformTime::Seconds();
+
+	if (m_StartTime == 0.0)
+	{
+		m_StartTime = m_LastRecordTime;
+	}
+
+	return m_Stats.FindOrAdd({Owner, Property});
+}
+
+bool UCNetProfilerPackageMap::SerializeObject(FArchive& Ar, UClass* InClass, UObject*& Obj, FNetworkGUID* OutNetGUID)
+{
+	uint32 Id = Obj != nullptr ? m_ObjectIds.FindOrAdd(Obj, m_ObjectIds.Num() + 1) : 0;
+	Ar.SerializeIntPacked(Id);
+
+	return true;
+}
+
+static FAutoConsoleCommand GNetProfileDumpCommand(
+	TEXT("UnrealInventory.Net.ProfileDump"),
+	TEXT("Write what the inventory cost to replicate since the last reset. Usage: UnrealInventory.Net.ProfileDump [Path] [json]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const bool bJson = Args.ContainsByPredicate([](const FString& Arg) { return Arg.Equals(TEXT("json"), ESearchCase::IgnoreCase); });
+
+		FString Path = Args.Num() > 0 && !Args[0].Equals(TEXT("json"), ESearchCase::IgnoreCase) ? Args[0] : FString();
+		if (Path.IsEmpty())
+		{
+			Path = FPaths::ProfilingDir() / TEXT("UnrealInventory") / FString::Printf(TEXT("NetProfile-%s.%s"), *FDateTime::Now().ToString(), bJson ? TEXT("json") : TEXT("csv"));
+		}
+
+		if (FCNetProfiler::Get().Write(Path, bJson))
+		{
+			UE_LOG(LogTemp, Display, TEXT("Wrote the net profile to %s"), *Path);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Couldn't write the net profile to %s"), *Path);
+		}
+	}));
+
+static FAutoConsoleCommand GNetProfileResetCommand(
+	TEXT("UnrealInventory.Net.ProfileReset"),
+	TEXT("Clear everything the net profiler recorded so far."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FCNetProfiler::Get().Reset();
+	}));
@@ -0,0 +1,514 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PickupSubsystem.h"
+
+#include "AuditLog.h"
+#include "InventoryComponent.h"
+#include "Item.h"
+#include "StorageComponent.h"
+
+#include <Engine/World.h>
+#include <HAL/IConsoleManager.h>
+
+namespace UnrealInventory
+{
+	namespace Pickups
+	{
+		/** The spawn order is compacted once it holds this many more entries than there are pickups. */
+		static constexpr int32 SpawnOrderSlack = 256;
+	};
+};
+
+void UCPickupSubsystem::RegisterPickup(ACItemActor* Pickup)
+{
+	if (Pickup == nullptr || Pickup->m_PickupIndex != INDEX_NONE)
+	{
+		return;
+	}
+
+	Pickup->m_PickupIndex = m_Pickups.Add(Pickup);
+	Pickup->m_bPendingDespawn = false;
+
+	AddToCell(Pickup, GetCell(Pickup->GetActorLocation()));
+
+	const float Lifetime = GetPickupLifetime(Pickup->GetItemDescriptor(), Pickup->GetRarity());
+	if (Lifetime > 0.0f)
+	{
+		// Nothing expired while the buckets were empty so there's no need to walk the buckets in between
+		const int32 CurrentBucket = GetBucket(GetWorld()->GetTimeSeconds());
+		if (m_ExpiryBuckets.Num() == 0)
+		{
+			m_NextExpiryBucket = CurrentBucket;
+		}
+
+		// Never put a pickup in a bucket that has already been processed
+		const int32 Bucket = FMath::Max(GetBucket(GetWorld()->GetTimeSeconds() + Lifetime), m_NextExpiryBucket);
+		m_ExpiryBuckets.FindOrAdd(Bucket).Add(Pickup);
+	}
+
+	// Drop the entries of pickups that are already gone once in a while so the spawn order doesn't grow forever
+	if (m_SpawnOrder.Num() - m_SpawnOrderHead > m_Pickups.Num() * 2 + UnrealInventory::Pickups::SpawnOrderSlack)
+	{
+		m_SpawnOrder.RemoveAt(0, m_SpawnOrderHead, EAllowShrinking::No);
+		m_SpawnOrderHead = 0;
+		m_SpawnOrder.RemoveAll([](const TWeakObjectPtr<ACItemActor>& Entry) { return !Entry.IsValid(); });
+	}
+
+	m_SpawnOrder.Add(Pickup);
+
+	EnforcePickupCap();
+}
+
+void UCPickupSubsystem::UnregisterPickup(ACItemActor* Pickup)
+{
+	if (Pickup == nullptr || !m_Pickups.IsValidIndex(Pickup->m_PickupIndex) || m_Pickups[Pickup->m_PickupIndex] != Pickup)
+	{
+		return;
+	}
+
+	const int32 Index = Pickup->m_PickupIndex;
+	m_Pickups.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+
+	// The last pickup was moved into the hole
+	if (m_Pickups.IsValidIndex(Index))
+	{
+		m_Pickups[Index]->m_PickupIndex = Index;
+	}
+
+	Pickup->m_PickupIndex = INDEX_NONE;
+
+	RemoveFromCell(Pickup);
+
+	if (Pickup->m_bPendingDespawn)
+	{
+		Pickup->m_bPendingDespawn = false;
+		--m_PendingDespawnCount;
+	}
+}
+
+bool UCPickupSubsystem::SpawnPickup(const FCItem& Item, const int32 Quantity, const FTransform& Transform)
+{
+	if (m_SpawnPickupOverride.IsBound() && m_SpawnPickupOverride.Execute(Item, Quantity, Transform))
+	{
+		return true;
+	}
+
+	return ACItemActor::SpawnPickup(GetWorld(), Item, Quantity, Transform) != nullptr;
+}
+
+void UCPickupSubsystem::UpdatePickupCell(ACItemActor* Pickup)
+{
+	if (Pickup == nullptr || Pickup->m_PickupCellIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	// Most moves stay within the same cell
+	const FIntPoint Cell = GetCell(Pickup->GetActorLocation());
+	if (Cell != Pickup->m_PickupCell)
+	{
+		RemoveFromCell(Pickup);
+		AddToCell(Pickup, Cell);
+	}
+}
+
+void UCPickupSubsystem::GetPickupsInRadius(const FVector& Location, const float Radius, TArray<ACItemActor*>& OutPickups) const
+{
+	OutPickups.Reset();
+
+	const FIntPoint MinCell = GetCell(Location - FVector(Radius));
+	const FIntPoint MaxCell = GetCell(Location + FVector(Radius));
+	const double RadiusSquared = FMath::Square(Radius);
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			const TArray<ACItemActor*>* Pickups = m_PickupCells.Find(FIntPoint(X, Y));
+			if (Pickups == nullptr)
+			{
+				continue;
+			}
+
+			for (ACItemActor* Pickup : *Pickups)
+			{
+				if (!Pickup->m_bPendingDespawn && FVector::DistSquared(Location, Pickup->GetActorLocation()) <= RadiusSquared)
+				{
+					OutPickups.Add(Pickup);
+				}
+			}
+		}
+	}
+}
+
+void UCPickupSubsystem::FindNearestPickupsByDescriptor(const FVector& Location, const UCItemDescriptorBase* ItemDescriptor, const int32 Count, const float MaxDistance, TArray<ACItemActor*>& OutPickups) const
+{
+	FindNearestPickups(Location, Count, MaxDistance, [ItemDescriptor](const ACItemActor* Pickup) { return Pickup->GetItemDescriptor() == ItemDescriptor; }, OutPickups);
+}
+
+void UCPickupSubsystem::FindNearestPickupsByCategory(const FVector& Location, const ECItemCategory Category, const int32 Count, const float MaxDistance, TArray<ACItemActor*>& OutPickups) const
+{
+	FindNearestPickups(Location, Count, MaxDistance, [Category](const ACItemActor* Pickup)
+	{
+		return Pickup->GetItemDescriptor() != nullptr && Pickup->GetItemDescriptor()->GetItemCategory() == Category;
+	}, OutPickups);
+}
+
+int32 UCPickupSubsystem::LootPickupsInRadius(UCInventoryComponent* Inventory, const FVector& Location, const float Radius)
+{
+	if (Inventory == nullptr)
+	{
+		return 0;
+	}
+
+	if (!Inventory->GetOwner()->HasAuthority())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("You can't loot pickups without authority"));
+		return 0;
+	}
+
+	FCAuditScope AuditScope(ECAuditOp::Pickup);
+
+	TArray<ACItemActor*> Pickups;
+	GetPickupsInRadius(Location, Radius, Pickups);
+
+	if (Pickups.Num() == 0)
+	{
+		return 0;
+	}
+
+	Pickups.Sort([&Location](const ACItemActor& A, const ACItemActor& B)
+	{
+		return FVector::DistSquared(Location, A.GetActorLocation()) < FVector::DistSquared(Location, B.GetActorLocation());
+	});
+
+	TArray<FCItem> Items;
+	Items.Reserve(Pickups.Num());
+
+	for (const ACItemActor* Pickup : Pickups)
+	{
+		Items.Add(Pickup->GetItem());
+	}
+
+	TArray<FCItem> Remaining;
+	Inventory->AddItems(Items, Remaining);
+
+	// AddItems merges the stacks so what didn't fit is handed back to the pickups from the furthest in.
+	// Items with a score never merge, so they go back to the exact pickup they came from
+	using FCLeftoverKey = TTuple<const UCItemDescriptorBase*, ECItemRarity, int32, int32>;
+	const auto GetLeftoverKey = [](const FCItem& Item) { return FCLeftoverKey(Item.ItemDescriptor, Item.Rarity, Item.Score, Item.Score != INDEX_NONE ? Item.Seed : 0); };
+
+	TMap<FCLeftoverKey, int32> Leftovers;
+	for (const auto& Item : Remaining)
+	{
+		Leftovers.FindOrAdd(GetLeftoverKey(Item)) += Item.Quantity;
+	}
+
+	int32 LootedCount = 0;
+	for (int32 Index = Pickups.Num() - 1; Index >= 0; --Index)
+	{
+		ACItemActor* Pickup = Pickups[Index];
+
+		int32* Leftover = Leftovers.Find(GetLeftoverKey(Items[Index]));
+		const int32 Kept = Leftover != nullptr ? FMath::Min(*Leftover, Pickup->GetQuantity()) : 0;
+
+		if (Kept == 0)
+		{
+			Pickup->Destroy();
+			++LootedCount;
+			continue;
+		}
+
+		*Leftover -= Kept;
+
+		if (Kept != Pickup->GetQuantity())
+		{
+			Pickup->SetQuantity(Kept);
+		}
+	}
+
+	return LootedCount;
+}
+
+void UCPickupSubsystem::RegisterStorage(UCStorageComponent* Storage)
+{
+	if (Storage != nullptr)
+	{
+		m_Storages.AddUnique(Storage);
+	}
+}
+
+void UCPickupSubsystem::UnregisterStorage(UCStorageComponent* Storage)
+{
+	m_Storages.RemoveSwap(Storage);
+}
+
+FCDormancyStats UCPickupSubsystem::GetDormancyStats() const
+{
+	FCDormancyStats Stats;
+	Stats.Pickups = m_Pickups.Num();
+	Stats.Storages = m_Storages.Num();
+
+	for (const ACItemActor* Pickup : m_Pickups)
+	{
+		Stats.DormantPickups += Pickup->NetDormancy > DORM_Awake ? 1 : 0;
+	}
+
+	for (const UCStorageComponent* Storage : m_Storages)
+	{
+		Stats.DormantStorages += Storage->GetOwner()->NetDormancy > DORM_Awake ? 1 : 0;
+	}
+
+	return Stats;
+}
+
+float UCPickupSubsystem::GetPickupLifetime(const UCItemDescriptorBase* ItemDescriptor, const ECItemRarity Rarity) const
+{
+	if (ItemDescriptor == nullptr)
+	{
+		return m_DefaultLifetime;
+	}
+
+	const float* CategoryLifetime = m_CategoryLifetimes.Find(ItemDescriptor->GetItemCategory());
+	const float Lifetime = CategoryLifetime != nullptr ? *CategoryLifetime : m_DefaultLifetime;
+
+	return Rarity < ECItemRarity::MAX ? Lifetime * m_RarityLifetimeMultipliers[static_cast<uint8>(Rarity)] : Lifetime;
+}
+
+void UCPickupSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Move everything that expired into the despawn queue, the buckets in between are usually empty so this is cheap
+	const int32 CurrentBucket = GetBucket(GetWorld()->GetTimeSeconds());
+
+	for (; m_NextExpiryBucket <= CurrentBucket && m_ExpiryBuckets.Num() > 0; ++m_NextExpiryBucket)
+	{
+		TArray<TWeakObjectPtr<ACItemActor>> Expired;
+		if (m_ExpiryBuckets.RemoveAndCopyValue(m_NextExpiryBucket, Expired))
+		{
+			for (const auto& WeakPickup : Expired)
+			{
+				if (ACItemActor* Pickup = WeakPickup.Get())
+				{
+					QueueDespawn(Pickup);
+				}
+			}
+		}
+	}
+
+	if (m_ExpiryBuckets.Num() == 0)
+	{
+		m_NextExpiryBucket = CurrentBucket + 1;
+	}
+
+	// Despawn a few at a time so a lot of pickups expiring at once doesn't hitch
+	int32 DespawnCount = 0;
+	while (m_PendingDespawnHead < m_PendingDespawns.Num() && DespawnCount < m_MaxDespawnsPerFrame)
+	{
+		ACItemActor* Pickup = m_PendingDespawns[m_PendingDespawnHead++].Get();
+		if (Pickup != nullptr && Pickup->m_bPendingDespawn)
+		{
+			Pickup->Destroy();
+			++DespawnCount;
+		}
+	}
+
+	if (m_PendingDespawnHead >= m_PendingDespawns.Num())
+	{
+		m_PendingDespawns.Reset();
+		m_PendingDespawnHead = 0;
+	}
+}
+
+TStatId UCPickupSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCPickupSubsystem, STATGROUP_Tickables);
+}
+
+bool UCPickupSubsystem::IsTickable() const
+{
+	return Super::IsTickable() && (m_ExpiryBuckets.Num() > 0 || m_PendingDespawnHead < m_PendingDespawns.Num());
+}
+
+bool UCPickupSubsystem::DoesSupportWorldType(EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UCPickupSubsystem::QueueDespawn(ACItemActor* Pickup)
+{
+	if (Pickup->m_bPendingDespawn)
+	{
+		return;
+	}
+
+	Pickup->m_bPendingDespawn = true;
+	++m_PendingDespawnCount;
+
+	m_PendingDespawns.Add(Pickup);
+}
+
+void UCPickupSubsystem::EnforcePickupCap()
+{
+	if (m_MaxPickups <= 0)
+	{
+		return;
+	}
+
+	// Pickups that are already queued will be gone soon so they don't count
+	while (m_Pickups.Num() - m_PendingDespawnCount > m_MaxPickups && m_SpawnOrderHead < m_SpawnOrder.Num())
+	{
+		if (ACItemActor* Oldest = m_SpawnOrder[m_SpawnOrderHead++].Get())
+		{
+			QueueDespawn(Oldest);
+		}
+	}
+}
+
+void UCPickupSubsystem::AddToCell(ACItemActor* Pickup, const FIntPoint& Cell)
+{
+	Pickup->m_PickupCell = Cell;
+	Pickup->m_PickupCellIndex = m_PickupCells.FindOrAdd(Cell).Add(Pickup);
+}
+
+void UCPickupSubsystem::RemoveFromCell(ACItemActor* Pickup)
+{
+	TArray<ACItemActor*>* Pickups = m_PickupCells.Find(Pickup->m_PickupCell);
+	if (Pickups == nullptr || !Pickups->IsValidIndex(Pickup->m_PickupCellIndex))
+	{
+		return;
+	}
+
+	const int32 Index = Pickup->m_PickupCellIndex;
+	Pickups->RemoveAtSwap(Index, 1, EAllowShrinking::No);
+
+	if (Pickups->IsValidIndex(Index))
+	{
+		(*Pickups)[Index]->m_PickupCellIndex = Index;
+	}
+	else if (Pickups->Num() == 0)
+	{
+		m_PickupCells.Remove(Pickup->m_PickupCell);
+	}
+
+	Pickup->m_PickupCellIndex = INDEX_NONE;
+}
+
+void UCPickupSubsystem::FindNearestPickups(const FVector& Location, const int32 Count, const float MaxDistance, TFunctionRef<bool(const ACItemActor*)> Filter, TArray<ACItemActor*>& OutPickups) const
+{
+	OutPickups.Reset();
+
+	if (Count <= 0 || m_PickupCells.Num() == 0)
+	{
+		return;
+	}
+
+	// Max heap of the closest pickups found so far, the furthest of them is on top
+	using FCCandidate = TPair<double, ACItemActor*>;
+	TArray<FCCandidate> Closest;
+	const auto FurthestFirst = [](const FCCandidate& A, const FCCandidate& B) { return A.Key > B.Key; };
+
+	const double MaxDistanceSquared = FMath::Square(MaxDistance);
+	const FIntPoint Center = GetCell(Location);
+	const int32 MaxRing = FMath::CeilToInt(MaxDistance / m_SpatialCellSize);
+
+	const auto AddCandidates = [&](const TArray<ACItemActor*>& Pickups)
+	{
+		for (ACItemActor* Pickup : Pickups)
+		{
+			if (Pickup->m_bPendingDespawn || !Filter(Pickup))
+			{
+				continue;
+			}
+
+			const double DistanceSquared = FVector::DistSquared(Location, Pickup->GetActorLocation());
+			if (DistanceSquared > MaxDistanceSquared)
+			{
+				continue;
+			}
+
+			if (Closest.Num() < Count)
+			{
+				Closest.HeapPush(FCCandidate(DistanceSquared, Pickup), FurthestFirst);
+			}
+			else if (DistanceSquared < Closest.HeapTop().Key)
+			{
+				Closest.HeapPopDiscard(FurthestFirst, EAllowShrinking::No);
+				Closest.HeapPush(FCCandidate(DistanceSquared, Pickup), FurthestFirst);
+			}
+		}
+	};
+
+	// Nothing in the ring or further out can be closer than the furthest pickup found so far
+	const auto IsRingTooFar = [&](const int32 Ring)
+	{
+		const double RingDistance = FMath::Max(Ring - 1, 0) * m_SpatialCellSize;
+		return Closest.Num() == Count && FMath::Square(RingDistance) > Closest.HeapTop().Key;
+	};
+
+	int32 VisitedCells = 0;
+
+	for (int32 Ring = 0; Ring <= MaxRing; ++Ring)
+	{
+		// Stop once every occupied cell was looked at, the rest of the rings are empty
+		if (IsRingTooFar(Ring) || VisitedCells == m_PickupCells.Num())
+		{
+			break;
+		}
+
+		// Once a ring has more cells than there are occupied cells it's cheaper to go through the occupied cells, so the cost
+		// depends on how many cells are occupied rather than how far the search goes
+		if (Ring * 8 > m_PickupCells.Num() - VisitedCells)
+		{
+			for (const auto& Cell : m_PickupCells)
+			{
+				const int32 CellRing = FMath::Max(FMath::Abs(Cell.Key.X - Center.X), FMath::Abs(Cell.Key.Y - Center.Y));
+				if (CellRing >= Ring && CellRing <= MaxRing && !IsRingTooFar(CellRing))
+				{
+					AddCandidates(Cell.Value);
+				}
+			}
+
+			break;
+		}
+
+		for (int32 X = Center.X - Ring; X <= Center.X + Ring; ++X)
+		{
+			// Only the outline of the ring, the inside was searched already
+			const bool bEdge = X == Center.X - Ring || X == Center.X + Ring;
+			for (int32 Y = Center.Y - Ring; Y <= Center.Y + Ring; Y += bEdge || Ring == 0 ? 1 : Ring * 2)
+			{
+				if (const TArray<ACItemActor*>* Pickups = m_PickupCells.Find(FIntPoint(X, Y)))
+				{
+					++VisitedCells;
+					AddCandidates(*Pickups);
+				}
+			}
+		}
+	}
+
+	Closest.Sort([](const FCCandidate& A, const FCCandidate& B) { return A.Key < B.Key; });
+
+	OutPickups.Reserve(Closest.Num());
+	for (const FCCandidate& Candidate : Closest)
+	{
+		OutPickups.Add(Candidate.Value);
+	}
+}
+
+static FAutoConsoleCommandWithWorld GPickupStatsCommand(
+	TEXT("UnrealInventory.Pickups.Stats"),
+	TEXT("Log how many pickups and storages are awake, how many are dormant and how many pickups are waiting to despawn."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		const UCPickupSubsystem* Subsystem = World != nullptr ? World->GetSubsystem<UCPickupSubsystem>() : nullptr;
+		if (Subsystem == nullptr)
+		{
+			return;
+		}
+
+		const FCDormancyStats Stats = Subsystem->GetDormancyStats();
+		UE_LOG(LogTemp, Display, TEXT("Pickups: %d awake, %d dormant, %d waiting to despawn. Storages: %d awake, %d dormant."),
+			Stats.Pickups - Stats.DormantPickups, Stats.DormantPickups, Subsystem->GetPendingDespawnCount(), Stats.Storages - Stats.DormantStorages, Stats.DormantStorages);
+	}));
@@ -0,0 +1,175 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ProcessingSubsystem.h"
+
+#include "AuditLog.h"
+#include "Crafting.h"
+#include "InventoryComponent.h"
+
+#include <Engine/World.h>
+
+namespace UnrealInventory
+{
+	namespace Processing
+	{
+		/** How long to wait before trying to complete a craft again when the outputs didn't fit. */
+		static constexpr float RetryDelay = 1.0f;
+	};
+};
+
+int32 UCProcessingSubsystem::StartJob(UCInventoryComponent* Inventory, UCItemRecipe* Recipe, const int32 Count)
+{
+	if (Inventory == nullptr || Recipe == nullptr || Count <= 0 || !Inventory->GetOwner()->HasAuthority())
+	{
+		return INDEX_NONE;
+	}
+
+	FCProcessingJob& Job = Inventory->m_ProcessingJobs.AddDefaulted_GetRef();
+	Job.JobId = m_NextJobId++;
+	Job.Recipe = Recipe;
+	Job.Remaining = Count;
+
+	const int32 JobId = Job.JobId;
+	if (!StartNextCraft(Inventory, JobId, UCItemStatics::GetServerTime(GetWorld())))
+	{
+		return INDEX_NONE;
+	}
+
+	return JobId;
+}
+
+void UCProcessingSubsystem::CancelJob(UCInventoryComponent* Inventory, const int32 JobId)
+{
+	// The completion is left in the heap and skipped once it's due
+	if (Inventory != nullptr && Inventory->m_ProcessingJobs.RemoveAll([JobId](const FCProcessingJob& Job) { return Job.JobId == JobId; }) > 0)
+	{
+		Inventory->NotifyProcessingJobsChanged();
+	}
+}
+
+void UCProcessingSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	const float Now = UCItemStatics::GetServerTime(GetWorld());
+
+	// Pop everything that's due and group it by inventory so each inventory is only changed once this frame
+	TMap<UCInventoryComponent*, TArray<int32, TInlineAllocator<4>>> DueJobs;
+
+	while (m_CompletionHeap.Num() > 0 && m_CompletionHeap.HeapTop().EndTime <= Now)
+	{
+		FCCompletion Completion;
+		m_CompletionHeap.HeapPop(Completion, EAllowShrinking::No);
+
+		if (UCInventoryComponent* Inventory = Completion.Inventory.Get())
+		{
+			DueJobs.FindOrAdd(Inventory).Add(Completion.JobId);
+		}
+	}
+
+	for (auto& Pair : DueJobs)
+	{
+		UCInventoryComponent* Inventory = Pair.Key;
+		FCAuditScope AuditScope(ECAuditOp::Craft);
+
+		UCInventoryComponent* Inventories[] = {Inventory};
+		FCCraftingContext OutputContext(Inventories);
+
+		TArray<int32, TInlineAllocator<4>> CompletedJobs;
+		for (const int32 JobId : Pair.Value)
+		{
+			// Cancelled jobs are no longer in the inventory
+			if (const FCProcessingJob* Job = Inventory->FindProcessingJob(JobId))
+			{
+				for (const FCItem& Output : Job->Recipe->GetOutputs())
+				{
+					OutputContext.AddOutput(Output);
+				}
+
+				CompletedJobs.Add(JobId);
+			}
+		}
+
+		if (CompletedJobs.Num() == 0)
+		{
+			continue;
+		}
+
+		if (!OutputContext.Commit())
+		{
+			// The outputs don't fit, try again later
+			for (const int32 JobId : CompletedJobs)
+			{
+				m_CompletionHeap.HeapPush({Now + UnrealInventory::Processing::RetryDelay, JobId, Inventory});
+			}
+
+			continue;
+		}
+
+		// Consume the inputs for the next craft of every job in one go
+		FCCraftingContext InputContext(Inventories);
+
+		for (const int32 JobId : CompletedJobs)
+		{
+			FCProcessingJob* Job = Inventory->FindProcessingJob(JobId);
+			--Job->Remaining;
+
+			if (Job->Remaining > 0 && InputContext.Consume(Job->Recipe->GetInputs()))
+			{
+				Job->StartTime = Now;
+				Job->EndTime = Now + Job->Recipe->GetDuration();
+				m_CompletionHeap.HeapPush({Job->EndTime, JobId, Inventory});
+			}
+			else
+			{
+				Job->Remaining = 0;
+			}
+		}
+
+		InputContext.Commit();
+
+		Inventory->m_ProcessingJobs.RemoveAll([](const FCProcessingJob& Job) { return Job.Remaining <= 0; });
+		Inventory->NotifyProcessingJobsChanged();
+	}
+}
+
+TStatId UCProcessingSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCProcessingSubsystem, STATGROUP_Tickables);
+}
+
+bool UCProcessingSubsystem::IsTickable() const
+{
+	return Super::IsTickable() && m_CompletionHeap.Num() > 0;
+}
+
+bool UCProcessingSubsystem::DoesSupportWorldType(EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+bool UCProcessingSubsystem::StartNextCraft(UCInventoryComponent* Inventory, const int32 JobId, const float StartTime)
+{
+	FCProcessingJob* Job = Inventory->FindProcessingJob(JobId);
+	if (Job == nullptr)
+	{
+		return false;
+	}
+
+	UCInventoryComponent* Inventories[] = {Inventory};
+	FCCraftingContext Context(Inventories);
+
+	if (!Context.Consume(Job->Recipe->GetInputs()) || !Context.Commit())
+	{
+		Inventory->m_ProcessingJobs.RemoveAll([JobId](const FCProcessingJob& Other) { return Other.JobId == JobId; });
+		return false;
+	}
+
+	Job->StartTime = StartTime;
+	Job->EndTime = StartTime + Job->Recipe->GetDuration();
+	m_CompletionHeap.HeapPush({Job->EndTime, JobId, Inventory});
+
+	Inventory->NotifyProcessingJobsChanged();
+
+	return true;
+}
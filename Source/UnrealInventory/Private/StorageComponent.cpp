@@ -0,0 +1,391 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "StorageComponent.h"
+
+#include "AuditLog.h"
+#include "PickupSubsystem.h"
+
+#include <Engine/World.h>
+#include <GameFramework/Actor.h>
+#include <TimerManager.h>
+
+UCStorageComponent::UCStorageComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	// Storage is mostly empty so grow as needed rather than reserving the whole capacity
+	m_MaxItems = 10000;
+	m_MaxWeight = 0.0f;
+	m_ReservePolicy = ECInventoryReservePolicy::Lazy;
+}
+
+void UCStorageComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (!GetOwner()->HasAuthority())
+	{
+		return;
+	}
+
+	if (UCPickupSubsystem* Subsystem = GetWorld()->GetSubsystem<UCPickupSubsystem>())
+	{
+		Subsystem->RegisterStorage(this);
+	}
+
+	UpdateDormancy();
+}
+
+void UCStorageComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UCPickupSubsystem* Subsystem = GetWorld()->GetSubsystem<UCPickupSubsystem>())
+	{
+		Subsystem->UnregisterStorage(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+bool UCStorageComponent::SubscribePage(UCInventoryComponent* Viewer, const int32 Page)
+{
+	if (!GetOwner()->HasAuthority() || Viewer == nullptr || !IsValidPageIndex(Page))
+	{
+		return false;
+	}
+
+	if (!IsViewerRelevant(Viewer))
+	{
+		return false;
+	}
+
+	FCStorageViewer* ViewerData = m_Viewers.Find(Viewer);
+	if (ViewerData == nullptr)
+	{
+		if (m_Viewers.Num() >= m_MaxViewers)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s is already being viewed by the max amount of viewers"), *GetOwner()->GetName());
+			return false;
+		}
+
+		ViewerData = &m_Viewers.Add(Viewer);
+		UpdateDormancy();
+	}
+
+	bool bAlreadySubscribed = false;
+	ViewerData->Pages.Add(Page, &bAlreadySubscribed);
+
+	if (!bAlreadySubscribed)
+	{
+		m_PageSubscribers.FindOrAdd(Page).Add(Viewer);
+	}
+
+	// Always send the page, the client may have dropped their copy
+	Viewer->ClientReceiveStoragePage(this, BuildPage(Page));
+
+	return true;
+}
+
+void UCStorageComponent::UnsubscribePage(UCInventoryComponent* Viewer, const int32 Page)
+{
+	FCStorageViewer* ViewerData = m_Viewers.Find(Viewer);
+	if (ViewerData == nullptr)
+	{
+		return;
+	}
+
+	ViewerData->Pages.Remove(Page);
+
+	if (TArray<TWeakObjectPtr<UCInventoryComponent>>* Subscribers = m_PageSubscribers.Find(Page))
+	{
+		Subscribers->RemoveSwap(Viewer);
+		if (Subscribers->Num() == 0)
+		{
+			m_PageSubscribers.Remove(Page);
+		}
+	}
+
+	if (ViewerData->Pages.Num() == 0)
+	{
+		m_Viewers.Remove(Viewer);
+		UpdateDormancy();
+	}
+}
+
+void UCStorageComponent::RemoveViewer(UCInventoryComponent* Viewer)
+{
+	FCStorageViewer ViewerData;
+	if (!m_Viewers.RemoveAndCopyValue(Viewer, ViewerData))
+	{
+		return;
+	}
+
+	for (const int32 Page : ViewerData.Pages)
+	{
+		if (TArray<TWeakObjectPtr<UCInventoryComponent>>* Subscribers = m_PageSubscribers.Find(Page))
+		{
+			Subscribers->RemoveSwap(Viewer);
+			if (Subscribers->Num() == 0)
+			{
+				m_PageSubscribers.Remove(Page);
+			}
+		}
+	}
+
+	UpdateDormancy();
+}
+
+bool UCStorageComponent::TakeItem(UCInventoryComponent* Viewer, const int32 Page, const int32 PageVersion, const int32 IndexInPage, const int32 Quantity)
+{
+	if (!GetOwner()->HasAuthority() || Viewer == nullptr || Quantity <= 0)
+	{
+		return false;
+	}
+
+	FCAuditScope AuditScope(ECAuditOp::Storage);
+
+	// Only viewers that can actually see the page can take from it
+	const FCStorageViewer* ViewerData = m_Viewers.Find(Viewer);
+	if (ViewerData == nullptr || !ViewerData->Pages.Contains(Page) || !IsViewerRelevant(Viewer))
+	{
+		return false;
+	}
+
+	// Someone else changed the page since the viewer last saw it, send them the new version and let them try again
+	if (PageVersion != GetPageVersion(Page))
+	{
+		Viewer->ClientReceiveStoragePage(this, BuildPage(Page));
+		return false;
+	}
+
+	const int32 Index = Page * m_PageSize + IndexInPage;
+	if (IndexInPage >= m_PageSize || !GetInventory().IsValidIndex(Index))
+	{
+		return false;
+	}
+
+	FCItem ItemToTake = GetInventory()[Index];
+	ItemToTake.Quantity = FMath::Min(Quantity, ItemToTake.Quantity);
+
+	if (!Viewer->AddItem(ItemToTake))
+	{
+		return false;
+	}
+
+	return RemoveFromIndex(Index, ItemToTake.Quantity);
+}
+
+bool UCStorageComponent::DepositItem(UCInventoryComponent* Viewer, const int32 InventoryIndex, const int32 Quantity)
+{
+	if (!GetOwner()->HasAuthority() || Viewer == nullptr || Quantity <= 0)
+	{
+		return false;
+	}
+
+	FCAuditScope AuditScope(ECAuditOp::Storage);
+
+	if (!m_Viewers.Contains(Viewer) || !IsViewerRelevant(Viewer) || !Viewer->GetInventory().IsValidIndex(InventoryIndex))
+	{
+		return false;
+	}
+
+	FCItem ItemToDeposit = Viewer->GetInventory()[InventoryIndex];
+	ItemToDeposit.Quantity = FMath::Min(Quantity, ItemToDeposit.Quantity);
+
+	if (!AddItem(ItemToDeposit))
+	{
+		return false;
+	}
+
+	return Viewer->RemoveFromIndex(InventoryIndex, ItemToDeposit.Quantity);
+}
+
+bool UCStorageComponent::GetReceivedPage(const int32 Page, FCStoragePage& OutPage) const
+{
+	if (const FCStoragePage* ReceivedPage = m_ReceivedPages.Find(Page))
+	{
+		OutPage = *ReceivedPage;
+		return true;
+	}
+
+	return false;
+}
+
+void UCStorageComponent::ReceivePage(const FCStoragePage& Page)
+{
+	m_ReceivedPages.Add(Page.Page, Page);
+	OnPageReceived.Broadcast(Page.Page);
+}
+
+void UCStorageComponent::DropReceivedPage(const int32 Page)
+{
+	m_ReceivedPages.Remove(Page);
+}
+
+void UCStorageComponent::ClearReceivedPages()
+{
+	m_ReceivedPages.Reset();
+}
+
+void UCStorageComponent::PostInventoryChange(const FCInventoryChange& Change)
+{
+	if (!GetOwner()->HasAuthority() || Change.Slot != ECItemSlot::None || Change.Index == INDEX_NONE)
+	{
+		return;
+	}
+
+	const int32 FirstPage = Change.Index / m_PageSize;
+
+	if (Change.Type == ECInventoryChangeType::Removed)
+	{
+		// Everything after a removed item shifts down so every page from here on is stale
+		const int32 LastPage = GetInventory().Num() / m_PageSize;
+		for (int32 Page = FirstPage; Page <= LastPage; ++Page)
+		{
+			MarkPageDirty(Page);
+		}
+	}
+	else
+	{
+		MarkPageDirty(FirstPage);
+	}
+}
+
+bool UCStorageComponent::IsViewerRelevant(const UCInventoryComponent* Viewer) const
+{
+	const AActor* ViewerActor = Viewer != nullptr ? Viewer->GetOwner() : nullptr;
+	if (ViewerActor == nullptr)
+	{
+		return false;
+	}
+
+	if (m_MaxViewDistance <= 0.0f)
+	{
+		return true;
+	}
+
+	return FVector::DistSquared(ViewerActor->GetActorLocation(), GetOwner()->GetActorLocation()) <= FMath::Square(m_MaxViewDistance);
+}
+
+bool UCStorageComponent::IsValidPageIndex(const int32 Page) const
+{
+	return Page >= 0 && Page < FMath::DivideAndRoundUp(GetMaxItems(), m_PageSize);
+}
+
+FCStoragePage UCStorageComponent::BuildPage(const int32 Page) const
+{
+	const TArray<FCItem>& Items = GetInventory();
+
+	FCStoragePage Result;
+	Result.Page = Page;
+	Result.Version = GetPageVersion(Page);
+	Result.TotalItems = Items.Num();
+
+	const int32 First = Page * m_PageSize;
+	const int32 Last = FMath::Min(First + m_PageSize, Items.Num());
+
+	if (First < Last)
+	{
+		Result.Items.Append(Items.GetData() + First, Last - First);
+	}
+
+	return Result;
+}
+
+void UCStorageComponent::MarkPageDirty(const int32 Page)
+{
+	if (m_PageVersions.Num() <= Page)
+	{
+		m_PageVersions.SetNumZeroed(Page + 1);
+	}
+
+	++m_PageVersions[Page];
+
+	// Pages nobody is looking at only need their version bumped
+	if (!m_PageSubscribers.Contains(Page))
+	{
+		return;
+	}
+
+	m_DirtyPages.Add(Page);
+
+	if (!m_bPageFlushScheduled)
+	{
+		m_bPageFlushScheduled = true;
+		GetWorld()->GetTimerManager().SetTimerForNextTick(this, &UCStorageComponent::FlushDirtyPages);
+	}
+}
+
+void UCStorageComponent::FlushDirtyPages()
+{
+	m_bPageFlushScheduled = false;
+
+	TArray<UCInventoryComponent*, TInlineAllocator<8>> IrrelevantViewers;
+
+	for (const int32 Page : m_DirtyPages)
+	{
+		const TArray<TWeakObjectPtr<UCInventoryComponent>>* Subscribers = m_PageSubscribers.Find(Page);
+		if (Subscribers == nullptr)
+		{
+			continue;
+		}
+
+		// Build the page once and send the same copy to every viewer of it
+		const FCStoragePage PageData = BuildPage(Page);
+
+		for (const auto& WeakViewer : *Subscribers)
+		{
+			UCInventoryComponent* Viewer = WeakViewer.Get();
+			if (Viewer == nullptr || !IsViewerRelevant(Viewer))
+			{
+				IrrelevantViewers.AddUnique(Viewer);
+				continue;
+			}
+
+			Viewer->ClientReceiveStoragePage(this, PageData);
+		}
+	}
+
+	m_DirtyPages.Reset();
+
+	for (UCInventoryComponent* Viewer : IrrelevantViewers)
+	{
+		if (Viewer != nullptr)
+		{
+			RemoveViewer(Viewer);
+		}
+	}
+
+	// Clean up viewers that were destroyed
+	for (auto It = m_Viewers.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid())
+		{
+			for (const int32 Page : It.Value().Pages)
+			{
+				if (TArray<TWeakObjectPtr<UCInventoryComponent>>* Subscribers = m_PageSubscribers.Find(Page))
+				{
+					Subscribers->RemoveAllSwap([](const TWeakObjectPtr<UCInventoryComponent>& Subscriber) { return !Subscriber.IsValid(); });
+				}
+			}
+
+			It.RemoveCurrent();
+		}
+	}
+
+	UpdateDormancy();
+}
+
+void UCStorageComponent::UpdateDormancy()
+{
+	AActor* Owner = GetOwner();
+	if (!m_bDormantWhenUnviewed || !Owner->HasAuthority())
+	{
+		return;
+	}
+
+	const ENetDormancy Dormancy = m_Viewers.Num() > 0 ? DORM_Awake : DORM_DormantAll;
+	if (Owner->NetDormancy != Dormancy)
+	{
+		Owner->SetNetDormancy(Dormancy);
+	}
+}
@@ -2,6 +2,9 @@
 
 #include "UnrealInventory.h"
 
+#include "AuditLog.h"
+#include "NetProfiler.h"
+
 #define LOCTEXT_NAMESPACE "FUnrealInventoryModule"
 
 void FUnrealInventoryModule::StartupModule()
@@ -13,6 +16,12 @@ void FUnrealInventoryModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+
+	// Write out whatever is still waiting in the audit rings
+	FCAuditLog::Get().Shutdown();
+
+	// The measuring package map is a UObject and can't wait for static destruction
+	FCNetProfiler::Get().Shutdown();
 }
 
 #undef LOCTEXT_NAMESPACE
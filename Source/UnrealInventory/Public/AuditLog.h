@@ -0,0 +1,194 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <CoreMinimal.h>
+
+#include <atomic>
+
+class FCAuditDrain;
+class FRunnableThread;
+class UCItemDescriptorBase;
+
+namespace UnrealInventory
+{
+	namespace Audit
+	{
+		/** Records a thread can have waiting for the drain thread before new ones are dropped, has to be a power of two. */
+		static constexpr int32 RingCapacity = 8192;
+
+		/** How often the drain thread writes out what was recorded. */
+		static constexpr float DrainInterval = 0.1f;
+
+		/** A new file is started once the current one is this large. */
+		static constexpr int64 MaxFileSize = 64 * 1024 * 1024;
+
+		/** The oldest files are deleted once there are more. */
+		static constexpr int32 MaxFiles = 32;
+
+		static constexpr uint32 FileMagic = 0x4C414955;
+		static constexpr uint32 FileVersion = 1;
+
+		static constexpr const TCHAR* FileExtension = TEXT(".audit");
+		static constexpr const TCHAR* NamesExtension = TEXT(".names");
+	};
+};
+
+/** The operation a change was part of. */
+enum class ECAuditOp : uint8
+{
+	/** A change made directly through the inventory such as AddItem. */
+	None,
+	Equip,
+	Drop,
+	Trade,
+	Loot,
+	Craft,
+	Pickup,
+	Storage,
+	Command,
+
+	MAX
+};
+
+UNREALINVENTORY_API const TCHAR* LexToString(const ECAuditOp Op);
+
+/**
+ * One change to an inventory, written to the audit files as is.
+ */
+struct FCAuditRecord
+{
+	/** FPlatformTime::Cycles64 when the change was recorded, see FCAuditFileHeader. */
+	uint64 Cycles = 0;
+
+	/** Every change made by the same operation shares the transaction, 0 for changes made outside of one. */
+	uint64 Transaction = 0;
+
+	/** Ids of the owner and descriptor, the names are in the names file of the session. Ids are only unique within a session. */
+	uint32 Owner = 0;
+	uint32 ItemDescriptor = 0;
+
+	int32 QuantityDelta = 0;
+
+	ECAuditOp Op = ECAuditOp::None;
+
+	/** The ECInventoryChangeType, ECItemSlot and ECItemRarity of the change. */
+	uint8 ChangeType = 0;
+	uint8 Slot = 0;
+	uint8 Rarity = 0;
+};
+
+static_assert(sizeof(FCAuditRecord) == 32, "Audit records are written to disk as is, bump the file version when they change");
+
+/**
+ * The start of every audit file, the records follow.
+ */
+struct FCAuditFileHeader
+{
+	uint32 Magic = UnrealInventory::Audit::FileMagic;
+	uint32 Version = UnrealInventory::Audit::FileVersion;
+	uint32 RecordSize = sizeof(FCAuditRecord);
+	uint32 Reserved = 0;
+
+	/** Cycles and UTC ticks sampled at the same time, a record happened SecondsPerCycle * (Cycles - BaseCycles) seconds after BaseUtcTicks. */
+	uint64 BaseCycles = 0;
+	int64 BaseUtcTicks = 0;
+	double SecondsPerCycle = 0.0;
+
+	FDateTime GetTime(const uint64 Cycles) const { return FDateTime(BaseUtcTicks) + FTimespan::FromSeconds(SecondsPerCycle * static_cast<double>(static_cast<int64>(Cycles - BaseCycles))); }
+};
+
+/**
+ * Audit trail of every change to an inventory on the server, does nothing unless UnrealInventory.Audit is 1.
+ * Recording only copies a record into a ring buffer owned by the calling thread, a background thread drains the rings into rotating files in Saved/Audit
+ * so the game thread never waits on a lock or the disk. Records are dropped instead if a ring fills up faster than it's drained.
+ * Read the files with the InventoryAudit commandlet.
+ */
+class UNREALINVENTORY_API FCAuditLog
+{
+public:
+	static FCAuditLog& Get();
+
+	static bool IsEnabled();
+
+	/** Record a change made on this thread, the time and the current transaction are filled in. */
+	void Record(FCAuditRecord Record);
+
+	/** The id of the name, handed out in order so no two names share one. The name is written to the names file the first time. */
+	uint32 GetNameId(const FString& Name);
+	uint32 GetDescriptorId(const UCItemDescriptorBase* ItemDescriptor);
+
+	/** Write out everything that's left and stop the drain thread, nothing is recorded afterwards. */
+	void Shutdown();
+
+	/** Records dropped because a ring was full. */
+	uint64 GetDroppedCount() const;
+
+	/** Start a transaction on this thread unless one is running already, returns whether it was started. */
+	static bool BeginTransaction(const ECAuditOp Op);
+	static void EndTransaction();
+
+private:
+	friend class FCAuditDrain;
+
+	struct FCAuditRing;
+
+	/** The ring of the calling thread, created the first time the thread records anything. */
+	FCAuditRing* GetThreadRing();
+
+	/** Start the drain thread if it isn't running yet. */
+	void Start();
+
+	/** Move everything out of the rings and into the files, only called by the drain thread or once it's stopped. */
+	void Drain();
+
+	/** Start a new file for the records. */
+	void OpenFile();
+	void DeleteOldFiles();
+
+	mutable FCriticalSection m_RingsLock;
+	TArray<FCAuditRing*> m_Rings;
+
+	FCriticalSection m_NamesLock;
+	TMap<FString, uint32> m_NameIds;
+	TArray<TPair<uint32, FString>> m_PendingNames;
+
+	FCriticalSection m_StartLock;
+	std::atomic<bool> m_bStarted{false};
+	std::atomic<bool> m_bShutdown{false};
+
+	FCAuditDrain* m_Drain = nullptr;
+	FRunnableThread* m_Thread = nullptr;
+
+	/** Only touched by the drain thread. */
+	TUniquePtr<FArchive> m_File;
+	int64 m_FileSize = 0;
+	int32 m_FileIndex = 0;
+	FString m_Directory;
+	FString m_Session;
+	TArray<FCAuditRecord> m_DrainBuffer;
+};
+
+/**
+ * Groups every change made while it's in scope into one transaction, nested scopes join the outer transaction.
+ */
+class FCAuditScope
+{
+public:
+	/** None doesn't start a transaction, for functions that only sometimes need one. */
+	explicit FCAuditScope(const ECAuditOp Op) : m_bStarted(Op != ECAuditOp::None && FCAuditLog::IsEnabled() && FCAuditLog::BeginTransaction(Op)) {}
+
+	~FCAuditScope()
+	{
+		if (m_bStarted)
+		{
+			FCAuditLog::EndTransaction();
+		}
+	}
+
+	FCAuditScope(const FCAuditScope&) = delete;
+	FCAuditScope& operator=(const FCAuditScope&) = delete;
+
+private:
+	const bool m_bStarted;
+};
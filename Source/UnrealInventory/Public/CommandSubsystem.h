@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <CoreMinimal.h>
+#include <Subsystems/WorldSubsystem.h>
+
+#include "CommandSubsystem.generated.h"
+
+class UCInventoryComponent;
+class UNetConnection;
+struct FCInventoryCommand;
+
+namespace UnrealInventory
+{
+	namespace Commands
+	{
+		/** The most commands a single batch can carry, clients split larger batches and a bigger batch is treated as malformed. */
+		static constexpr int32 MaxCommandsPerBatch = 64;
+	};
+};
+
+/**
+ * Applies the inventory commands clients send on the server, see UCInventoryComponent::QueueCommand.
+ * Commands are queued as they arrive and every inventory applies its queue in one pass per frame, so a burst of commands costs a single pass over the inventory.
+ * Every connection has a token bucket that commands are paid from, commands a connection can't pay for are dropped before they cost anything else.
+ * The limits are configured in the game ini under [/Script/UnrealInventory.CCommandSubsystem].
+ */
+UCLASS(Config = Game)
+class UNREALINVENTORY_API UCCommandSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Queue commands to be applied to the inventory this frame, paid for by the connection owning the inventory.
+	 * @return How many of the commands were queued.
+	 */
+	int32 QueueCommands(UCInventoryComponent* Inventory, TArrayView<const FCInventoryCommand> Commands);
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual bool IsTickable() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(EWorldType::Type WorldType) const override;
+
+	/** How many commands a connection can send per second on average. */
+	UPROPERTY(Config, EditAnywhere, Category = "UnrealInventory|Config", meta = (DisplayName = "Commands Per Second", ClampMin = "0.1"))
+	float m_CommandsPerSecond = 20.0f;
+
+	/** How many commands a connection can send at once after being idle. */
+	UPROPERTY(Config, EditAnywhere, Category = "UnrealInventory|Config", meta = (DisplayName = "Command Burst", ClampMin = "1"))
+	int32 m_CommandBurst = 40;
+
+	/** The most commands an inventory can have waiting for the next pass, more are dropped. */
+	UPROPERTY(Config, EditAnywhere, Category = "UnrealInventory|Config", meta = (DisplayName = "Max Queued Commands", ClampMin = "1"))
+	int32 m_MaxQueuedCommands = 64;
+
+private:
+	struct FCTokenBucket
+	{
+		float Tokens = 0.0f;
+		double LastRefillTime = 0.0;
+	};
+
+	/** Take up to Count tokens from the bucket of the connection, returns how many were taken. */
+	int32 TakeTokens(const UNetConnection* Connection, const int32 Count);
+
+	TMap<TWeakObjectPtr<const UNetConnection>, FCTokenBucket> m_Buckets;
+
+	/** Inventories with queued commands. */
+	TArray<TWeakObjectPtr<UCInventoryComponent>> m_PendingInventories;
+};
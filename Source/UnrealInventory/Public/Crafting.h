@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ItemDataAsset.h"
+
+#include <CoreMinimal.h>
+#include <Engine/DataAsset.h>
+
+#include "Crafting.generated.h"
+
+class UCInventoryComponent;
+
+/**
+ * An amount of items that should be consumed.
+ */
+USTRUCT(BlueprintType)
+struct FCItemConsumable
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item", meta = (DisplayName = "Item Descriptor"))
+	UCItemDescriptorBase* ItemDescriptor = nullptr;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item", meta = (DisplayName = "Quantity", ClampMin = "1"))
+	int32 Quantity = 1;
+
+	/** Only items of at least this rarity are consumed. */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item", meta = (DisplayName = "Min Rarity"))
+	ECItemRarity MinRarity = ECItemRarity::Common;
+};
+
+/**
+ * Turns a set of items into another set of items.
+ */
+UCLASS(BlueprintType)
+class UNREALINVENTORY_API UCItemRecipe : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UFUNCTION(BlueprintPure, Category = "Inventory|Recipe")
+	const TArray<FCItemConsumable>& GetInputs() const { return m_Inputs; }
+
+	UFUNCTION(BlueprintPure, Category = "Inventory|Recipe")
+	const TArray<FCItem>& GetOutputs() const { return m_Outputs; }
+
+	UFUNCTION(BlueprintPure, Category = "Inventory|Recipe")
+	float GetDuration() const { return m_Duration; }
+
+protected:
+	/** The items consumed for a single craft. */
+	UPROPERTY(EditDefaultsOnly, Category = "Recipe|Config", meta = (DisplayName = "Inputs"))
+	TArray<FCItemConsumable> m_Inputs;
+
+	/** The items created by a single craft. */
+	UPROPERTY(EditDefaultsOnly, Category = "Recipe|Config", meta = (DisplayName = "Outputs"))
+	TArray<FCItem> m_Outputs;
+
+	/** How many seconds a single craft takes when processed over time, see UCProcessingSubsystem. */
+	UPROPERTY(EditDefaultsOnly, Category = "Recipe|Config", meta = (DisplayName = "Duration", ClampMin = "0"))
+	float m_Duration = 0.0f;
+};
+
+/**
+ * A recipe being processed over time by an inventory such as a smelter. Replicated so clients can work out the progress themselves.
+ */
+USTRUCT(BlueprintType)
+struct FCProcessingJob
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory|Processing")
+	int32 JobId = INDEX_NONE;
+
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory|Processing")
+	UCItemRecipe* Recipe = nullptr;
+
+	/** How many crafts are left including the current one. */
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory|Processing")
+	int32 Remaining = 0;
+
+	/** Server world time the current craft started. */
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory|Processing")
+	float StartTime = 0.0f;
+
+	/** Server world time the current craft completes. */
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory|Processing")
+	float EndTime = 0.0f;
+
+	float GetProgress(const float ServerTime) const
+	{
+		return EndTime > StartTime ? FMath::Clamp((ServerTime - StartTime) / (EndTime - StartTime), 0.0f, 1.0f) : 1.0f;
+	}
+};
+
+/**
+ * Resolves consumables against one or more inventories.
+ * The stacks of a descriptor are looked up in the inventories' descriptor index the first time it's needed, any amount of crafts can then
+ * be resolved against them and Commit applies all of them at once so the inventories only change (and replicate) a single time.
+ * Don't modify the inventories between creating the context and committing it.
+ */
+class UNREALINVENTORY_API FCCraftingContext
+{
+public:
+	/** The first inventory receives the outputs, the others are only used as a source such as nearby storage. */
+	explicit FCCraftingContext(TArrayView<UCInventoryComponent* const> Inventories);
+
+	/** How many items matching the consumable are still available in the context. */
+	int32 GetAvailableQuantity(const FCItemConsumable& Consumable) const;
+
+	/** How many times the recipe can be crafted with what's still available. */
+	int32 GetMaxCraftCount(const UCItemRecipe& Recipe) const;
+
+	/** Consume Count times the consumed items, either all of them are consumed or none. OutConsumed receives the stacks that were consumed. */
+	bool Consume(TArrayView<const FCItemConsumable> ConsumedItems, const int32 Count = 1, TArray<FCItem>* OutConsumed = nullptr);
+
+	/** Craft the recipe up to MaxCount times, INDEX_NONE crafts as many as possible. Returns how many times it was crafted. */
+	int32 Craft(const UCItemRecipe& Recipe, const int32 MaxCount = INDEX_NONE);
+
+	/** Queue an item to be added to the first inventory on commit. */
+	void AddOutput(const FCItem& Item, const int32 Count = 1);
+
+	/** Apply all the consumed items and outputs. If anything fails every inventory is restored and false is returned. */
+	bool Commit();
+
+private:
+	struct FCStackRef
+	{
+		int32 InventoryIndex = INDEX_NONE;
+		int32 ItemIndex = INDEX_NONE;
+		ECItemRarity Rarity = ECItemRarity::Common;
+		int32 Available = 0;
+		int32 Consumed = 0;
+	};
+
+	using FCStackRefs = TArray<FCStackRef, TInlineAllocator<4>>;
+
+	/** The stacks of the descriptor in every inventory, gathered the first time they're asked for. */
+	FCStackRefs& FindStacks(const UCItemDescriptorBase* ItemDescriptor) const;
+
+	/** Put the output inventory back the way it was before the outputs were added, for when it didn't need a full snapshot. */
+	void RestoreOutputs(const int32 FirstNewStack, TArrayView<const TPair<int32, FCItem>> ToppedUpStacks);
+
+	TArray<UCInventoryComponent*, TInlineAllocator<4>> m_Inventories;
+
+	/** The stacks of every descriptor looked at so far keyed by descriptor. */
+	mutable TMap<const UCItemDescriptorBase*, FCStackRefs> m_Stacks;
+
+	TArray<FCItem> m_Outputs;
+	bool m_bHasConsumed = false;
+};
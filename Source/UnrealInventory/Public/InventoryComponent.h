@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include "Crafting.h"
+#include "InventorySearch.h"
 #include "ItemDataAsset.h"
 
 #include <Components/ActorComponent.h>
@@ -9,6 +11,230 @@
 
 #include "InventoryComponent.generated.h"
 
+class UCStorageComponent;
+
+UENUM(BlueprintType)
+enum class ECInventoryChangeType : uint8
+{
+	Added,
+	Changed,
+	Removed,
+	Equipped
+};
+
+/**
+ * A single change to the inventory. Changes are coalesced and broadcast once per frame.
+ */
+USTRUCT(BlueprintType)
+struct FCInventoryChange
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory")
+	ECInventoryChangeType Type = ECInventoryChangeType::Changed;
+
+	/** The slot the change happened in, None if it happened in the inventory. */
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory")
+	ECItemSlot Slot = ECItemSlot::None;
+
+	/** The index into the inventory at the time of the change, INDEX_NONE for equippable slots. */
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory")
+	int32 Index = INDEX_NONE;
+
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory")
+	UCItemDescriptorBase* ItemDescriptor = nullptr;
+
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory")
+	ECItemRarity Rarity = ECItemRarity::Common;
+
+	/** How much the quantity changed by, negative if items were taken away. */
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory")
+	int32 QuantityDelta = 0;
+
+	/** Added and Removed stand for a row each, so only changes to a row that stays where it is are merged. */
+	bool CanCoalesceWith(const FCInventoryChange& Other) const
+	{
+		return (Type == ECInventoryChangeType::Changed || Type == ECInventoryChangeType::Equipped) && Type == Other.Type && Slot == Other.Slot && Index == Other.Index && ItemDescriptor == Other.ItemDescriptor && Rarity == Other.Rarity;
+	}
+};
+
+/**
+ * A window of items from a storage container that's sent to the viewers of that page.
+ */
+USTRUCT(BlueprintType)
+struct FCStoragePage
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory|Storage")
+	int32 Page = INDEX_NONE;
+
+	/** Bumped every time the page changes, requests made against an older version are rejected. */
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory|Storage")
+	int32 Version = 0;
+
+	/** The total amount of items in the storage so the UI can work out how many pages there are. */
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory|Storage")
+	int32 TotalItems = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory|Storage")
+	TArray<FCItem> Items;
+};
+
+UENUM(BlueprintType)
+enum class ECInventoryReservePolicy : uint8
+{
+	/** Reserve a small amount of items up front and grow as needed. */
+	Default,
+	/** Reserve the max items up front so the inventory never reallocates, best for small containers. */
+	ExactCapacity,
+	/** Don't reserve anything, best for large containers that are mostly empty. */
+	Lazy
+};
+
+UENUM(BlueprintType)
+enum class ECInventorySortKey : uint8
+{
+	Category,
+	Rarity,
+	Score,
+	Weight
+};
+
+USTRUCT(BlueprintType)
+struct FCInventorySortRule
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "UnrealInventory", meta = (DisplayName = "Key"))
+	ECInventorySortKey Key = ECInventorySortKey::Category;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "UnrealInventory", meta = (DisplayName = "Descending"))
+	bool bDescending = false;
+};
+
+/**
+ * Durability damage to apply to a single item, see UCInventoryComponent::ApplyDurabilityDamage.
+ */
+USTRUCT(BlueprintType)
+struct FCDurabilityEvent
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UnrealInventory")
+	ECItemSlot Slot = ECItemSlot::None;
+
+	/** The index into the inventory, ignored for equippable slots. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UnrealInventory")
+	int32 Index = INDEX_NONE;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UnrealInventory")
+	float Amount = 0.0f;
+};
+
+UENUM(BlueprintType)
+enum class ECInventoryCommandType : uint8
+{
+	/** Move the stack at Index to Target Index, the same item is merged into the target stack and anything else is swapped. */
+	Move,
+	/** Split Quantity off the stack at Index into a new stack. */
+	Split,
+	/** Drop Quantity of the item at Slot and Index into the world, INDEX_NONE for the whole stack. */
+	Drop,
+	/** Equip the stack at Index into Target Slot. */
+	Equip,
+	/** Move the item in Slot back into the inventory. */
+	Unequip,
+	/** Use the item at Slot and Index Quantity times. */
+	Use,
+
+	MAX UMETA(Hidden)
+};
+
+/**
+ * Something a client wants to do with its inventory, see UCInventoryComponent::QueueCommand.
+ * Commands are checked against the inventory on the server when they're applied, so a command that's out of date by then is simply rejected.
+ */
+USTRUCT(BlueprintType)
+struct FCInventoryCommand
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UnrealInventory")
+	ECInventoryCommandType Type = ECInventoryCommandType::Move;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UnrealInventory")
+	ECItemSlot Slot = ECItemSlot::None;
+
+	/** The index into the inventory, ignored for equippable slots. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UnrealInventory")
+	int32 Index = INDEX_NONE;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UnrealInventory")
+	ECItemSlot TargetSlot = ECItemSlot::None;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UnrealInventory")
+	int32 TargetIndex = INDEX_NONE;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UnrealInventory")
+	int32 Quantity = 1;
+
+	/** Only sends the bits the values need, most commands fit into a few bytes. */
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+};
+
+template <>
+struct TStructOpsTypeTraits<FCInventoryCommand> : public TStructOpsTypeTraitsBase2<FCInventoryCommand>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
+
+/**
+ * Totals over everything that's equipped, cached by the inventory and only rebuilt when an equippable slot changes.
+ */
+USTRUCT(BlueprintType)
+struct FCEquipmentStats
+{
+	GENERATED_BODY()
+
+	/** The sum of the score of every equipped item. */
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory|Equipment")
+	int32 TotalScore = 0;
+
+	/** The average score of the equipped items that have a score. */
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory|Equipment")
+	float GearScore = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory|Equipment")
+	float TotalWeight = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory|Equipment")
+	int32 EquippedCount = 0;
+
+	/** How many equipped items there are of each rarity, use UCInventoryComponent::GetEquippedRarityCount from Blueprint. */
+	UPROPERTY()
+	int32 RarityCounts[ECItemRarity::MAX] = {};
+
+	/** The score of the item in each slot scaled by the rarity multiplier of the item, use UCInventoryComponent::GetSlotModifier from Blueprint. */
+	UPROPERTY()
+	float SlotModifiers[ECItemSlot::MAX] = {};
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FCOnInventoryItemChanged, int32, Index, ECItemSlot, Slot, int32, QuantityDelta);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FCOnInventoryItemEquipped, ECItemSlot, Slot, const FCItem&, Item);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FCOnInventoryWeightChanged, float, OldWeight, float, NewWeight);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FCOnInventoryChangesFlushed, const TArray<FCInventoryChange>&, Changes);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FCOnProcessingJobsChanged);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FCOnEquipmentStatsChanged, const FCEquipmentStats&, Stats);
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FCOnInventoryItemChangedNative, const FCInventoryChange&);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FCOnInventoryWeightChangedNative, float, float);
+DECLARE_MULTICAST_DELEGATE_OneParam(FCOnInventoryChangesFlushedNative, TArrayView<const FCInventoryChange>);
+DECLARE_MULTICAST_DELEGATE_OneParam(FCOnEquipmentStatsChangedNative, const FCEquipmentStats&);
+
 UCLASS(ClassGroup = (UnrealInventory), meta = (BlueprintSpawnableComponent))
 class UNREALINVENTORY_API UCInventoryComponent : public UActorComponent
 {
@@ -21,9 +247,80 @@ public:
 	bool AddItem(const FCItem& Item, const ECItemSlot Slot = ECItemSlot::None);
 	bool RemoveItem(const FCItem& Item, const int32 Quantity = 1, const ECItemSlot Slot = ECItemSlot::None);
 
+	/**
+	 * Add a batch of items such as generated loot, stackable items are merged before they're added.
+	 * @param OutRemaining The items that didn't fit.
+	 * @return How many of the merged items were added.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory")
+	int32 AddItems(const TArray<FCItem>& Items, TArray<FCItem>& OutRemaining);
+
 	UFUNCTION(BlueprintCallable, Category = "UnrealInventory")
 	bool DropItem(UPARAM(ref) FCItem& Item, const int32 Quantity = 1);
 
+	/**
+	 * Consume the items from the inventory, either everything is consumed or nothing.
+	 * @param OutItems The stacks that were consumed.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory")
+	bool ConsumeItem(const TArray<FCItemConsumable>& ConsumedItems, TArray<FCItem>& OutItems);
+
+	/**
+	 * Craft a recipe, the outputs are added to this inventory.
+	 * @param MaxCount How many times to craft the recipe, INDEX_NONE to craft as many as possible.
+	 * @param AdditionalSources Other inventories to pull the inputs from such as nearby storage.
+	 * @return How many times the recipe was crafted.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory")
+	int32 CraftRecipe(const UCItemRecipe* Recipe, const int32 MaxCount, const TArray<UCInventoryComponent*>& AdditionalSources);
+
+	/**
+	 * Process a recipe over time, see UCProcessingSubsystem.
+	 * @return The id of the job or INDEX_NONE if the inputs for the first craft aren't available.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Processing")
+	int32 StartProcessing(UCItemRecipe* Recipe, const int32 Count = 1);
+
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Processing")
+	void CancelProcessing(const int32 JobId);
+
+	/** Progress of the current craft of a job from 0 to 1, works on clients as well. */
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|Processing")
+	float GetProcessingProgress(const int32 JobId) const;
+
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|Processing")
+	const TArray<FCProcessingJob>& GetProcessingJobs() const { return m_ProcessingJobs; }
+
+	/**
+	 * Damage a batch of items such as all the armor hit by an attack.
+	 * The damage is only written to the replicated health when the item crosses into another health group, until then it's kept on the server.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Durability")
+	void ApplyDurabilityDamage(const TArray<FCDurabilityEvent>& Events);
+
+	/** Apply the durability loss per use of the item. */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Durability")
+	void ApplyItemUse(const ECItemSlot Slot, const int32 Index, const int32 Uses = 1);
+
+	/** The current health of an item, evaluated on demand from the last written health and the decay rate of the item. */
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|Durability")
+	float GetItemHealth(const ECItemSlot Slot, const int32 Index) const;
+
+	/**
+	 * Move every item in the inventory that fits into another inventory.
+	 * @return How many stacks were moved.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory")
+	int32 MoveAllItemsTo(UCInventoryComponent* InventoryReceiver);
+
+	/**
+	 * Take the most valuable items from another inventory such as a container or a death pile that still fit within the remaining weight and slots.
+	 * Partial stacks are taken as well, either everything picked is moved or nothing is.
+	 * @return How many stacks of the source were taken from.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory")
+	int32 TakeBestFrom(UCInventoryComponent* Source);
+
 	/** Trade items from this inventory to another inventory. */
 	bool TradeItems(const TArray<FCItem>& ItemsToTrade, UCInventoryComponent* InventoryReceiver);
 
@@ -36,9 +333,27 @@ public:
 	UFUNCTION(BlueprintPure, Category = "UnrealInventory")
 	float GetMaxWeight() const { return m_MaxWeight; }
 
+	/** What everything in the inventory is worth at the health it was last written with, equipped items included. See FCItemValuation. */
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory")
+	float GetTotalValue() const;
+
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory")
+	int32 GetMaxItems() const { return m_MaxItems; }
+
 	UFUNCTION(BlueprintPure, Category = "UnrealInventory")
 	bool GetItemsFromCategory(const ECItemCategory Category, TArray<FCItem>& OutItems);
 
+	/**
+	 * Find the items in the inventory matching the query without copying them, cheap enough to run on every keystroke. Equipped items aren't searched.
+	 * @param OutIndices Ascending indices into GetInventory().
+	 * @return The amount of matching items.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Search")
+	int32 SearchInventory(const FCInventorySearchQuery& Query, TArray<int32>& OutIndices) const;
+
+	/** Same as above, the view is only valid until the next search or change to the inventory. */
+	TConstArrayView<int32> SearchInventory(const FCInventorySearchQuery& Query) const;
+
 	UFUNCTION(BlueprintPure, Category = "UnrealInventory")
 	const FCItem& GetItemByIndex(const ECItemSlot Slot = ECItemSlot::None, const int32 Index = -1);
 
@@ -53,20 +368,172 @@ public:
 	UFUNCTION(BlueprintPure, Category = "UnrealInventory")
 	const TArray<FCItem>& GetInventory() const { return m_Inventory; }
 
+	/** Cached totals over the equipped items, only rebuilt after an equippable slot changed. */
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|Equipment")
+	const FCEquipmentStats& GetEquipmentStats() const;
+
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|Equipment")
+	float GetSlotModifier(const ECItemSlot Slot) const { return Slot < ECItemSlot::MAX ? GetEquipmentStats().SlotModifiers[static_cast<uint8>(Slot)] : 0.0f; }
+
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|Equipment")
+	int32 GetEquippedRarityCount(const ECItemRarity Rarity) const { return Rarity < ECItemRarity::MAX ? GetEquipmentStats().RarityCounts[static_cast<uint8>(Rarity)] : 0; }
+
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|Equipment")
+	float GetRarityStatMultiplier(const ECItemRarity Rarity) const { return Rarity < ECItemRarity::MAX ? m_RarityStatMultipliers[static_cast<uint8>(Rarity)] : 1.0f; }
+
 	UFUNCTION(BlueprintPure, Category = "UnrealInventory")
 	int32 GetItemIndex(const FCItem& Item) const;
 
+	/** Give the item a score from this inventory's generation seed if it doesn't have one, replaying the same seed generates the same scores. */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory")
+	void GenerateItemScore(UPARAM(ref) FCItem& Item);
+
+	/**
+	 * Merge partial stacks and sort the inventory by the configured sort rules.
+	 * Only the indices that actually change are written so the replication delta stays small.
+	 * @return The amount of indices that were written to.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory")
+	int32 CompactAndSort();
+	int32 CompactAndSort(const TArray<FCInventorySortRule>& SortRules);
+
+	/** Start or stop viewing a page of a storage container. Called on the owning client, the page arrives through the storages OnPageReceived. */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Storage")
+	void ViewStoragePage(UCStorageComponent* Storage, const int32 Page, const bool bView = true);
+
+	/** Stop viewing all pages of a storage container. */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Storage")
+	void CloseStorage(UCStorageComponent* Storage);
+
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Storage")
+	void TakeFromStorage(UCStorageComponent* Storage, const int32 Page, const int32 PageVersion, const int32 IndexInPage, const int32 Quantity);
+
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Storage")
+	void DepositToStorage(UCStorageComponent* Storage, const int32 InventoryIndex, const int32 Quantity);
+
+	/**
+	 * Ask the server to apply a command to the inventory. Every command queued during a frame is sent in a single batch and applied together on the server, see UCCommandSubsystem.
+	 * Rejected commands are dropped, the inventory replicating back is the only answer.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Commands")
+	void QueueCommand(const FCInventoryCommand& Command);
+
+	/** Check a command against the inventory and apply it straight away, server only. */
+	bool ExecuteCommand(const FCInventoryCommand& Command);
+
+	/** Broadcast all the pending changes right away instead of waiting for the next frame. */
+	void FlushChanges();
+
+	UPROPERTY(BlueprintAssignable, Category = "UnrealInventory|Events")
+	FCOnInventoryItemChanged OnItemAdded;
+
+	UPROPERTY(BlueprintAssignable, Category = "UnrealInventory|Events")
+	FCOnInventoryItemChanged OnItemChanged;
+
+	UPROPERTY(BlueprintAssignable, Category = "UnrealInventory|Events")
+	FCOnInventoryItemChanged OnItemRemoved;
+
+	UPROPERTY(BlueprintAssignable, Category = "UnrealInventory|Events")
+	FCOnInventoryItemEquipped OnItemEquipped;
+
+	UPROPERTY(BlueprintAssignable, Category = "UnrealInventory|Events")
+	FCOnInventoryWeightChanged OnWeightChanged;
+
+	/** Fired when a processing job starts, completes a craft or finishes. */
+	UPROPERTY(BlueprintAssignable, Category = "UnrealInventory|Events")
+	FCOnProcessingJobsChanged OnProcessingJobsChanged;
+
+	/** Fired at most once per frame after any equippable slot changed. */
+	UPROPERTY(BlueprintAssignable, Category = "UnrealInventory|Events")
+	FCOnEquipmentStatsChanged OnEquipmentStatsChanged;
+
+	/** Fired once per frame with every coalesced change, after the individual events. */
+	UPROPERTY(BlueprintAssignable, Category = "UnrealInventory|Events")
+	FCOnInventoryChangesFlushed OnChangesFlushed;
+
+	FCOnInventoryItemChangedNative OnItemAddedNative;
+	FCOnInventoryItemChangedNative OnItemChangedNative;
+	FCOnInventoryItemChangedNative OnItemRemovedNative;
+	FCOnInventoryItemChangedNative OnItemEquippedNative;
+	FCOnInventoryWeightChangedNative OnWeightChangedNative;
+	FCOnInventoryChangesFlushedNative OnChangesFlushedNative;
+	FCOnEquipmentStatsChangedNative OnEquipmentStatsChangedNative;
+
 protected:
 	virtual void BeginPlay() override;
 	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+
+	/** If true the inventory isn't replicated as a whole, see UCStorageComponent. */
+	virtual bool UsesPagedReplication() const { return false; }
+
+	/** Called for every change recorded by NotifyChange before it's coalesced. */
+	virtual void PostInventoryChange(const FCInventoryChange& Change) {}
+
+	/** Remove up to Quantity items from the stack at Index in the inventory. */
+	bool RemoveFromIndex(const int32 Index, const int32 Quantity);
 
+	/** How much weight the inventory can hold, 0 for no limit. */
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "UnrealInventory|Config", meta = (DisplayName = "Max Weight"))
 	float m_MaxWeight = 100.0f;
 
+	/** How many stacks the inventory can hold. */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "UnrealInventory|Config", meta = (DisplayName = "Max Items", ClampMin = "1"))
+	int32 m_MaxItems = UnrealInventory::Items::MaxItems;
+
+	/** How memory for the inventory is allocated ahead of time. */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "UnrealInventory|Config", meta = (DisplayName = "Reserve Policy"))
+	ECInventoryReservePolicy m_ReservePolicy = ECInventoryReservePolicy::Default;
+
+	/** The seed items generated by this inventory are derived from, 0 picks a random seed on BeginPlay. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "UnrealInventory|Config", meta = (DisplayName = "Generation Seed"))
+	int32 m_GenerationSeed = 0;
+
+	/** How much the score of an equipped item counts towards its slot modifier based on the rarity. */
+	UPROPERTY(EditDefaultsOnly, Category = "UnrealInventory|Config", meta = (DisplayName = "Rarity Stat Multipliers"))
+	float m_RarityStatMultipliers[ECItemRarity::MAX] = {1.0f, 1.1f, 1.25f, 1.5f, 2.0f};
+
+	/** The rules used by CompactAndSort, the first rule has the highest priority. */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "UnrealInventory|Config", meta = (DisplayName = "Sort Rules"))
+	TArray<FCInventorySortRule> m_SortRules = {{ECInventorySortKey::Category, false}, {ECInventorySortKey::Rarity, true}, {ECInventorySortKey::Score, true}};
+
 	UPROPERTY(EditDefaultsOnly, Category = "UnrealInventory", meta = (DisplayName = "TestItem"))
 	TSoftObjectPtr<UCItemDescriptorBase> m_TestItem;
 
 private:
+	friend class UCStorageComponent;
+	friend class FCCraftingContext;
+	friend class UCProcessingSubsystem;
+	friend class UCCommandSubsystem;
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerViewStoragePage(UCStorageComponent* Storage, const int32 Page, const bool bView);
+
+	UFUNCTION(Server, Reliable)
+	void ServerCloseStorage(UCStorageComponent* Storage);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerTakeFromStorage(UCStorageComponent* Storage, const int32 Page, const int32 PageVersion, const int32 IndexInPage, const int32 Quantity);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerDepositToStorage(UCStorageComponent* Storage, const int32 InventoryIndex, const int32 Quantity);
+
+	UFUNCTION(Client, Reliable)
+	void ClientReceiveStoragePage(UCStorageComponent* Storage, const FCStoragePage& Page);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerExecuteCommands(const TArray<FCInventoryCommand>& Commands);
+
+	/** Send the commands queued this frame in as few batches as possible. */
+	void SendQueuedCommands();
+
+	/** Apply every command the server queued for this inventory in one pass. */
+	void ApplyQueuedCommands();
+
+	/** Commands waiting to be sent on the client, or waiting to be applied on the server. */
+	TArray<FCInventoryCommand> m_QueuedCommands;
+	bool m_bCommandSendScheduled = false;
+
 	struct FCItemLocation
 	{
 		int32 Index = INDEX_NONE;
@@ -76,19 +543,160 @@ private:
 
 	TArray<FCItemLocation> FindItemLocation(const UCItemDescriptorBase* Item, const bool bSearchEquippables = false) const;
 
+	/** Indices of every stack of the descriptor in m_Inventory in ascending order, only rebuilt after a change the index can't follow. */
+	TConstArrayView<int32> GetStackIndices(const UCItemDescriptorBase* Item) const;
+
+	/** The exact stack the item is, or is a copy of, rather than the first one with the same descriptor and rarity. Null if it isn't in this inventory. */
+	FCItem* FindStoredItem(const FCItem& Item, ECItemSlot& OutSlot, int32& OutIndex);
+
 	/** Inventory of equippable items - basically itemslots other than None */
-	UPROPERTY(Replicated)
+	UPROPERTY(ReplicatedUsing = OnRep_EquippableInventory)
 	FCItem m_EquippableInventory[ECItemSlot::MAX];
 
 	/** Inventory of items in the slot none. */
-	UPROPERTY(Replicated)
+	UPROPERTY(ReplicatedUsing = OnRep_Inventory)
 	TArray<FCItem> m_Inventory;
 
+	/** Recipes being processed over time, only the start and end times replicate and clients work out the progress. */
+	UPROPERTY(ReplicatedUsing = OnRep_ProcessingJobs)
+	TArray<FCProcessingJob> m_ProcessingJobs;
+
+	UFUNCTION()
+	void OnRep_ProcessingJobs();
+
+	FCProcessingJob* FindProcessingJob(const int32 JobId) { return m_ProcessingJobs.FindByPredicate([JobId](const FCProcessingJob& Job) { return Job.JobId == JobId; }); }
+	/** Marks the jobs dirty for replication, call after every change to m_ProcessingJobs. */
+	void NotifyProcessingJobsChanged();
+
+	UFUNCTION()
+	void OnRep_EquippableInventory();
+
+	UFUNCTION()
+	void OnRep_Inventory(const TArray<FCItem>& OldInventory);
+
+	/** Copy of the equippable inventory from the last replication update so clients can work out what changed. */
+	FCItem m_LastEquippableInventory[ECItemSlot::MAX];
+
+	/** Changes that haven't been broadcast yet. */
+	TArray<FCInventoryChange> m_PendingChanges;
+
+	/** Where the last pending change to each slot and index is, so coalescing doesn't search every pending change. */
+	TMap<uint64, int32> m_PendingChangeIndices;
+
+	/** The last pending Added or Removed, anything recorded before it may be at a different row by now and isn't coalesced with. */
+	int32 m_LastPendingRowChange = INDEX_NONE;
+
+	static uint64 GetPendingChangeKey(const FCInventoryChange& Change) { return (static_cast<uint64>(Change.Slot) << 32) | static_cast<uint32>(Change.Index); }
+
+	/** The total weight of the inventory, kept up to date by NotifyChange. */
+	float m_TotalWeight = 0.0f;
+
+	/**
+	 * Stacks added minus stacks removed as seen by NotifyChange, the cached totals are reset once it's back at 0 so float error doesn't build up.
+	 * Unlike m_Inventory.Num() it doesn't matter whether a change is recorded before or after the array changes.
+	 */
+	int32 m_TrackedStackCount = 0;
+
+	/** Value of m_Inventory kept up to date by NotifyChange the same way as the weight, rebuilt on the next read if a change doesn't say how much it's worth. */
+	mutable double m_InventoryValue = 0.0;
+	mutable bool m_bInventoryValueDirty = false;
+
+	/** The weight we last told listeners about. */
+	float m_LastBroadcastWeight = 0.0f;
+
+	bool m_bFlushScheduled = false;
+
+	/** How many seeds have been handed out from m_GenerationSeed. */
+	uint32 m_GenerationCounter = 0;
+
+	uint32 NextItemSeed() { return UnrealInventory::Random::Hash(static_cast<uint32>(m_GenerationSeed), m_GenerationCounter++); }
+
+	void RebuildEquipmentStats() const;
+
+	/** Kept up to date by NotifyChange, rows are only indexed again when the inventory is searched. */
+	mutable FCInventorySearchIndex m_SearchIndex;
+
+	/**
+	 * The stacks of each descriptor in m_Inventory. NotifyChange keeps it up to date when the last stack is added or removed,
+	 * anything else marks it dirty and it's rebuilt on the next lookup.
+	 */
+	mutable TMap<const UCItemDescriptorBase*, TArray<int32, TInlineAllocator<2>>> m_DescriptorStacks;
+	/** How many rows of m_Inventory m_DescriptorStacks covers. */
+	mutable int32 m_DescriptorStacksNum = 0;
+	mutable bool m_bDescriptorStacksDirty = true;
+
+	void UpdateDescriptorStacks(const ECInventoryChangeType Type, const int32 Index, const FCItem& Item);
+
+	mutable FCEquipmentStats m_EquipmentStats;
+	mutable bool m_bEquipmentStatsDirty = true;
+
+	/** An equippable slot changed since OnEquipmentStatsChanged was last broadcast. */
+	bool m_bEquipmentChanged = false;
+
+	/** Record a change to be broadcast next frame. Every mutation of the inventories should go through here, pass OldItem if more than the quantity may have changed. */
+	void NotifyChange(const ECInventoryChangeType Type, const ECItemSlot Slot, const int32 Index, const FCItem& Item, const int32 QuantityDelta, const FCItem* OldItem = nullptr);
+	void BroadcastChange(const FCInventoryChange& Change);
+
+	/** The valid item at the slot and index, null if there's none. */
+	const FCItem* GetItem(const ECItemSlot Slot, const int32 Index) const;
+	FCItem* GetMutableItem(const ECItemSlot Slot, const int32 Index) { return const_cast<FCItem*>(GetItem(Slot, Index)); }
+
+	/** Write the health of the item back if it changed health group, so clients only get an update when the group changes. */
+	void CommitHealthIfGroupChanged(FCItem& Item, const ECItemSlot Slot, const int32 Index, const float ServerTime);
+
+	/** Record the changes required to go from OldInventory to the current inventory, stacks are matched by what they are rather than where they are. */
+	void NotifyInventoryDiff(const TArray<FCItem>& OldInventory);
+
+	/** Record what replicating the inventory would cost this net update, see FCNetProfiler. */
+	void ProfileReplication();
+
+	/** What was replicated on the last net update while profiling. */
+	TArray<FCItem> m_ProfiledInventory;
+	TArray<FCItem> m_ProfiledEquippableInventory;
+
+	/** Write the change to FCAuditLog, NotifyChange does this for every change on the server while auditing is on. */
+	void RecordAudit(const FCInventoryChange& Change);
+
+	/**
+	 * The net id of the player owning the inventory, or the path of the inventory for everything else.
+	 * Returns false if the owner is a player whose net id isn't known yet, the path is used until it is.
+	 */
+	bool GetAuditOwnerName(FString& OutName) const;
+
+	/** The id of GetAuditOwnerName in the audit log, worked out again on every change until the owner is resolved. */
+	uint32 m_AuditOwnerId = 0;
+	bool m_bAuditOwnerResolved = false;
+
+	/** Mark the array the slot belongs to dirty for push model replication, NotifyChange does this for every change. */
+	void MarkInventoryDirty(const ECItemSlot Slot);
+
+	/** Send the next change of a dormant owner, the owner goes back to sleep on its own afterwards. */
+	void FlushOwnerDormancy();
+
+	/** Log every property that changed since the last net update without being marked dirty, see UnrealInventory.Net.ValidatePushModel. */
+	void ValidatePushModel();
+
+	uint32 m_ValidatedInventoryHash = 0;
+	uint32 m_ValidatedEquippableInventoryHash = 0;
+	uint32 m_ValidatedProcessingJobsHash = 0;
+	bool m_bPushModelValidated = false;
+
+	bool m_bInventoryMarkedDirty = false;
+	bool m_bEquippableInventoryMarkedDirty = false;
+	bool m_bProcessingJobsMarkedDirty = false;
+
+	/** Replace the inventory with a previous copy of it. */
+	void RestoreInventory(const TArray<FCItem>& Snapshot);
+
+	/** Record the changes required to go from OldItem to NewItem at Index in the inventory. */
+	void NotifyItemReplaced(const int32 Index, const FCItem& OldItem, const FCItem& NewItem);
+
 	bool AddItemInternal(const FCItem& Item, const ECItemSlot Slot);
 	bool RemoveItemInternal(const FCItem& Item, const int32 Quantity, const ECItemSlot Slot);
 	bool DropItemInternal(const FCItem& Item, const int32 Quantity, const ECItemSlot Slot);
 
 	bool MoveItemToInventory(const FCItem& Item, UCInventoryComponent* InventoryReceiver);
 
-	ACItemActor* CreatePickup(const FCItem& Item, const int32 Quantity = INDEX_NONE);
+	/** Spawn a pickup for Quantity of the item at the owner, the whole stack if Quantity is INDEX_NONE. */
+	bool CreatePickup(const FCItem& Item, const int32 Quantity = INDEX_NONE);
 };
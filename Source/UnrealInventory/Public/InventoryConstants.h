@@ -10,6 +10,8 @@ namespace UnrealInventory
 		static const FLinearColor EpicColor = FLinearColor(FColor::Purple);
 		static const FLinearColor LegendaryColor = FLinearColor(FColor::Orange);
 
+		static constexpr float MaxHealth = 100.0f;
+
 		static constexpr float MaxWeight = 300.0f;
 		static constexpr int32 MaxItems = 200;
 
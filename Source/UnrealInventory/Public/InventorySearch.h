@@ -0,0 +1,129 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ItemDataAsset.h"
+
+#include <CoreMinimal.h>
+#include <UObject/ObjectKey.h>
+
+#include "InventorySearch.generated.h"
+
+/**
+ * What to look for with UCInventoryComponent::SearchInventory, an empty filter matches everything.
+ */
+USTRUCT(BlueprintType)
+struct FCInventorySearchQuery
+{
+	GENERATED_BODY()
+
+	/** Every word has to be in the title, words shorter than three letters only match the start of a word in the title. Case and punctuation are ignored. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UnrealInventory|Search", meta = (DisplayName = "Text"))
+	FString Text;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UnrealInventory|Search", meta = (DisplayName = "Categories"))
+	TArray<ECItemCategory> Categories;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UnrealInventory|Search", meta = (DisplayName = "Rarities"))
+	TArray<ECItemRarity> Rarities;
+
+	/** Items that fit into any of these slots. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UnrealInventory|Search", meta = (DisplayName = "Item Slots"), meta = (Bitmask, BitmaskEnum = "ECItemSlot"))
+	int32 ItemSlots = 0;
+
+	/** Only match items with a score inside of the score range, items without a score never match. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UnrealInventory|Search", meta = (DisplayName = "Filter Score"))
+	bool bFilterScore = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "UnrealInventory|Search", meta = (DisplayName = "Score Range", EditCondition = "bFilterScore"))
+	FIntPoint ScoreRange = FIntPoint(0, MAX_int32);
+};
+
+namespace UnrealInventory
+{
+	namespace Search
+	{
+		static constexpr int32 CategoryCount = static_cast<int32>(ECItemCategory::MAX);
+
+		/** Words shorter than this are looked up as prefixes, longer ones by every run of this many letters. */
+		static constexpr int32 GramSize = 3;
+	};
+};
+
+/**
+ * Index over the items of an inventory so searches don't have to touch the items or their titles.
+ * Every row is in a bitset per category, rarity and slot, titles are lowercased in the current culture once per descriptor and indexed by word prefixes and trigrams.
+ * The owner records which rows changed and the index catches up on the next search, so a batch of changes is only indexed once.
+ */
+class UNREALINVENTORY_API FCInventorySearchIndex
+{
+public:
+	/** The item at the row changed but nothing moved. */
+	void MarkRowDirty(const int32 Row);
+
+	/** Items from the row on may have moved, such as after an item was added or removed. */
+	void MarkRowsDirtyFrom(const int32 Row);
+
+	/** Forget everything and index all items again on the next search. */
+	void Reset();
+
+	/**
+	 * Find the items matching the query.
+	 * @param Items The items the changes were recorded for.
+	 * @return Ascending indices into Items, only valid until the next search.
+	 */
+	TConstArrayView<int32> Search(TArrayView<const FCItem> Items, const FCInventorySearchQuery& Query);
+
+	/** Lowercase the text and turn everything but letters and numbers into single spaces. */
+	static FString NormalizeText(const FText& Text);
+
+private:
+	struct FCSearchRow
+	{
+		TObjectKey<UCItemDescriptorBase> ItemDescriptor;
+		int32 Title = INDEX_NONE;
+		int32 Score = INDEX_NONE;
+		int32 ItemSlots = 0;
+		ECItemCategory Category = ECItemCategory::Ammo;
+		ECItemRarity Rarity = ECItemRarity::Common;
+
+		bool Matches(const FCItem& Item) const { return Title != INDEX_NONE && ItemDescriptor == TObjectKey<UCItemDescriptorBase>(Item.ItemDescriptor) && Rarity == Item.Rarity && Score == Item.Score; }
+	};
+
+	/** Bring every dirty row up to date with the items. */
+	void Sync(TArrayView<const FCItem> Items);
+
+	void SetRow(const int32 Row, const FCItem& Item);
+	void ClearRow(const int32 Row);
+	void SetRowBits(const int32 Row, const bool bValue);
+
+	/** The title of the descriptor, indexed the first time it's seen. */
+	int32 GetTitle(const UCItemDescriptorBase* ItemDescriptor);
+
+	/** Mark the titles containing the word, words shorter than the gram size have to start a word of the title. */
+	void FindTitles(const FString& Word, TBitArray<>& OutTitles) const;
+
+	static uint64 GetGramKey(const TCHAR* Chars, const int32 Count);
+
+	TArray<FCSearchRow> m_Rows;
+
+	TBitArray<> m_CategoryRows[UnrealInventory::Search::CategoryCount];
+	TBitArray<> m_RarityRows[static_cast<int32>(ECItemRarity::MAX)];
+	TBitArray<> m_SlotRows[static_cast<int32>(ECItemSlot::MAX)];
+
+	/** Normalized titles, a descriptor keeps its title for as long as the index exists. */
+	TArray<FString> m_Titles;
+	TMap<TObjectKey<UCItemDescriptorBase>, int32> m_TitleIds;
+
+	/** Ascending titles for every word prefix shorter than the gram size and every gram. */
+	TMap<uint64, TArray<int32>> m_TitleGrams;
+
+	/** The culture the titles were normalized in. */
+	FString m_Culture;
+
+	/** Rows from here on have to be compared against the items again. */
+	int32 m_FirstDirtyRow = 0;
+	TArray<int32> m_DirtyRows;
+
+	TArray<int32> m_Results;
+};
@@ -2,12 +2,14 @@
 
 #pragma once
 
+#include "ItemDataAsset.h"
+
 #include <CoreMinimal.h>
 #include <GameFramework/Actor.h>
 
 #include "Item.generated.h"
 
-class UCItemDescriptorBase;
+class UCInventoryComponent;
 
 UCLASS()
 class UNREALINVENTORY_API ACItemActor : public AActor
@@ -29,14 +31,44 @@ public:
 	const ECItemRarity GetRarity() const { return m_Rarity; }
 	void SetRarity(const ECItemRarity NewRarity);
 
+	/** Spawn a pickup actor for the item, this is the spawn path every pickup actor goes through. */
+	static ACItemActor* SpawnPickup(UWorld* World, const FCItem& Item, const int32 Quantity, const FTransform& Transform);
+
+	/** The item the pickup holds, with the health, score and seed it was dropped with. */
+	FCItem GetItem() const;
+
+	/** Move the pickup into the inventory and destroy it. */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Item")
+	bool PickUp(UCInventoryComponent* Inventory);
+
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
 
 	UPROPERTY(EditDefaultsOnly, Category = "UnrealInventory|Item", meta = (DisplayName = "Item Descriptor"))
 	UCItemDescriptorBase* m_ItemDescriptor;
 
+	/** Stop replicating the pickup once it has been sent, it's only woken up again when it changes. */
+	UPROPERTY(EditDefaultsOnly, Category = "UnrealInventory|Config", meta = (DisplayName = "Dormant When Idle"))
+	bool m_bDormantWhenIdle = true;
+
 private:
+	friend class UCPickupSubsystem;
+
+	/** Where the pickup is in UCPickupSubsystem. */
+	int32 m_PickupIndex = INDEX_NONE;
+
+	/** Queued to be despawned by UCPickupSubsystem. */
+	bool m_bPendingDespawn = false;
+
+	/** Where the pickup is in the spatial grid of UCPickupSubsystem. */
+	FIntPoint m_PickupCell = FIntPoint::ZeroValue;
+	int32 m_PickupCellIndex = INDEX_NONE;
+
+	/** Keep the spatial grid up to date when the pickup is moved. */
+	void OnPickupMoved(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
 
 	UFUNCTION(Server, Reliable, WithValidation)
 	void ServerSetQuantity(const int32 NewQuantity);
@@ -49,4 +81,25 @@ private:
 
 	UPROPERTY(Replicated)
 	ECItemRarity m_Rarity = ECItemRarity::Common;
+
+	/** The rest of the item the pickup was spawned for so picking it up gives back the same item, only known on the server. */
+	UPROPERTY()
+	FCItem m_ItemState;
+
+	/** Record what replicating the pickup would cost this net update, see FCNetProfiler. */
+	void ProfileReplication();
+
+	/** What was replicated on the last net update while profiling. */
+	int32 m_ProfiledQuantity = 0;
+	ECItemRarity m_ProfiledRarity = ECItemRarity::MAX;
+
+	/** Log a property that changed since the last net update without being marked dirty, see UnrealInventory.Net.ValidatePushModel. */
+	void ValidatePushModel();
+
+	int32 m_ValidatedQuantity = 0;
+	ECItemRarity m_ValidatedRarity = ECItemRarity::MAX;
+	bool m_bPushModelValidated = false;
+
+	bool m_bQuantityMarkedDirty = false;
+	bool m_bRarityMarkedDirty = false;
 };
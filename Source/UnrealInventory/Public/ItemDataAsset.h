@@ -3,6 +3,7 @@
 #pragma once
 
 #include "InventoryConstants.h"
+#include "ItemRandom.h"
 
 #include <CoreMinimal.h>
 #include <Engine/DataAsset.h>
@@ -11,6 +12,7 @@
 
 class UTexture2D;
 class ACItemActor;
+struct FAssetData;
 
 UENUM(BlueprintType)
 enum class ECItemRarity : uint8
@@ -78,7 +80,9 @@ enum class ECItemCategory : uint8
 	Cooking,
 	Resources,
 	Quest,
-	Ammo
+	Ammo,
+
+	MAX UMETA(Hidden)
 };
 
 UENUM(BlueprintType)
@@ -139,8 +143,24 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Inventory|Item")
 	const FCItemRarityData& GetRarityData(const ECItemRarity Rarity) const;
 
+	UFUNCTION(BlueprintPure, Category = "Inventory|Item")
+	float GetDurabilityLossPerSecond() const { return m_DurabilityLossPerSecond; }
+
+	UFUNCTION(BlueprintPure, Category = "Inventory|Item")
+	float GetDurabilityLossPerUse() const { return m_DurabilityLossPerUse; }
+
 	TSubclassOf<ACItemActor> GetPickupClass() const;
 
+	virtual void PostLoad() override;
+	virtual void BeginDestroy() override;
+	virtual void PreSave(FObjectPreSaveContext ObjectSaveContext) override;
+	virtual void GetAssetRegistryTags(FAssetRegistryTagsContext Context) const override;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+	virtual EDataValidationResult IsDataValid(FDataValidationContext& Context) const override;
+#endif
+
 protected:
 	/** The name of this item. */
 	UPROPERTY(EditDefaultsOnly, Category = "Item|Config", meta = (DisplayName = "Title"))
@@ -155,26 +175,72 @@ protected:
 	UTexture2D* m_Icon = nullptr;
 
 	/** How many items of this can be stacked? */
-	UPROPERTY(EditDefaultsOnly, Category = "Item|Config", meta = (DisplayName = "Max Stack Size"))
+	UPROPERTY(EditDefaultsOnly, AssetRegistrySearchable, Category = "Item|Config", meta = (DisplayName = "Max Stack Size"))
 	int32 m_StackSize = 1;
 
 	/** The slot that the item can go into. */
-	UPROPERTY(EditDefaultsOnly, Category = "Item|Config", meta = (DisplayName = "Item Slot"), meta = (Bitmask, BitmaskEnum = "ECItemSlot"))
+	UPROPERTY(EditDefaultsOnly, AssetRegistrySearchable, Category = "Item|Config", meta = (DisplayName = "Item Slot"), meta = (Bitmask, BitmaskEnum = "ECItemSlot"))
 	int32 m_ItemSlot = 0;
 
 	/** The category that the item will be displayed under. */
-	UPROPERTY(EditDefaultsOnly, Category = "Item|Config", meta = (DisplayName = "Item Category"))
+	UPROPERTY(EditDefaultsOnly, AssetRegistrySearchable, Category = "Item|Config", meta = (DisplayName = "Item Category"))
 	ECItemCategory m_ItemCategory = ECItemCategory::Ammo;
 
 	/** Rarity data for the item. */
 	UPROPERTY(EditDefaultsOnly, Category = "Item|Config", meta = (DisplayName = "Rarity"))
 	FCItemRarityData m_Rarity[ECItemRarity::MAX];
 
+	/** How much health the item loses per second while it's in an inventory. */
+	UPROPERTY(EditDefaultsOnly, Category = "Item|Durability", meta = (DisplayName = "Durability Loss Per Second", ClampMin = "0"))
+	float m_DurabilityLossPerSecond = 0.0f;
+
+	/** How much health the item loses every time it's used. */
+	UPROPERTY(EditDefaultsOnly, Category = "Item|Durability", meta = (DisplayName = "Durability Loss Per Use", ClampMin = "0"))
+	float m_DurabilityLossPerUse = 0.0f;
+
 	/** The actor that's spawned into the world. */
-	UPROPERTY(EditDefaultsOnly, Category = "World|Config", meta = (DisplayName = "Pickup Class"))
+	UPROPERTY(EditDefaultsOnly, AssetRegistrySearchable, Category = "World|Config", meta = (DisplayName = "Pickup Class"))
 	TSoftClassPtr<ACItemActor> m_PickupClass;
 
 private:
+	friend class FCAuditLog;
+	friend class FCItemValuation;
+	friend struct FCItemDescriptorSummary;
+
+	/** The row of the descriptor in FCItemValuation. */
+	mutable int32 m_ValuationRow = INDEX_NONE;
+
+	/** The id of the descriptor in FCAuditLog, worked out the first time it's recorded. */
+	mutable uint32 m_AuditId = 0;
+};
+
+/**
+ * The part of a descriptor that's checked by validation, read either from the descriptor or from its asset registry tags so the asset doesn't have to be loaded.
+ */
+struct UNREALINVENTORY_API FCItemDescriptorSummary
+{
+	int32 StackSize = 1;
+	int32 ItemSlot = 0;
+	bool bHasPickupClass = false;
+	FIntPoint ScoreRanges[static_cast<int32>(ECItemRarity::MAX)];
+	float Weights[static_cast<int32>(ECItemRarity::MAX)] = {};
+
+	/** Tags for the rarity data, the rest come from AssetRegistrySearchable properties. */
+	static const FName ScoreRangesTag;
+	static const FName WeightsTag;
+
+	explicit FCItemDescriptorSummary(const UCItemDescriptorBase& ItemDescriptor);
+	FCItemDescriptorSummary() = default;
+
+	/** False if a tag is missing, such as for assets that haven't been saved since the tags were added. */
+	bool Read(const FAssetData& AssetData);
+
+	/** Every problem with the data, one line each. */
+	void Validate(TArray<FText>& OutErrors) const;
+
+	/** The summary as tag values, the inverse of Read. */
+	FString GetScoreRangesTag() const;
+	FString GetWeightsTag() const;
 };
 
 UCLASS(BlueprintType)
@@ -203,14 +269,26 @@ struct FCItem
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item", meta = (DisplayName = "Quantity"))
 	int32 Quantity = 1;
 
-	/** How much health does this item in the slot have? */
+	/** How much health does this item in the slot have? This is the health at HealthTimestamp, use GetHealth for the current health. */
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item", meta = (DisplayName = "Health"))
 	float Health = -1.0f;
 
+	/** Server time Health was last written, the item decays from here on. Negative if the item hasn't been in an inventory yet. */
+	UPROPERTY(BlueprintReadOnly, Category = "Item")
+	float HealthTimestamp = -1.0f;
+
+	/** Damage that hasn't been applied to Health yet because it didn't change the health group. Server only. */
+	UPROPERTY(NotReplicated)
+	float PendingWear = 0.0f;
+
 	/** The current score of the item. */
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item", meta = (DisplayName = "Score"))
 	int32 Score = INDEX_NONE;
 
+	/** The seed the score was generated from, 0 if the score was set by hand. Only the seed is replicated and clients regenerate the score. */
+	UPROPERTY(BlueprintReadOnly, Category = "Item")
+	int32 Seed = 0;
+
 	/** The rarity of the item. */
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item", meta = (DisplayName = "Rarity"))
 	ECItemRarity Rarity = ECItemRarity::Common;
@@ -229,6 +307,16 @@ struct FCItem
 		return ItemDescriptor == Other.ItemDescriptor && Quantity == Other.Quantity && Health == Other.Health && Score == Other.Score && Rarity == Other.Rarity;
 	}
 
+	/** Only compares what's replicated so server only state such as PendingWear doesn't cause the item to be sent again. */
+	bool IsNetIdentical(const FCItem& Other) const
+	{
+		return IsIdentical(Other) && HealthTimestamp == Other.HealthTimestamp && Seed == Other.Seed;
+	}
+
+	bool Identical(const FCItem* Other, uint32 PortFlags) const;
+
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+
 	// #TRDWLL: make some additional constructors such as (asset, actor), (asset, actor, quantity), etc
 
 	void SetQuantity(const int32 NewQuantity)
@@ -249,13 +337,53 @@ struct FCItem
 		return ItemDescriptor->GetRarityData(Rarity).Weight * Quantity;
 	}
 
+	/** The health of the item at the given server time. */
+	float GetHealth(const float ServerTime) const
+	{
+		if (Health < 0.0f || ItemDescriptor == nullptr)
+		{
+			return Health;
+		}
+
+		const float Decay = HealthTimestamp >= 0.0f ? ItemDescriptor->GetDurabilityLossPerSecond() * FMath::Max(0.0f, ServerTime - HealthTimestamp) : 0.0f;
+		return FMath::Max(0.0f, Health - Decay - PendingWear);
+	}
+
+	/** Write the current health back into Health. */
+	void CommitHealth(const float ServerTime)
+	{
+		Health = GetHealth(ServerTime);
+		HealthTimestamp = ServerTime;
+		PendingWear = 0.0f;
+	}
+
+	/** Generate a score from a random seed if the item doesn't have one yet, the item can be regenerated from Seed. */
 	void GenerateScore()
 	{
 		if (Score == INDEX_NONE)
 		{
-			const FIntPoint& DefaultScore = ItemDescriptor->GetRarityData(Rarity).ScoreRange;
-			Score = FMath::RandRange(DefaultScore.X, DefaultScore.Y);
+			GenerateScore(UnrealInventory::Random::NewSeed());
+		}
+	}
+
+	/** Generate the score from a seed, the same seed, descriptor and rarity always give the same score. */
+	void GenerateScore(const uint32 InSeed)
+	{
+		// 0 is reserved for scores that were set by hand
+		Seed = static_cast<int32>(InSeed != 0 ? InSeed : 1u);
+		Score = GetSeededScore();
+	}
+
+	/** The score Seed gives with the current rarity and score range, which no longer matches Score if either changed after it was generated. */
+	int32 GetSeededScore() const
+	{
+		if (ItemDescriptor == nullptr || Seed == 0)
+		{
+			return INDEX_NONE;
 		}
+
+		const FIntPoint& DefaultScore = ItemDescriptor->GetRarityData(Rarity).ScoreRange;
+		return UnrealInventory::Random::RandRange(static_cast<uint32>(Seed), DefaultScore.X, DefaultScore.Y);
 	}
 
 	bool IsItemValid() const
@@ -268,7 +396,10 @@ struct FCItem
 		ItemDescriptor = nullptr;
 		Quantity = 0;
 		Health = -1.0f;
+		HealthTimestamp = -1.0f;
+		PendingWear = 0.0f;
 		Score = INDEX_NONE;
+		Seed = 0;
 		Rarity = ECItemRarity::Common;
 	}
 
@@ -295,6 +426,16 @@ struct FCItem
 	*/
 };
 
+template <>
+struct TStructOpsTypeTraits<FCItem> : public TStructOpsTypeTraitsBase2<FCItem>
+{
+	enum
+	{
+		WithIdentical = true,
+		WithNetSerializer = true,
+	};
+};
+
 UCLASS()
 class UCItemStatics : public UObject
 {
@@ -306,6 +447,17 @@ public:
 		return Item.IsItemValid();
 	}
 
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|ItemStatics")
+	static ECItemHealthGroup GetHealthGroup(const float Health)
+	{
+		const float Percent = FMath::Clamp(Health / UnrealInventory::Items::MaxHealth, 0.0f, 1.0f);
+		return Percent > 0.75f ? ECItemHealthGroup::Full : Percent > 0.5f ? ECItemHealthGroup::ThreeQuarter : Percent > 0.25f ? ECItemHealthGroup::TwoQuarter : ECItemHealthGroup::OneQuarter;
+	}
+
+	/** Server world time in seconds, the same on the server and clients. */
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|ItemStatics", meta = (WorldContext = "WorldContextObject"))
+	static float GetServerTime(const UObject* WorldContextObject);
+
 	UFUNCTION(BlueprintPure, Category = "UnrealInventory|ItemStatics")
 	static FLinearColor GetRarityColor(const ECItemRarity Rarity)
 	{
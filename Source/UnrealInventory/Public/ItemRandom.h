@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <CoreMinimal.h>
+
+struct FCItem;
+
+namespace UnrealInventory
+{
+	/**
+	 * Counter based random numbers. The same (seed, index) always gives the same number on every machine and
+	 * no state is shared, so items can be regenerated anywhere and in any order, including in parallel.
+	 */
+	namespace Random
+	{
+		/** Mix a seed and an index into a well distributed 32 bit value. */
+		inline uint32 Hash(const uint32 Seed, const uint32 Index)
+		{
+			uint64 Value = (static_cast<uint64>(Seed) << 32) | Index;
+			Value ^= Value >> 33;
+			Value *= 0xff51afd7ed558ccdULL;
+			Value ^= Value >> 33;
+			Value *= 0xc4ceb9fe1a85ec53ULL;
+			Value ^= Value >> 33;
+			return static_cast<uint32>(Value);
+		}
+
+		/** Map a hash into [Min, Max] without a modulo bias worth caring about. */
+		inline int32 RandRange(const uint32 HashValue, const int32 Min, const int32 Max)
+		{
+			if (Max <= Min)
+			{
+				return Min;
+			}
+
+			const uint64 Range = static_cast<uint64>(static_cast<int64>(Max) - Min + 1);
+			return Min + static_cast<int32>((static_cast<uint64>(HashValue) * Range) >> 32);
+		}
+
+		/** A new non zero 32 bit seed for things that don't have to be reproducible, unlike FMath::Rand which is only 15 bits on some platforms. Thread safe. */
+		UNREALINVENTORY_API uint32 NewSeed();
+
+		/** Give every item in the batch that doesn't stack a score, item i uses the seed Hash(Seed, FirstIndex + i). Large batches are generated in parallel. */
+		UNREALINVENTORY_API void GenerateScores(TArrayView<FCItem> Items, const uint32 Seed, const uint32 FirstIndex = 0);
+	};
+};
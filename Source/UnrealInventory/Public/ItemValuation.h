@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "InventoryConstants.h"
+#include "ItemDataAsset.h"
+
+#include <CoreMinimal.h>
+
+/**
+ * Flat table of what one unit of every (descriptor, rarity, health group) is worth, so valuing an item is a single indexed load instead of a walk through the descriptor.
+ * Descriptors fill in their row when they're loaded and refresh it when they're edited, a descriptor that isn't in the table yet is added the first time it's valued.
+ * Only use it from the game thread, the batch functions spread large batches over worker threads themselves.
+ */
+class UNREALINVENTORY_API FCItemValuation
+{
+public:
+	static FCItemValuation& Get();
+
+	/** Fill in or refresh the row of the descriptor. */
+	void Register(const UCItemDescriptorBase* ItemDescriptor);
+	void Unregister(const UCItemDescriptorBase* ItemDescriptor);
+
+	float GetUnitValue(const UCItemDescriptorBase* ItemDescriptor, const ECItemRarity Rarity, const ECItemHealthGroup HealthGroup);
+
+	/** What the whole stack is worth at the health it was last written with. */
+	float GetValue(const FCItem& Item) { return GetValue(Item, Item.Health); }
+
+	/** What the whole stack is worth at the given health, such as the current health from FCItem::GetHealth. */
+	float GetValue(const FCItem& Item, const float Health);
+
+	/** Value every stack at the health it was last written with, OutValues has to be at least as large as Items. */
+	void GetValues(TArrayView<const FCItem> Items, TArrayView<float> OutValues);
+
+	double GetTotalValue(TArrayView<const FCItem> Items);
+
+	/** Same as UCItemStatics::GetHealthGroup without the branches, items without durability are always in the full group. */
+	static int32 GetHealthGroupIndex(const float Health)
+	{
+		if (Health < 0.0f)
+		{
+			return static_cast<int32>(ECItemHealthGroup::Full);
+		}
+
+		const float Percent = FMath::Clamp(Health / UnrealInventory::Items::MaxHealth, 0.0f, 1.0f);
+		return FMath::Clamp(FMath::CeilToInt(Percent * 4.0f) - 1, 0, static_cast<int32>(ECItemHealthGroup::MAX) - 1);
+	}
+
+private:
+	static constexpr int32 RarityStride = static_cast<int32>(ECItemHealthGroup::MAX);
+	static constexpr int32 RowStride = static_cast<int32>(ECItemRarity::MAX) * RarityStride;
+
+	/** The row of the descriptor, added if it doesn't have one yet. */
+	int32 GetRow(const UCItemDescriptorBase* ItemDescriptor);
+
+	/** Value of a stack whose row is known to exist, safe to call from worker threads while nothing is registered. */
+	float GetValueFromRow(const FCItem& Item) const
+	{
+		const int32 Row = Item.ItemDescriptor != nullptr ? Item.ItemDescriptor->m_ValuationRow : INDEX_NONE;
+		return Row != INDEX_NONE ? m_Values[Row * RowStride + static_cast<int32>(Item.Rarity) * RarityStride + GetHealthGroupIndex(Item.Health)] * Item.Quantity : 0.0f;
+	}
+
+	TArray<float> m_Values;
+
+	/** Rows of descriptors that were unloaded, reused before the table grows. */
+	TArray<int32> m_FreeRows;
+};
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ItemDataAsset.h"
+
+#include <CoreMinimal.h>
+#include <GameFramework/Actor.h>
+
+#include "LootBag.generated.h"
+
+class UCInventoryComponent;
+class UCLootTable;
+class UCStorageComponent;
+
+/**
+ * A single pickup holding a whole batch of loot, such as a death pile or a mob drop, instead of one ACItemActor per item.
+ */
+UCLASS()
+class UNREALINVENTORY_API ACLootBagActor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ACLootBagActor();
+
+	/** Generate loot from the table into the bag. */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Loot")
+	void GenerateLoot(const UCLootTable* LootTable, const int32 Seed);
+
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Loot")
+	bool AddLoot(const TArray<FCItem>& Items);
+
+	/** Move everything that fits into the looters inventory, the bag is destroyed once it's empty. */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Loot")
+	int32 TakeAll(UCInventoryComponent* Looter);
+
+	/** Move the most valuable items that fit into the looters inventory, see UCInventoryComponent::TakeBestFrom. */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Loot")
+	int32 TakeBest(UCInventoryComponent* Looter);
+
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|Loot")
+	UCStorageComponent* GetStorage() const { return m_Storage; }
+
+protected:
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "UnrealInventory|Loot", meta = (DisplayName = "Storage"))
+	UCStorageComponent* m_Storage = nullptr;
+};
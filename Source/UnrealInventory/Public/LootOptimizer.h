@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <CoreMinimal.h>
+
+struct FCItem;
+
+/** How much of a candidate stack to take. */
+struct FCLootPick
+{
+	int32 Index = INDEX_NONE;
+	int32 Quantity = 0;
+};
+
+namespace UnrealInventory
+{
+	namespace Loot
+	{
+		/** How many choices around the point the greedy pass gets stuck at are solved exactly. */
+		static constexpr int32 CoreSize = 32;
+
+		/** How finely the remaining weight is split up for the exact pass, weights are rounded up so the result always fits. */
+		static constexpr int32 WeightBuckets = 256;
+
+		/**
+		 * Pick the most valuable part of Candidates that still fits into an inventory holding Inventory, partial stacks included.
+		 * Stackable items fill the free room of the stacks already in the inventory before they need a slot of their own, the same as AddItem.
+		 * Everything is sorted by value per weight and slot and taken greedily, the choices around where the greedy pass first runs out of room are then solved exactly.
+		 * @param RemainingWeight How much more weight the inventory can hold, TNumericLimits<float>::Max() for no limit.
+		 * @param RemainingSlots How many more stacks the inventory can hold.
+		 * @return The total value of the picks.
+		 */
+		UNREALINVENTORY_API float SelectBestLoot(TArrayView<const FCItem> Inventory, TArrayView<const FCItem> Candidates, const float RemainingWeight, const int32 RemainingSlots, const float ServerTime, TArray<FCLootPick>& OutPicks);
+	};
+};
@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ItemDataAsset.h"
+
+#include <CoreMinimal.h>
+#include <Engine/DataAsset.h>
+
+#include <atomic>
+
+#include "LootTable.generated.h"
+
+class UCLootTable;
+
+/**
+ * Walker's alias table, O(n) to build and O(1) to sample a weighted index.
+ */
+struct UNREALINVENTORY_API FCAliasTable
+{
+	void Build(TArrayView<const float> Weights);
+
+	int32 Sample(const FRandomStream& Stream) const;
+
+	bool IsValid() const { return m_Probabilities.Num() > 0; }
+	int32 Num() const { return m_Probabilities.Num(); }
+
+private:
+	TArray<float> m_Probabilities;
+	TArray<int32> m_Aliases;
+};
+
+USTRUCT(BlueprintType)
+struct FCLootEntry
+{
+	GENERATED_BODY()
+
+	/** The item that drops, ignored if NestedTable is set. */
+	UPROPERTY(EditDefaultsOnly, Category = "Loot", meta = (DisplayName = "Item Descriptor"))
+	UCItemDescriptorBase* ItemDescriptor = nullptr;
+
+	/** Roll on another table instead of dropping an item. */
+	UPROPERTY(EditDefaultsOnly, Category = "Loot", meta = (DisplayName = "Nested Table"))
+	UCLootTable* NestedTable = nullptr;
+
+	/** How likely this entry is compared to the other entries in the table. */
+	UPROPERTY(EditDefaultsOnly, Category = "Loot", meta = (DisplayName = "Weight", ClampMin = "0"))
+	float Weight = 1.0f;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Loot", meta = (DisplayName = "Quantity Range"))
+	FIntPoint QuantityRange = FIntPoint(1, 1);
+
+	/** How likely each rarity is, if they're all 0 the item is always common. */
+	UPROPERTY(EditDefaultsOnly, Category = "Loot", meta = (DisplayName = "Rarity Weights"))
+	float RarityWeights[ECItemRarity::MAX] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+};
+
+/**
+ * A weighted table of items that can be rolled to generate loot for chests, mobs and world drops.
+ */
+UCLASS(BlueprintType)
+class UNREALINVENTORY_API UCLootTable : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	/** Generate a batch of loot, the same seed always generates the same loot including the scores. */
+	UFUNCTION(BlueprintCallable, Category = "Inventory|Loot")
+	void GenerateLoot(const int32 Seed, TArray<FCItem>& OutItems) const;
+
+	/** Generate the guaranteed entries and a random amount of rolls, appending to OutItems. */
+	void GenerateLoot(const FRandomStream& Stream, TArray<FCItem>& OutItems) const;
+
+	/** Roll the table once, appending the result to OutItems. */
+	void Roll(const FRandomStream& Stream, TArray<FCItem>& OutItems) const;
+
+	/** Rebuild the alias tables, only needed if the entries are changed at runtime. Don't call it while loot is being generated from the table. */
+	void BuildAliasTables() const;
+
+	virtual void PostLoad() override;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+protected:
+	/** Entries that always drop. */
+	UPROPERTY(EditDefaultsOnly, Category = "Loot|Config", meta = (DisplayName = "Guaranteed Entries"))
+	TArray<FCLootEntry> m_GuaranteedEntries;
+
+	/** Entries that are picked from by weight on every roll. */
+	UPROPERTY(EditDefaultsOnly, Category = "Loot|Config", meta = (DisplayName = "Entries"))
+	TArray<FCLootEntry> m_Entries;
+
+	/** How many times the entries are rolled. */
+	UPROPERTY(EditDefaultsOnly, Category = "Loot|Config", meta = (DisplayName = "Roll Count"))
+	FIntPoint m_RollCount = FIntPoint(1, 1);
+
+private:
+	void GenerateEntry(const FCLootEntry& Entry, const int32 EntryIndex, const bool bGuaranteed, const FRandomStream& Stream, TArray<FCItem>& OutItems, const int32 Depth) const;
+	void GenerateLootInternal(const FRandomStream& Stream, TArray<FCItem>& OutItems, const int32 Depth) const;
+	void RollInternal(const FRandomStream& Stream, TArray<FCItem>& OutItems, const int32 Depth) const;
+
+	/** Build the alias tables of a table that wasn't loaded, such as one created at runtime. Safe to call from several threads at once. */
+	void EnsureAliasTablesBuilt() const;
+
+	mutable FCAliasTable m_EntryTable;
+
+	/** One rarity table per entry, guaranteed entries first. */
+	mutable TArray<FCAliasTable> m_RarityTables;
+
+	mutable FCriticalSection m_AliasTablesLock;
+	mutable std::atomic<bool> m_bAliasTablesBuilt{false};
+};
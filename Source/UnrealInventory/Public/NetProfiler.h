@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <CoreMinimal.h>
+#include <UObject/CoreNet.h>
+#include <UObject/StrongObjectPtr.h>
+
+#include "NetProfiler.generated.h"
+
+struct FCItem;
+
+namespace UnrealInventory
+{
+	namespace Net
+	{
+		/** Rough cost of the array size a replicated array sends when its length changes. */
+		static constexpr int32 ArrayHeaderBits = 32;
+
+		/** Rough cost of the handle that's sent in front of every changed property or array element. */
+		static constexpr int32 ElementHeaderBits = 16;
+
+		/** Whether UnrealInventory.Net.ValidatePushModel is on, properties are then hashed every net update to catch changes that weren't marked dirty. */
+		UNREALINVENTORY_API bool ShouldValidatePushModel();
+
+		/** Hash of everything that's replicated for the items. */
+		UNREALINVENTORY_API uint32 GetReplicatedHash(TArrayView<const FCItem> Items);
+	};
+};
+
+/** Replication totals for one property. */
+struct FCNetPropertyStats
+{
+	/** Bits sent to every connection combined. */
+	int64 Bits = 0;
+	int64 Sends = 0;
+
+	int64 Compares = 0;
+
+	/** Compares that were done for nothing because the property hadn't changed. */
+	int64 UnchangedCompares = 0;
+
+	uint64 CompareCycles = 0;
+};
+
+class UCNetProfilerPackageMap;
+
+/**
+ * Measures what the inventory costs to replicate, does nothing unless UnrealInventory.Net.Profile is 1.
+ * Property rows are estimated by diffing against what was sent on the last net update and measuring the real size of every changed item,
+ * the FCItem rows count every NetSerialize and Identical call the engine actually makes.
+ * UnrealInventory.Net.ProfileDump writes the totals to a CSV or JSON that can be diffed between builds.
+ */
+class UNREALINVENTORY_API FCNetProfiler
+{
+public:
+	static FCNetProfiler& Get();
+
+	static bool IsEnabled();
+
+	/** Record one net update of a property, Bits is 0 if nothing changed. Connections is how many connections the change is sent to. */
+	void RecordProperty(const FName Owner, const FName Property, const int64 Bits, const uint64 CompareCycles, const int32 Connections = 1);
+
+	/** Diff the items against what was sent last time, record the estimated cost and update Shadow to match. */
+	int64 ProfileItems(const FName Owner, const FName Property, TArrayView<const FCItem> Items, TArray<FCItem>& Shadow, const bool bDynamicArray, const int32 Connections = 1);
+
+	/** How many bits the item takes on the wire. */
+	int64 MeasureItemBits(const FCItem& Item);
+
+	/** Record an item being sent, it's measured on a writer of the profiler's own since the archive it was sent with can be anything. */
+	void RecordItemSerialize(const FCItem& Item);
+	void RecordItemCompare(const bool bIdentical, const uint64 Cycles);
+
+	/** Keep track of how many clients are connected so the totals can be split per connection. */
+	void SampleConnections(const int32 Connections);
+
+	void Reset();
+
+	bool Write(const FString& Path, const bool bJson) const;
+
+	/** Let go of the package map used for measuring while the object system is still around, nothing is measured afterwards. */
+	void Shutdown();
+
+private:
+	FCNetPropertyStats& FindOrAddStats(const FName Owner, const FName Property);
+
+	mutable FCriticalSection m_Lock;
+
+	TMap<TPair<FName, FName>, FCNetPropertyStats> m_Stats;
+
+	double m_StartTime = 0.0;
+	double m_LastRecordTime = 0.0;
+	int32 m_MaxConnections = 0;
+
+	/** Set while an item is measured so it isn't counted as a real send. */
+	bool m_bMeasuring = false;
+
+	/** Created the first time an item is measured, released by Shutdown. */
+	TStrongObjectPtr<UCNetProfilerPackageMap> m_PackageMap;
+	bool m_bShutdown = false;
+};
+
+/**
+ * Only used to measure the size of items, objects are written as a packed id the same way a NetGUID would be.
+ */
+UCLASS(Transient)
+class UNREALINVENTORY_API UCNetProfilerPackageMap : public UPackageMap
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool SerializeObject(FArchive& Ar, UClass* InClass, UObject*& Obj, FNetworkGUID* OutNetGUID = nullptr) override;
+
+private:
+	TMap<UObject*, uint32> m_ObjectIds;
+};
@@ -0,0 +1,177 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ItemDataAsset.h"
+
+#include <CoreMinimal.h>
+#include <Subsystems/WorldSubsystem.h>
+
+#include "PickupSubsystem.generated.h"
+
+class ACItemActor;
+class UCInventoryComponent;
+class UCStorageComponent;
+
+/** Spawns a pickup as something other than an ACItemActor, returns false to spawn an actor instead. */
+DECLARE_DELEGATE_RetVal_ThreeParams(bool, FCSpawnPickupOverride, const FCItem& /* Item */, const int32 /* Quantity */, const FTransform& /* Transform */);
+
+USTRUCT(BlueprintType)
+struct FCDormancyStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory")
+	int32 Pickups = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory")
+	int32 DormantPickups = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory")
+	int32 Storages = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "UnrealInventory")
+	int32 DormantStorages = 0;
+};
+
+/**
+ * Keeps track of every pickup and storage in the world on the server and despawns pickups once they expire.
+ * Pickups are kept in expiry buckets instead of having a timer each, so a frame only costs as much as the pickups that expire during it,
+ * and despawns are spread over frames so a mass expiry doesn't hitch.
+ * Pickups are also kept in a grid of cells so finding the ones around a location only looks at the cells nearby, no matter how many pickups the world has.
+ * The lifetimes are configured in the game ini under [/Script/UnrealInventory.CPickupSubsystem].
+ */
+UCLASS(Config = Game)
+class UNREALINVENTORY_API UCPickupSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	void RegisterPickup(ACItemActor* Pickup);
+	void UnregisterPickup(ACItemActor* Pickup);
+
+	/** Spawn a pickup for the item through the override if there is one, otherwise as an ACItemActor. */
+	bool SpawnPickup(const FCItem& Item, const int32 Quantity, const FTransform& Transform);
+
+	/** Used by UnrealInventoryMass to keep pickups as Mass entities until a player comes close. */
+	void SetSpawnPickupOverride(const FCSpawnPickupOverride& Override) { m_SpawnPickupOverride = Override; }
+	void ClearSpawnPickupOverride() { m_SpawnPickupOverride.Unbind(); }
+
+	void RegisterStorage(UCStorageComponent* Storage);
+	void UnregisterStorage(UCStorageComponent* Storage);
+
+	/** How many pickups and storages there are and how many of them are dormant, the net driver skips dormant actors entirely. */
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|Pickups")
+	FCDormancyStats GetDormancyStats() const;
+
+	/** How long a pickup of the item lives for in seconds, 0 if it never expires. */
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|Pickups")
+	float GetPickupLifetime(const UCItemDescriptorBase* ItemDescriptor, const ECItemRarity Rarity) const;
+
+	/** Every pickup within Radius of the location, in no particular order. */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Pickups")
+	void GetPickupsInRadius(const FVector& Location, const float Radius, TArray<ACItemActor*>& OutPickups) const;
+
+	/** The closest Count pickups of the item within MaxDistance of the location, closest first. */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Pickups")
+	void FindNearestPickupsByDescriptor(const FVector& Location, const UCItemDescriptorBase* ItemDescriptor, const int32 Count, const float MaxDistance, TArray<ACItemActor*>& OutPickups) const;
+
+	/** The closest Count pickups of the category within MaxDistance of the location, closest first. */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Pickups")
+	void FindNearestPickupsByCategory(const FVector& Location, const ECItemCategory Category, const int32 Count, const float MaxDistance, TArray<ACItemActor*>& OutPickups) const;
+
+	/**
+	 * Add every pickup within Radius of the location to the inventory in one batch, the closest pickups are taken first.
+	 * Whatever doesn't fit is left in the pickups furthest away.
+	 * @return How many pickups were looted completely.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "UnrealInventory|Pickups")
+	int32 LootPickupsInRadius(UCInventoryComponent* Inventory, const FVector& Location, const float Radius);
+
+	/** Move the pickup to the cell it's in now, called whenever the pickup moves. */
+	void UpdatePickupCell(ACItemActor* Pickup);
+
+	int32 GetPickupCount() const { return m_Pickups.Num(); }
+	int32 GetPendingDespawnCount() const { return m_PendingDespawnCount; }
+
+	/** The same limits apply to the pickups UnrealInventoryMass keeps as entities. */
+	int32 GetMaxPickups() const { return m_MaxPickups; }
+	float GetExpiryBucketSize() const { return m_ExpiryBucketSize; }
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual bool IsTickable() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(EWorldType::Type WorldType) const override;
+
+	/** How long pickups live for if their category isn't in Category Lifetimes, 0 for forever. */
+	UPROPERTY(Config, EditAnywhere, Category = "UnrealInventory|Config", meta = (DisplayName = "Default Lifetime"))
+	float m_DefaultLifetime = 300.0f;
+
+	UPROPERTY(Config, EditAnywhere, Category = "UnrealInventory|Config", meta = (DisplayName = "Category Lifetimes"))
+	TMap<ECItemCategory, float> m_CategoryLifetimes;
+
+	/** Rarer items stay around longer. */
+	UPROPERTY(Config, EditAnywhere, Category = "UnrealInventory|Config", meta = (DisplayName = "Rarity Lifetime Multipliers"))
+	float m_RarityLifetimeMultipliers[ECItemRarity::MAX] = {1.0f, 1.0f, 2.0f, 4.0f, 8.0f};
+
+	/** The most pickups the world can have, the oldest are despawned first once there are more. 0 for no limit. */
+	UPROPERTY(Config, EditAnywhere, Category = "UnrealInventory|Config", meta = (DisplayName = "Max Pickups"))
+	int32 m_MaxPickups = 5000;
+
+	UPROPERTY(Config, EditAnywhere, Category = "UnrealInventory|Config", meta = (DisplayName = "Max Despawns Per Frame", ClampMin = "1"))
+	int32 m_MaxDespawnsPerFrame = 32;
+
+	/** Pickups that expire within the same bucket are despawned together. */
+	UPROPERTY(Config, EditAnywhere, Category = "UnrealInventory|Config", meta = (DisplayName = "Expiry Bucket Size", ClampMin = "0.1"))
+	float m_ExpiryBucketSize = 1.0f;
+
+	/** Roughly the radius most queries use, smaller cells look at fewer pickups but more cells. */
+	UPROPERTY(Config, EditAnywhere, Category = "UnrealInventory|Config", meta = (DisplayName = "Spatial Cell Size", ClampMin = "100.0"))
+	float m_SpatialCellSize = 1000.0f;
+
+private:
+	/** Queue the pickup to be despawned over the next frames. */
+	void QueueDespawn(ACItemActor* Pickup);
+
+	/** Queue the oldest pickups while there are more than m_MaxPickups. */
+	void EnforcePickupCap();
+
+	int32 GetBucket(const float Time) const { return FMath::FloorToInt(Time / m_ExpiryBucketSize); }
+
+	/** Cells only cover X and Y, pickups are hardly ever stacked on top of each other. */
+	FIntPoint GetCell(const FVector& Location) const { return FIntPoint(FMath::FloorToInt(Location.X / m_SpatialCellSize), FMath::FloorToInt(Location.Y / m_SpatialCellSize)); }
+
+	void AddToCell(ACItemActor* Pickup, const FIntPoint& Cell);
+	void RemoveFromCell(ACItemActor* Pickup);
+
+	/** Search outwards ring by ring until the closest pickups that pass the filter are found. */
+	void FindNearestPickups(const FVector& Location, const int32 Count, const float MaxDistance, TFunctionRef<bool(const ACItemActor*)> Filter, TArray<ACItemActor*>& OutPickups) const;
+
+	FCSpawnPickupOverride m_SpawnPickupOverride;
+
+	/** Pickups know their own index so they can be removed without a search. */
+	UPROPERTY()
+	TArray<ACItemActor*> m_Pickups;
+
+	UPROPERTY()
+	TArray<UCStorageComponent*> m_Storages;
+
+	/** Pickups by the cell they're in, pickups know their index in the cell the same way they know it in m_Pickups. */
+	TMap<FIntPoint, TArray<ACItemActor*>> m_PickupCells;
+
+	/** Pickups by the bucket they expire in, entries of pickups that are already gone are skipped when the bucket is due. */
+	TMap<int32, TArray<TWeakObjectPtr<ACItemActor>>> m_ExpiryBuckets;
+	int32 m_NextExpiryBucket = 0;
+
+	/** Every pickup in the order they were spawned in, consumed from m_SpawnOrderHead. */
+	TArray<TWeakObjectPtr<ACItemActor>> m_SpawnOrder;
+	int32 m_SpawnOrderHead = 0;
+
+	TArray<TWeakObjectPtr<ACItemActor>> m_PendingDespawns;
+	int32 m_PendingDespawnHead = 0;
+
+	/** How many registered pickups are waiting to be despawned. */
+	int32 m_PendingDespawnCount = 0;
+};
@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <CoreMinimal.h>
+#include <Subsystems/WorldSubsystem.h>
+
+#include "ProcessingSubsystem.generated.h"
+
+class UCInventoryComponent;
+class UCItemRecipe;
+
+/**
+ * Processes recipes over time for every inventory in the world, such as smelters and workbenches, without any of them having to tick.
+ * Completion times are kept in a min-heap so a frame only costs as much as the crafts that complete during it.
+ */
+UCLASS()
+class UNREALINVENTORY_API UCProcessingSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Start processing a recipe in the inventory. The inputs of each craft are consumed when the craft starts and the outputs are added when it completes.
+	 * @return The id of the job or INDEX_NONE if the inputs for the first craft aren't available.
+	 */
+	int32 StartJob(UCInventoryComponent* Inventory, UCItemRecipe* Recipe, const int32 Count);
+
+	/** Stop processing, the current craft is lost. */
+	void CancelJob(UCInventoryComponent* Inventory, const int32 JobId);
+
+	int32 GetPendingCompletionCount() const { return m_CompletionHeap.Num(); }
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual bool IsTickable() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(EWorldType::Type WorldType) const override;
+
+private:
+	struct FCCompletion
+	{
+		float EndTime = 0.0f;
+		int32 JobId = INDEX_NONE;
+		TWeakObjectPtr<UCInventoryComponent> Inventory;
+
+		bool operator<(const FCCompletion& Other) const { return EndTime < Other.EndTime; }
+	};
+
+	/** Consume the inputs for the next craft of the job and schedule its completion. */
+	bool StartNextCraft(UCInventoryComponent* Inventory, const int32 JobId, const float StartTime);
+
+	TArray<FCCompletion> m_CompletionHeap;
+	int32 m_NextJobId = 0;
+};
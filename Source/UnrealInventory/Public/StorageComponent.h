@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "InventoryComponent.h"
+
+#include <CoreMinimal.h>
+
+#include "StorageComponent.generated.h"
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FCOnStoragePageReceived, int32, Page);
+
+/**
+ * A large inventory shared by multiple players such as a chest, stash or guild bank.
+ * The items are never replicated as a whole, instead viewers subscribe to the pages they're looking at and only those are sent to them.
+ */
+UCLASS(ClassGroup = (UnrealInventory), meta = (BlueprintSpawnableComponent))
+class UNREALINVENTORY_API UCStorageComponent : public UCInventoryComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCStorageComponent();
+
+	/** Subscribe the viewer to a page, the page is sent to the viewer immediately. */
+	bool SubscribePage(UCInventoryComponent* Viewer, const int32 Page);
+	void UnsubscribePage(UCInventoryComponent* Viewer, const int32 Page);
+
+	/** Stop sending any pages to the viewer. */
+	void RemoveViewer(UCInventoryComponent* Viewer);
+
+	/** Move items from the storage into the viewers inventory. PageVersion has to match the current version of the page. */
+	bool TakeItem(UCInventoryComponent* Viewer, const int32 Page, const int32 PageVersion, const int32 IndexInPage, const int32 Quantity);
+
+	/** Move items from the viewers inventory into the storage. */
+	bool DepositItem(UCInventoryComponent* Viewer, const int32 InventoryIndex, const int32 Quantity);
+
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|Storage")
+	int32 GetPageSize() const { return m_PageSize; }
+
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|Storage")
+	int32 GetPageCount() const { return FMath::DivideAndRoundUp(FMath::Max(GetInventory().Num(), 1), m_PageSize); }
+
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|Storage")
+	int32 GetViewerCount() const { return m_Viewers.Num(); }
+
+	/** Get a page that has been received from the server. */
+	UFUNCTION(BlueprintPure, Category = "UnrealInventory|Storage")
+	bool GetReceivedPage(const int32 Page, FCStoragePage& OutPage) const;
+
+	/** Called on the viewing client by the viewers inventory component. */
+	void ReceivePage(const FCStoragePage& Page);
+
+	/** Called on the viewing client when it stops viewing a page, or every page once the storage is closed, so no stale items are handed out. */
+	void DropReceivedPage(const int32 Page);
+	void ClearReceivedPages();
+
+	UPROPERTY(BlueprintAssignable, Category = "UnrealInventory|Events")
+	FCOnStoragePageReceived OnPageReceived;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual bool UsesPagedReplication() const override { return true; }
+	virtual void PostInventoryChange(const FCInventoryChange& Change) override;
+
+	/** How many items are sent to a viewer per page. */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "UnrealInventory|Config", meta = (DisplayName = "Page Size", ClampMin = "1"))
+	int32 m_PageSize = 50;
+
+	/** How many players can view the storage at the same time. */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "UnrealInventory|Config", meta = (DisplayName = "Max Viewers", ClampMin = "1"))
+	int32 m_MaxViewers = 8;
+
+	/** How far away a viewer can be from the storage before they stop receiving pages, 0 for no limit. */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "UnrealInventory|Config", meta = (DisplayName = "Max View Distance"))
+	float m_MaxViewDistance = 1000.0f;
+
+	/** Put the owner to sleep for replication while nobody is viewing the storage. */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "UnrealInventory|Config", meta = (DisplayName = "Dormant When Unviewed"))
+	bool m_bDormantWhenUnviewed = true;
+
+private:
+	struct FCStorageViewer
+	{
+		TSet<int32> Pages;
+	};
+
+	bool IsViewerRelevant(const UCInventoryComponent* Viewer) const;
+	bool IsValidPageIndex(const int32 Page) const;
+	int32 GetPageVersion(const int32 Page) const { return m_PageVersions.IsValidIndex(Page) ? m_PageVersions[Page] : 0; }
+
+	FCStoragePage BuildPage(const int32 Page) const;
+	void MarkPageDirty(const int32 Page);
+	void FlushDirtyPages();
+
+	/** The owner is dormant while there are no viewers. */
+	void UpdateDormancy();
+
+	/** Server only: who is looking at what. */
+	TMap<TWeakObjectPtr<UCInventoryComponent>, FCStorageViewer> m_Viewers;
+	TMap<int32, TArray<TWeakObjectPtr<UCInventoryComponent>>> m_PageSubscribers;
+
+	TArray<int32> m_PageVersions;
+	TSet<int32> m_DirtyPages;
+	bool m_bPageFlushScheduled = false;
+
+	/** Client only: the pages we've received from the server. */
+	TMap<int32, FCStoragePage> m_ReceivedPages;
+};
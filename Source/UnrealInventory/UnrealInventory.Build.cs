@@ -36,6 +36,7 @@ public class UnrealInventory : ModuleRules
 			{
 				"CoreUObject",
 				"Engine",
+				"NetCore",
 				"Slate",
 				"SlateCore",
 				// ... add private dependencies that you statically link with here ...	
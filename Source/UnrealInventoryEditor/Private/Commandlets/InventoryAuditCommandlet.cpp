@@ -0,0 +1,245 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Commandlets/InventoryAuditCommandlet.h"
+
+#include "AuditLog.h"
+#include "InventoryComponent.h"
+#include "ItemDataAsset.h"
+
+#include <HAL/FileManager.h>
+#include <Misc/FileHelper.h>
+#include <Misc/Paths.h>
+
+/**
+ * What to look for, an empty filter matches everything.
+ */
+struct FCAuditFilter
+{
+	FString Owner;
+	FString Item;
+	uint64 Transaction = 0;
+	ECAuditOp Op = ECAuditOp::MAX;
+
+	bool Matches(const FCAuditRecord& Record, const TMap<uint32, FString>& Names) const
+	{
+		const auto MatchesName = [&Names](const uint32 Id, const FString& Filter)
+		{
+			if (Filter.IsEmpty())
+			{
+				return true;
+			}
+
+			const FString* Name = Names.Find(Id);
+			return (Name != nullptr && Name->Contains(Filter)) || FString::Printf(TEXT("%08x"), Id) == Filter;
+		};
+
+		return (Transaction == 0 || Record.Transaction == Transaction) && (Op == ECAuditOp::MAX || Record.Op == Op) && MatchesName(Record.Owner, Owner) && MatchesName(Record.ItemDescriptor, Item);
+	}
+};
+
+static FString GetName(const TMap<uint32, FString>& Names, const uint32 Id)
+{
+	const FString* Name = Names.Find(Id);
+	return Name != nullptr ? *Name : FString::Printf(TEXT("%08x"), Id);
+}
+
+template <typename EnumType>
+static FString GetEnumName(const uint8 Value)
+{
+	return StaticEnum<EnumType>()->GetNameStringByValue(Value);
+}
+
+/** Ids are only unique within a session, every audit file of a session is named <Session>-<Index>.audit and shares <Session>.names. */
+static void LoadNames(const FString& Directory, const FString& Session, TMap<uint32, FString>& OutNames)
+{
+	TArray<FString> Lines;
+	FFileHelper::LoadFileToStringArray(Lines, *(Directory / (Session + UnrealInventory::Audit::NamesExtension)));
+
+	for (const FString& Line : Lines)
+	{
+		FString Id;
+		FString Name;
+		if (Line.Split(TEXT("\t"), &Id, &Name))
+		{
+			OutNames.Add(FParse::HexNumber(*Id), Name);
+		}
+	}
+}
+
+static FString GetSession(const FString& File)
+{
+	FString Session = FPaths::GetBaseFilename(File);
+
+	int32 IndexStart = INDEX_NONE;
+	if (Session.FindLastChar(TEXT('-'), IndexStart))
+	{
+		Session.LeftInline(IndexStart);
+	}
+
+	return Session;
+}
+
+/** Read every record of the file, a record that was only partly written when the server went down is skipped. */
+static bool LoadRecords(const FString& Path, FCAuditFileHeader& OutHeader, TArray<FCAuditRecord>& OutRecords)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *Path) || Bytes.Num() < static_cast<int32>(sizeof(FCAuditFileHeader)))
+	{
+		return false;
+	}
+
+	FMemory::Memcpy(&OutHeader, Bytes.GetData(), sizeof(FCAuditFileHeader));
+	if (OutHeader.Magic != UnrealInventory::Audit::FileMagic || OutHeader.Version != UnrealInventory::Audit::FileVersion || OutHeader.RecordSize != sizeof(FCAuditRecord))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s isn't an audit file this build can read"), *Path);
+		return false;
+	}
+
+	const int32 Count = (Bytes.Num() - sizeof(FCAuditFileHeader)) / sizeof(FCAuditRecord);
+	OutRecords.SetNumUninitialized(Count);
+	FMemory::Memcpy(OutRecords.GetData(), Bytes.GetData() + sizeof(FCAuditFileHeader), Count * sizeof(FCAuditRecord));
+
+	return true;
+}
+
+UCInventoryAuditCommandlet::UCInventoryAuditCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+	ShowErrorCount = true;
+}
+
+int32 UCInventoryAuditCommandlet::Main(const FString& Params)
+{
+	FString Path = FPaths::ProjectSavedDir() / TEXT("Audit");
+	FParse::Value(*Params, TEXT("Path="), Path);
+
+	FCAuditFilter Filter;
+	FParse::Value(*Params, TEXT("Owner="), Filter.Owner);
+	FParse::Value(*Params, TEXT("Item="), Filter.Item);
+	FParse::Value(*Params, TEXT("Transaction="), Filter.Transaction);
+
+	FString OpName;
+	if (FParse::Value(*Params, TEXT("Op="), OpName))
+	{
+		for (uint8 i = 0; i < static_cast<uint8>(ECAuditOp::MAX); ++i)
+		{
+			if (OpName == LexToString(static_cast<ECAuditOp>(i)))
+			{
+				Filter.Op = static_cast<ECAuditOp>(i);
+			}
+		}
+
+		if (Filter.Op == ECAuditOp::MAX)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Unknown op %s"), *OpName);
+			return 1;
+		}
+	}
+
+	int32 MaxPrinted = 1000;
+	FParse::Value(*Params, TEXT("Max="), MaxPrinted);
+
+	FString CsvPath;
+	FParse::Value(*Params, TEXT("Csv="), CsvPath);
+
+	const bool bSummary = FParse::Param(*Params, TEXT("Summary"));
+
+	// Either a single file or every file in a directory, the file names start with the date so sorting them puts them in order
+	TArray<FString> Files;
+	FString Directory = Path;
+	if (Path.EndsWith(UnrealInventory::Audit::FileExtension))
+	{
+		Directory = FPaths::GetPath(Path);
+		Files.Add(FPaths::GetCleanFilename(Path));
+	}
+	else
+	{
+		IFileManager::Get().FindFiles(Files, *(Directory / (FString(TEXT("*")) + UnrealInventory::Audit::FileExtension)), true, false);
+		Files.Sort();
+	}
+
+	TMap<FString, TMap<uint32, FString>> SessionNames;
+
+	FString Csv = TEXT("Time,Transaction,Op,Owner,Change,Slot,Item,Rarity,QuantityDelta\n");
+	TMap<TPair<FString, ECAuditOp>, int64> NetQuantities;
+
+	int64 TotalRecords = 0;
+	int64 MatchedRecords = 0;
+	int32 ReadFiles = 0;
+
+	for (const FString& File : Files)
+	{
+		FCAuditFileHeader Header;
+		TArray<FCAuditRecord> Records;
+		if (!LoadRecords(Directory / File, Header, Records))
+		{
+			continue;
+		}
+
+		++ReadFiles;
+		TotalRecords += Records.Num();
+
+		const FString Session = GetSession(File);
+		TMap<uint32, FString>* Names = SessionNames.Find(Session);
+		if (Names == nullptr)
+		{
+			Names = &SessionNames.Add(Session);
+			LoadNames(Directory, Session, *Names);
+		}
+
+		for (const FCAuditRecord& Record : Records)
+		{
+			if (!Filter.Matches(Record, *Names))
+			{
+				continue;
+			}
+
+			const FString Line = FString::Printf(TEXT("%s,%llu,%s,%s,%s,%s,%s,%s,%d"),
+				*Header.GetTime(Record.Cycles).ToIso8601(), Record.Transaction, LexToString(Record.Op), *GetName(*Names, Record.Owner),
+				*GetEnumName<ECInventoryChangeType>(Record.ChangeType), *GetEnumName<ECItemSlot>(Record.Slot),
+				*GetName(*Names, Record.ItemDescriptor), *GetEnumName<ECItemRarity>(Record.Rarity), Record.QuantityDelta);
+
+			if (!CsvPath.IsEmpty())
+			{
+				Csv += Line;
+				Csv += TEXT("\n");
+			}
+			else if (MatchedRecords < MaxPrinted)
+			{
+				UE_LOG(LogTemp, Display, TEXT("%s"), *Line);
+			}
+
+			NetQuantities.FindOrAdd({GetName(*Names, Record.ItemDescriptor), Record.Op}) += Record.QuantityDelta;
+			++MatchedRecords;
+		}
+	}
+
+	if (ReadFiles == 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("No audit files could be read from %s"), *Path);
+		return 1;
+	}
+
+	if (!CsvPath.IsEmpty() && !FFileHelper::SaveStringToFile(Csv, *CsvPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Couldn't write %s"), *CsvPath);
+		return 1;
+	}
+
+	if (bSummary)
+	{
+		// Equipping and moving items around nets out to zero, anything else that doesn't is worth a look
+		NetQuantities.KeySort([](const TPair<FString, ECAuditOp>& A, const TPair<FString, ECAuditOp>& B) { return A.Key != B.Key ? A.Key < B.Key : A.Value < B.Value; });
+
+		for (const auto& Pair : NetQuantities)
+		{
+			UE_LOG(LogTemp, Display, TEXT("  %-60s %-8s %+lld"), *Pair.Key.Key, LexToString(Pair.Key.Value), Pair.Value);
+		}
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("%lld of %lld records in %d files matched"), MatchedRecords, TotalRecords, ReadFiles);
+	return 0;
+}
@@ -0,0 +1,29 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <Commandlets/Commandlet.h>
+#include <CoreMinimal.h>
+
+#include "InventoryAuditCommandlet.generated.h"
+
+/**
+ * Reads the audit files written by FCAuditLog, for looking into duplication and fraud offline.
+ * Prints every record that passes the filters or writes them to a CSV, -Summary adds the net quantity of every item per operation
+ * so items that came out of nowhere stand out.
+ *
+ * UnrealEditor-Cmd <Project> -run=InventoryAudit -unattended
+ *     [-Path=Saved/Audit|File.audit] [-Owner=NameOrId] [-Item=PathOrId] [-Transaction=Id] [-Op=Trade] [-Csv=Path.csv] [-Max=1000] [-Summary]
+ *
+ * Owner and item filters match any part of the name. Returns 1 if nothing could be read.
+ */
+UCLASS()
+class UCInventoryAuditCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCInventoryAuditCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
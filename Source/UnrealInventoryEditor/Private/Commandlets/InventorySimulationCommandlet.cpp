@@ -0,0 +1,552 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Commandlets/InventorySimulationCommandlet.h"
+
+#include "InventoryComponent.h"
+#include "Item.h"
+#include "ItemDataAsset.h"
+#include "ItemRandom.h"
+#include "LootTable.h"
+#include "NetProfiler.h"
+
+#include <AssetRegistry/AssetRegistryModule.h>
+#include <Engine/Engine.h>
+#include <Engine/World.h>
+#include <EngineUtils.h>
+
+namespace UnrealInventory
+{
+	namespace Simulation
+	{
+		/** Only the first violations are logged, the rest are only counted. */
+		static constexpr int32 MaxReportedViolations = 50;
+	};
+};
+
+enum class ECSimulationOp : uint8
+{
+	Add,
+	Drop,
+	Trade,
+	Equip,
+
+	MAX
+};
+
+static const TCHAR* GSimulationOpNames[] = {TEXT("Add"), TEXT("Drop"), TEXT("Trade"), TEXT("Equip")};
+
+/**
+ * Runs the simulation, kept out of the commandlet so none of this state has to be reflected.
+ */
+class FCInventorySimulation
+{
+public:
+	FCInventorySimulation(UWorld* World, TArray<UCItemDescriptorBase*>&& Descriptors, const int32 Seed)
+		: m_World(World), m_Descriptors(MoveTemp(Descriptors)), m_Seed(Seed), m_Stream(Seed)
+	{
+	}
+
+	void SpawnOwners(const int32 Count)
+	{
+		m_Owners.Reserve(Count);
+
+		for (int32 i = 0; i < Count; ++i)
+		{
+			AActor* Owner = m_World->SpawnActor<AActor>();
+
+			UCInventoryComponent* Inventory = NewObject<UCInventoryComponent>(Owner);
+			Inventory->RegisterComponent();
+
+			m_Owners.AddDefaulted_GetRef().Inventory = Inventory;
+		}
+	}
+
+	void Run(const int32 Ticks, const float TickRate, const int32 OpsPerTick, const int32 CheckEvery, const FCAliasTable& OpTable)
+	{
+		const float DeltaTime = 1.0f / TickRate;
+		const double StartTime = FPlatformTime::Seconds();
+
+		for (int32 Tick = 0; Tick < Ticks; ++Tick)
+		{
+			for (int32 i = 0; i < OpsPerTick; ++i)
+			{
+				const ECSimulationOp Op = static_cast<ECSimulationOp>(OpTable.Sample(m_Stream));
+				FCSimulationOwner& Owner = m_Owners[m_Stream.RandHelper(m_Owners.Num())];
+
+				const double OpStartTime = FPlatformTime::Seconds();
+				const bool bSuccess = RunOp(Op, Owner);
+
+				FCOpStats& Stats = m_OpStats[static_cast<uint8>(Op)];
+				Stats.Seconds += FPlatformTime::Seconds() - OpStartTime;
+				++Stats.Attempts;
+				Stats.Successes += bSuccess ? 1 : 0;
+			}
+
+			// Flushes the pending changes the same way a real frame would
+			m_World->Tick(LEVELTICK_All, DeltaTime);
+
+			// Replication would run once per frame so only what changed since the last frame is sent
+			for (FCSimulationOwner& Owner : m_Owners)
+			{
+				Owner.ReplicatedBits += EstimateReplicatedBits(Owner);
+			}
+
+			if ((Tick + 1) % CheckEvery == 0 || Tick == Ticks - 1)
+			{
+				CheckInvariants(Tick);
+			}
+		}
+
+		Report(Ticks, DeltaTime, FPlatformTime::Seconds() - StartTime);
+	}
+
+	int32 GetViolationCount() const { return m_ViolationCount; }
+
+private:
+	struct FCSimulationOwner
+	{
+		UCInventoryComponent* Inventory = nullptr;
+
+		/** What the owning connection was last sent. */
+		TArray<FCItem> ReplicatedInventory;
+		TArray<FCItem> ReplicatedEquippables;
+
+		int64 ReplicatedBits = 0;
+	};
+
+	struct FCOpStats
+	{
+		int64 Attempts = 0;
+		int64 Successes = 0;
+		double Seconds = 0.0;
+	};
+
+	bool RunOp(const ECSimulationOp Op, FCSimulationOwner& Owner)
+	{
+		UCInventoryComponent* Inventory = Owner.Inventory;
+		const TArray<FCItem>& Items = Inventory->GetInventory();
+
+		switch (Op)
+		{
+		case ECSimulationOp::Add:
+		{
+			UCItemDescriptorBase* Descriptor = m_Descriptors[m_Stream.RandHelper(m_Descriptors.Num())];
+
+			FCItem Item;
+			Item.ItemDescriptor = Descriptor;
+			Item.Quantity = m_Stream.RandRange(1, FMath::Max(1, Descriptor->GetStackSize()));
+			Item.Rarity = static_cast<ECItemRarity>(m_Stream.RandHelper(static_cast<int32>(ECItemRarity::MAX)));
+
+			if (Descriptor->GetStackSize() <= 1)
+			{
+				Item.GenerateScore(UnrealInventory::Random::Hash(static_cast<uint32>(m_Seed), m_GeneratedItemCount++));
+			}
+
+			if (!Inventory->AddItem(Item))
+			{
+				return false;
+			}
+
+			m_ExpectedQuantities.FindOrAdd(Descriptor) += Item.Quantity;
+			return true;
+		}
+		case ECSimulationOp::Drop:
+		{
+			if (Items.Num() == 0)
+			{
+				return false;
+			}
+
+			FCItem Item = Items[m_Stream.RandHelper(Items.Num())];
+			return Inventory->DropItem(Item, m_Stream.RandRange(1, Item.Quantity));
+		}
+		case ECSimulationOp::Trade:
+		{
+			if (Items.Num() == 0 || m_Owners.Num() < 2)
+			{
+				return false;
+			}
+
+			UCInventoryComponent* Receiver = m_Owners[m_Stream.RandHelper(m_Owners.Num())].Inventory;
+			if (Receiver == Inventory)
+			{
+				return false;
+			}
+
+			const FCItem Item = Items[m_Stream.RandHelper(Items.Num())];
+			return Inventory->TradeItems({Item}, Receiver);
+		}
+		case ECSimulationOp::Equip:
+		{
+			if (Items.Num() == 0)
+			{
+				return false;
+			}
+
+			const FCItem Item = Items[m_Stream.RandHelper(Items.Num())];
+
+			TArray<ECItemSlot, TInlineAllocator<static_cast<uint8>(ECItemSlot::MAX)>> Slots;
+			for (const ECItemSlot Slot : TEnumRange<ECItemSlot>())
+			{
+				if ((Item.ItemDescriptor->GetItemSlot() & (1 << static_cast<int32>(Slot))) != 0)
+				{
+					Slots.Add(Slot);
+				}
+			}
+
+			if (Slots.Num() == 0 || !Inventory->AddItem(Item, Slots[m_Stream.RandHelper(Slots.Num())]))
+			{
+				return false;
+			}
+
+			// The item is equipped now so take it out of the inventory, whatever was in the slot before has been moved into the inventory
+			return Inventory->RemoveItem(Item, Item.Quantity);
+		}
+		default:
+			return false;
+		}
+	}
+
+	int64 EstimateReplicatedBits(FCSimulationOwner& Owner)
+	{
+		static const FName OwnerName(TEXT("Simulation"));
+		static const FName InventoryName(TEXT("m_Inventory"));
+		static const FName EquippableInventoryName(TEXT("m_EquippableInventory"));
+
+		TArray<FCItem, TInlineAllocator<static_cast<uint8>(ECItemSlot::MAX)>> Equippables;
+		for (uint8 Slot = 0; Slot < static_cast<uint8>(ECItemSlot::MAX); ++Slot)
+		{
+			Equippables.Add(Owner.Inventory->GetEquippableItemBySlot(static_cast<ECItemSlot>(Slot)));
+		}
+
+		FCNetProfiler& Profiler = FCNetProfiler::Get();
+		return Profiler.ProfileItems(OwnerName, InventoryName, Owner.Inventory->GetInventory(), Owner.ReplicatedInventory, true)
+			+ Profiler.ProfileItems(OwnerName, EquippableInventoryName, Equippables, Owner.ReplicatedEquippables, false);
+	}
+
+	void CheckInvariants(const int32 Tick)
+	{
+		TMap<const UCItemDescriptorBase*, int64> ActualQuantities;
+		TSet<TPair<const UCItemDescriptorBase*, int32>> SeenSeeds;
+
+		const auto CheckItem = [this, Tick, &ActualQuantities, &SeenSeeds](const FCItem& Item, const int32 OwnerIndex, const TCHAR* Where)
+		{
+			if (Item.ItemDescriptor == nullptr)
+			{
+				ReportViolation(Tick, FString::Printf(TEXT("Owner %d has an item without a descriptor in %s"), OwnerIndex, Where));
+				return;
+			}
+
+			if (Item.Quantity <= 0)
+			{
+				ReportViolation(Tick, FString::Printf(TEXT("Owner %d has %d of %s in %s"), OwnerIndex, Item.Quantity, *Item.ItemDescriptor->GetName(), Where));
+			}
+			else if (Item.Quantity > FMath::Max(1, Item.ItemDescriptor->GetStackSize()))
+			{
+				ReportViolation(Tick, FString::Printf(TEXT("Owner %d has a stack of %d %s in %s which is over the stack size of %d"), OwnerIndex, Item.Quantity, *Item.ItemDescriptor->GetName(), Where, Item.ItemDescriptor->GetStackSize()));
+			}
+
+			ActualQuantities.FindOrAdd(Item.ItemDescriptor) += Item.Quantity;
+
+			// Generated items are unique so the same seed showing up twice means the item was duplicated
+			if (Item.Seed != 0)
+			{
+				bool bAlreadySeen = false;
+				SeenSeeds.Add({Item.ItemDescriptor, Item.Seed}, &bAlreadySeen);
+
+				if (bAlreadySeen)
+				{
+					ReportViolation(Tick, FString::Printf(TEXT("Owner %d has a duplicate of the unique %s with seed %d in %s"), OwnerIndex, *Item.ItemDescriptor->GetName(), Item.Seed, Where));
+				}
+			}
+		};
+
+		for (int32 OwnerIndex = 0; OwnerIndex < m_Owners.Num(); ++OwnerIndex)
+		{
+			const UCInventoryComponent* Inventory = m_Owners[OwnerIndex].Inventory;
+
+			float Weight = 0.0f;
+			for (const FCItem& Item : Inventory->GetInventory())
+			{
+				CheckItem(Item, OwnerIndex, TEXT("the inventory"));
+				Weight += Item.ItemDescriptor != nullptr ? Item.GetTotalWeight() : 0.0f;
+			}
+
+			for (const ECItemSlot Slot : TEnumRange<ECItemSlot>())
+			{
+				const FCItem& Equipped = Inventory->GetEquippableItemBySlot(Slot);
+				if (Equipped.ItemDescriptor != nullptr)
+				{
+					CheckItem(Equipped, OwnerIndex, *UEnum::GetValueAsString(Slot));
+				}
+			}
+
+			if (!FMath::IsNearlyEqual(Weight, Inventory->GetTotalWeight(), 0.01f))
+			{
+				ReportViolation(Tick, FString::Printf(TEXT("Owner %d has a cached weight of %.2f but the items weigh %.2f"), OwnerIndex, Inventory->GetTotalWeight(), Weight));
+			}
+		}
+
+		// Pickups count towards the total until they're cleaned up here so the world doesn't fill up
+		TMap<const UCItemDescriptorBase*, int64> PickupQuantities;
+		for (TActorIterator<ACItemActor> It(m_World); It; ++It)
+		{
+			if (It->GetQuantity() <= 0)
+			{
+				ReportViolation(Tick, FString::Printf(TEXT("A pickup of %s was dropped with a quantity of %d"), *GetNameSafe(It->GetItemDescriptor()), It->GetQuantity()));
+			}
+
+			PickupQuantities.FindOrAdd(It->GetItemDescriptor()) += It->GetQuantity();
+			It->Destroy();
+		}
+
+		for (const auto& Pair : PickupQuantities)
+		{
+			ActualQuantities.FindOrAdd(Pair.Key) += Pair.Value;
+		}
+
+		for (const auto& Pair : ActualQuantities)
+		{
+			m_ExpectedQuantities.FindOrAdd(Pair.Key);
+		}
+
+		for (auto& Pair : m_ExpectedQuantities)
+		{
+			const int64 Actual = ActualQuantities.FindRef(Pair.Key);
+			if (Actual > Pair.Value)
+			{
+				ReportViolation(Tick, FString::Printf(TEXT("%lld of %s were duplicated"), Actual - Pair.Value, *GetNameSafe(Pair.Key)));
+			}
+			else if (Actual < Pair.Value)
+			{
+				ReportViolation(Tick, FString::Printf(TEXT("%lld of %s were lost"), Pair.Value - Actual, *GetNameSafe(Pair.Key)));
+			}
+
+			// Start from what's actually there so one bad op isn't reported on every check after it
+			Pair.Value = Actual - PickupQuantities.FindRef(Pair.Key);
+		}
+	}
+
+	void ReportViolation(const int32 Tick, const FString& Message)
+	{
+		if (m_ViolationCount++ < UnrealInventory::Simulation::MaxReportedViolations)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Tick %d: %s"), Tick, *Message);
+		}
+	}
+
+	void Report(const int32 Ticks, const float DeltaTime, const double WallTime) const
+	{
+		int64 TotalOps = 0;
+		double OpSeconds = 0.0;
+
+		UE_LOG(LogTemp, Display, TEXT("Inventory simulation: %d owners, %d ticks, seed %d"), m_Owners.Num(), Ticks, m_Seed);
+
+		for (int32 i = 0; i < static_cast<int32>(ECSimulationOp::MAX); ++i)
+		{
+			const FCOpStats& Stats = m_OpStats[i];
+			TotalOps += Stats.Attempts;
+			OpSeconds += Stats.Seconds;
+
+			UE_LOG(LogTemp, Display, TEXT("  %-6s %10lld attempted %10lld succeeded %8.2f us per op"), GSimulationOpNames[i], Stats.Attempts, Stats.Successes, Stats.Attempts > 0 ? Stats.Seconds * 1e6 / Stats.Attempts : 0.0);
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("  %lld ops in %.3f s of op time, %.0f ops per second (%.3f s wall time including world ticks)"), TotalOps, OpSeconds, OpSeconds > 0.0 ? TotalOps / OpSeconds : 0.0, WallTime);
+
+		// The inventory only replicates to its owner so every owner is one connection
+		const double SimulatedSeconds = Ticks * DeltaTime;
+
+		int64 TotalBits = 0;
+		int64 MaxBits = 0;
+		for (const FCSimulationOwner& Owner : m_Owners)
+		{
+			TotalBits += Owner.ReplicatedBits;
+			MaxBits = FMath::Max(MaxBits, Owner.ReplicatedBits);
+		}
+
+		const double AverageBytesPerSecond = m_Owners.Num() > 0 && SimulatedSeconds > 0.0 ? TotalBits / 8.0 / m_Owners.Num() / SimulatedSeconds : 0.0;
+		const double MaxBytesPerSecond = SimulatedSeconds > 0.0 ? MaxBits / 8.0 / SimulatedSeconds : 0.0;
+
+		UE_LOG(LogTemp, Display, TEXT("  Replication: %.1f KB in total, %.1f bytes/s per connection on average, %.1f bytes/s for the busiest connection"), TotalBits / 8.0 / 1024.0, AverageBytesPerSecond, MaxBytesPerSecond);
+		UE_LOG(LogTemp, Display, TEXT("  Invariant violations: %d"), m_ViolationCount);
+	}
+
+	UWorld* m_World = nullptr;
+
+	TArray<UCItemDescriptorBase*> m_Descriptors;
+	TArray<FCSimulationOwner> m_Owners;
+
+	const int32 m_Seed = 0;
+	FRandomStream m_Stream;
+	uint32 m_GeneratedItemCount = 0;
+
+	/** How much of each item should exist according to the ops that succeeded. */
+	TMap<const UCItemDescriptorBase*, int64> m_ExpectedQuantities;
+
+	FCOpStats m_OpStats[static_cast<uint8>(ECSimulationOp::MAX)];
+	int32 m_ViolationCount = 0;
+};
+
+static void LoadDescriptors(const FString& Params, TArray<UCItemDescriptorBase*>& OutDescriptors)
+{
+	FString ItemPaths;
+	if (FParse::Value(*Params, TEXT("Items="), ItemPaths, false))
+	{
+		TArray<FString> Paths;
+		ItemPaths.ParseIntoArray(Paths, TEXT(","));
+
+		for (const FString& Path : Paths)
+		{
+			if (UCItemDescriptorBase* Descriptor = LoadObject<UCItemDescriptorBase>(nullptr, *Path))
+			{
+				OutDescriptors.Add(Descriptor);
+			}
+			else
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Couldn't load item descriptor %s"), *Path);
+			}
+		}
+
+		return;
+	}
+
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	AssetRegistry.SearchAllAssets(true);
+
+	TArray<FAssetData> Assets;
+	AssetRegistry.GetAssetsByClass(UCItemDescriptorBase::StaticClass()->GetClassPathName(), Assets, true);
+
+	for (const FAssetData& Asset : Assets)
+	{
+		if (UCItemDescriptorBase* Descriptor = Cast<UCItemDescriptorBase>(Asset.GetAsset()))
+		{
+			OutDescriptors.Add(Descriptor);
+		}
+	}
+}
+
+static void ParseOpMix(const FString& Params, float (&OutWeights)[static_cast<uint8>(ECSimulationOp::MAX)])
+{
+	FString Mix;
+	if (!FParse::Value(*Params, TEXT("Mix="), Mix, false))
+	{
+		return;
+	}
+
+	FMemory::Memzero(OutWeights);
+
+	TArray<FString> Entries;
+	Mix.ParseIntoArray(Entries, TEXT(","));
+
+	for (const FString& Entry : Entries)
+	{
+		FString Name;
+		FString Weight;
+		if (!Entry.Split(TEXT(":"), &Name, &Weight))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Ignoring %s in -Mix, expected Op:Weight"), *Entry);
+			continue;
+		}
+
+		bool bFound = false;
+		for (int32 i = 0; i < static_cast<int32>(ECSimulationOp::MAX); ++i)
+		{
+			if (Name.Equals(GSimulationOpNames[i], ESearchCase::IgnoreCase))
+			{
+				OutWeights[i] = FMath::Max(0.0f, FCString::Atof(*Weight));
+				bFound = true;
+			}
+		}
+
+		if (!bFound)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Unknown op %s in -Mix"), *Name);
+		}
+	}
+}
+
+UCInventorySimulationCommandlet::UCInventorySimulationCommandlet()
+{
+	IsClient = false;
+	IsServer = true;
+	IsEditor = true;
+	LogToConsole = true;
+	ShowErrorCount = true;
+}
+
+int32 UCInventorySimulationCommandlet::Main(const FString& Params)
+{
+	int32 Owners = 64;
+	int32 Ticks = 600;
+	float TickRate = 30.0f;
+	int32 OpsPerTick = 256;
+	int32 Seed = 1;
+	int32 CheckEvery = 30;
+
+	FParse::Value(*Params, TEXT("Owners="), Owners);
+	FParse::Value(*Params, TEXT("Ticks="), Ticks);
+	FParse::Value(*Params, TEXT("TickRate="), TickRate);
+	FParse::Value(*Params, TEXT("OpsPerTick="), OpsPerTick);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	FParse::Value(*Params, TEXT("CheckEvery="), CheckEvery);
+
+	if (Owners < 1 || Ticks < 1 || TickRate <= 0.0f || OpsPerTick < 0 || CheckEvery < 1)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Owners, Ticks, TickRate and CheckEvery have to be positive"));
+		return 1;
+	}
+
+	float OpWeights[static_cast<uint8>(ECSimulationOp::MAX)] = {40.0f, 10.0f, 30.0f, 20.0f};
+	ParseOpMix(Params, OpWeights);
+
+	FCAliasTable OpTable;
+	OpTable.Build(MakeArrayView(OpWeights));
+
+	if (!OpTable.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("At least one op needs a weight above 0"));
+		return 1;
+	}
+
+	TArray<UCItemDescriptorBase*> Descriptors;
+	LoadDescriptors(Params, Descriptors);
+
+	if (Descriptors.Num() == 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("No item descriptors to simulate with"));
+		return 1;
+	}
+
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("InventorySimulation"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	World->InitializeActorsForPlay(FURL());
+	World->BeginPlay();
+
+	FString NetProfilePath;
+	FParse::Value(*Params, TEXT("NetProfile="), NetProfilePath);
+
+	// Every owner is its own connection
+	FCNetProfiler::Get().Reset();
+	FCNetProfiler::Get().SampleConnections(Owners);
+
+	int32 ViolationCount = 0;
+	{
+		FCInventorySimulation Simulation(World, MoveTemp(Descriptors), Seed);
+		Simulation.SpawnOwners(Owners);
+		Simulation.Run(Ticks, TickRate, OpsPerTick, CheckEvery, OpTable);
+
+		ViolationCount = Simulation.GetViolationCount();
+	}
+
+	if (!NetProfilePath.IsEmpty() && !FCNetProfiler::Get().Write(NetProfilePath, NetProfilePath.EndsWith(TEXT(".json"))))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Couldn't write the net profile to %s"), *NetProfilePath);
+	}
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+
+	return ViolationCount > 0 ? 1 : 0;
+}
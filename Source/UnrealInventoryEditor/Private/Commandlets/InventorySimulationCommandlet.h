@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <Commandlets/Commandlet.h>
+#include <CoreMinimal.h>
+
+#include "InventorySimulationCommandlet.generated.h"
+
+/**
+ * Headless load test for the inventory. Spawns a number of owners in an empty world, runs a seeded mix of adds, drops, trades and equip swaps against them
+ * and reports the throughput, an estimate of the replication bytes each owning connection would receive and every invariant that was broken.
+ * Nothing but a null RHI is needed so it runs fine on a Linux server.
+ *
+ * UnrealEditor-Cmd <Project> -run=InventorySimulation -nullrhi -unattended
+ *     [-Owners=64] [-Ticks=600] [-TickRate=30] [-OpsPerTick=256] [-Seed=1] [-CheckEvery=30]
+ *     [-Mix=Add:40,Drop:10,Trade:30,Equip:20] [-Items=/Game/Items/Sword,/Game/Items/Arrow] [-NetProfile=Path.csv|Path.json]
+ *
+ * Every item descriptor in the project is used unless -Items is given. Returns 1 if an invariant was broken.
+ */
+UCLASS()
+class UCInventorySimulationCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCInventorySimulationCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,103 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Commandlets/InventoryValidationCommandlet.h"
+
+#include "ItemDataAsset.h"
+
+#include <AssetRegistry/AssetRegistryModule.h>
+#include <Async/ParallelFor.h>
+
+UCInventoryValidationCommandlet::UCInventoryValidationCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+	ShowErrorCount = true;
+}
+
+int32 UCInventoryValidationCommandlet::Main(const FString& Params)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	AssetRegistry.SearchAllAssets(true);
+
+	FARFilter Filter;
+	Filter.ClassPaths.Add(UCItemDescriptorBase::StaticClass()->GetClassPathName());
+	Filter.bRecursiveClasses = true;
+
+	FString Path;
+	if (FParse::Value(*Params, TEXT("Path="), Path))
+	{
+		Filter.PackagePaths.Add(*Path);
+		Filter.bRecursivePaths = true;
+	}
+
+	TArray<FAssetData> Assets;
+	AssetRegistry.GetAssets(Filter, Assets);
+
+	TArray<TArray<FText>> Errors;
+	Errors.SetNum(Assets.Num());
+
+	// Tags are only read here, the registry is safe to read from any thread once the search is done
+	TArray<bool> NeedsLoad;
+	NeedsLoad.SetNumZeroed(Assets.Num());
+
+	ParallelFor(Assets.Num(), [&Assets, &Errors, &NeedsLoad](const int32 Index)
+	{
+		FCItemDescriptorSummary Summary;
+		if (Summary.Read(Assets[Index]))
+		{
+			Summary.Validate(Errors[Index]);
+		}
+		else
+		{
+			NeedsLoad[Index] = true;
+		}
+	});
+
+	// Loading has to happen on the game thread
+	int32 LoadedCount = 0;
+	for (int32 i = 0; i < Assets.Num(); ++i)
+	{
+		if (!NeedsLoad[i])
+		{
+			continue;
+		}
+
+		if (const UCItemDescriptorBase* Descriptor = Cast<UCItemDescriptorBase>(Assets[i].GetAsset()))
+		{
+			FCItemDescriptorSummary(*Descriptor).Validate(Errors[i]);
+			++LoadedCount;
+		}
+		else
+		{
+			Errors[i].Add(FText::FromString(TEXT("Couldn't be loaded")));
+		}
+	}
+
+	int32 InvalidCount = 0;
+	for (int32 i = 0; i < Assets.Num(); ++i)
+	{
+		if (Errors[i].Num() == 0)
+		{
+			continue;
+		}
+
+		++InvalidCount;
+		for (const FText& Error : Errors[i])
+		{
+			UE_LOG(LogTemp, Error, TEXT("%s: %s"), *Assets[i].GetObjectPathString(), *Error.ToString());
+		}
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Validated %d item descriptors in %.2fs, %d are invalid"), Assets.Num(), FPlatformTime::Seconds() - StartTime, InvalidCount);
+
+	if (LoadedCount > 0)
+	{
+		UE_LOG(LogTemp, Display, TEXT("%d descriptors had to be loaded because they're missing the validation tags, resave them to skip loading next time"), LoadedCount);
+	}
+
+	return InvalidCount > 0 ? 1 : 0;
+}
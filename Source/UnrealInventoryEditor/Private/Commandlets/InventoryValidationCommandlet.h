@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <Commandlets/Commandlet.h>
+#include <CoreMinimal.h>
+
+#include "InventoryValidationCommandlet.generated.h"
+
+/**
+ * Validates every item descriptor in the project in one go and reports all of the errors at the end.
+ * The checks run in parallel on the asset registry tags so assets are only loaded if they were saved before the tags existed, resave those to keep it fast.
+ *
+ * UnrealEditor-Cmd <Project> -run=InventoryValidation -unattended [-Path=/Game/Items]
+ *
+ * Returns 1 if any descriptor is invalid.
+ */
+UCLASS()
+class UCInventoryValidationCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCInventoryValidationCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -38,6 +38,7 @@ public class UnrealInventoryEditor : ModuleRules
 				"InputCore",
 				"UnrealEd",
 				"AssetTools",
+				"AssetRegistry",
 				"CoreUObject",
 				"Engine",
 				"Slate",
@@ -0,0 +1,145 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "MassPickupProcessor.h"
+
+#include "Item.h"
+#include "ItemDataAsset.h"
+#include "MassPickupFragments.h"
+#include "MassPickupSubsystem.h"
+
+#include <Engine/World.h>
+#include <GameFramework/Pawn.h>
+#include <GameFramework/PlayerController.h>
+#include <MassCommandBuffer.h>
+#include <MassCommonFragments.h>
+#include <MassExecutionContext.h>
+
+static FIntVector GetCell(const FVector& Location, const float CellSize)
+{
+	return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize), FMath::FloorToInt(Location.Z / CellSize));
+}
+
+static double GetClosestDistanceSquared(const FVector& Location, const TArray<FVector>& PlayerLocations)
+{
+	double ClosestDistanceSquared = TNumericLimits<double>::Max();
+	for (const FVector& PlayerLocation : PlayerLocations)
+	{
+		ClosestDistanceSquared = FMath::Min(ClosestDistanceSquared, FVector::DistSquared(Location, PlayerLocation));
+	}
+
+	return ClosestDistanceSquared;
+}
+
+UCPickupPromotionProcessor::UCPickupPromotionProcessor()
+	: m_EntityQuery(*this)
+{
+	// Entities only exist on the server and actors can only be spawned on the game thread
+	ExecutionFlags = static_cast<int32>(EProcessorExecutionFlags::Server | EProcessorExecutionFlags::Standalone);
+	ProcessingPhase = EMassProcessingPhase::PrePhysics;
+	bRequiresGameThreadExecution = true;
+}
+
+void UCPickupPromotionProcessor::ConfigureQueries()
+{
+	m_EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite);
+	m_EntityQuery.AddRequirement<FCPickupItemFragment>(EMassFragmentAccess::ReadWrite);
+	m_EntityQuery.AddRequirement<FCPickupActorFragment>(EMassFragmentAccess::ReadWrite);
+}
+
+void UCPickupPromotionProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	UWorld* World = EntityManager.GetWorld();
+	UCMassPickupSubsystem* Subsystem = World != nullptr ? World->GetSubsystem<UCMassPickupSubsystem>() : nullptr;
+	if (Subsystem == nullptr)
+	{
+		return;
+	}
+
+	const float DemoteRadius = Subsystem->GetDemoteRadius();
+	const double PromoteRadiusSquared = FMath::Square(Subsystem->GetPromoteRadius());
+	const double DemoteRadiusSquared = FMath::Square(DemoteRadius);
+
+	// Anything outside the cells around a player is further away than the demote radius
+	TArray<FVector> PlayerLocations;
+	TSet<FIntVector> NearCells;
+	for (FConstPlayerControllerIterator Iterator = World->GetPlayerControllerIterator(); Iterator; ++Iterator)
+	{
+		const APlayerController* PlayerController = Iterator->Get();
+		const APawn* Pawn = PlayerController != nullptr ? PlayerController->GetPawn() : nullptr;
+		if (Pawn == nullptr)
+		{
+			continue;
+		}
+
+		const FVector Location = Pawn->GetActorLocation();
+		PlayerLocations.Add(Location);
+
+		const FIntVector Cell = GetCell(Location, DemoteRadius);
+		for (int32 X = -1; X <= 1; ++X)
+		{
+			for (int32 Y = -1; Y <= 1; ++Y)
+			{
+				for (int32 Z = -1; Z <= 1; ++Z)
+				{
+					NearCells.Add(Cell + FIntVector(X, Y, Z));
+				}
+			}
+		}
+	}
+
+	int32 PromotionsLeft = Subsystem->GetMaxPromotionsPerFrame();
+
+	m_EntityQuery.ForEachEntityChunk(EntityManager, Context, [&](FMassExecutionContext& ChunkContext)
+	{
+		const TArrayView<FTransformFragment> Transforms = ChunkContext.GetMutableFragmentView<FTransformFragment>();
+		const TArrayView<FCPickupItemFragment> Items = ChunkContext.GetMutableFragmentView<FCPickupItemFragment>();
+		const TArrayView<FCPickupActorFragment> Actors = ChunkContext.GetMutableFragmentView<FCPickupActorFragment>();
+
+		for (int32 Index = 0; Index < ChunkContext.GetNumEntities(); ++Index)
+		{
+			FCPickupActorFragment& ActorFragment = Actors[Index];
+			FCPickupItemFragment& ItemFragment = Items[Index];
+
+			// Released by the subsystem and waiting to be destroyed
+			if (ItemFragment.Item.ItemDescriptor == nullptr)
+			{
+				continue;
+			}
+
+			// The actor was picked up or despawned while it stood in for the entity
+			if (ActorFragment.Actor.IsStale())
+			{
+				Subsystem->ReleasePickupEntity(ItemFragment);
+				ChunkContext.Defer().DestroyEntity(ChunkContext.GetEntity(Index));
+				continue;
+			}
+
+			ACItemActor* Actor = ActorFragment.Actor.Get();
+			const FVector Location = Actor != nullptr ? Actor->GetActorLocation() : Transforms[Index].GetTransform().GetLocation();
+			const double DistanceSquared = NearCells.Contains(GetCell(Location, DemoteRadius)) ? GetClosestDistanceSquared(Location, PlayerLocations) : TNumericLimits<double>::Max();
+
+			if (Actor == nullptr)
+			{
+				if (DistanceSquared > PromoteRadiusSquared || PromotionsLeft <= 0)
+				{
+					continue;
+				}
+
+				ActorFragment.Actor = ACItemActor::SpawnPickup(World, ItemFragment.Item, ItemFragment.Item.Quantity, Transforms[Index].GetTransform());
+				if (ActorFragment.Actor.IsValid())
+				{
+					--PromotionsLeft;
+				}
+			}
+			else if (DistanceSquared > DemoteRadiusSquared)
+			{
+				// Keep whatever changed while the actor was around
+				ItemFragment.Item = Actor->GetItem();
+				Transforms[Index].SetTransform(Actor->GetActorTransform());
+
+				ActorFragment.Actor.Reset();
+				Actor->Destroy();
+			}
+		}
+	});
+}
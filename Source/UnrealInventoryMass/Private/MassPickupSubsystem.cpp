@@ -0,0 +1,219 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "MassPickupSubsystem.h"
+
+#include "Item.h"
+#include "ItemDataAsset.h"
+#include "MassPickupFragments.h"
+#include "PickupSubsystem.h"
+
+#include <Engine/World.h>
+#include <MassCommandBuffer.h>
+#include <MassCommonFragments.h>
+#include <MassEntityManager.h>
+#include <MassEntitySubsystem.h>
+
+namespace UnrealInventory
+{
+	namespace MassPickups
+	{
+		/** The spawn order is compacted once it holds this many more entries than there are entities. */
+		static constexpr int32 SpawnOrderSlack = 256;
+	};
+};
+
+bool UCMassPickupSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	return Super::ShouldCreateSubsystem(Outer) && m_bEnabled;
+}
+
+void UCMassPickupSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	UMassEntitySubsystem* EntitySubsystem = Collection.InitializeDependency<UMassEntitySubsystem>();
+	UCPickupSubsystem* PickupSubsystem = Collection.InitializeDependency<UCPickupSubsystem>();
+	if (EntitySubsystem == nullptr || PickupSubsystem == nullptr)
+	{
+		return;
+	}
+
+	m_PickupArchetype = EntitySubsystem->GetMutableEntityManager().CreateArchetype({
+		FTransformFragment::StaticStruct(),
+		FCPickupItemFragment::StaticStruct(),
+		FCPickupActorFragment::StaticStruct()
+	});
+
+	m_ExpiryBucketSize = FMath::Max(PickupSubsystem->GetExpiryBucketSize(), 0.1f);
+
+	PickupSubsystem->SetSpawnPickupOverride(FCSpawnPickupOverride::CreateUObject(this, &UCMassPickupSubsystem::SpawnPickupEntity));
+}
+
+void UCMassPickupSubsystem::Deinitialize()
+{
+	if (UCPickupSubsystem* PickupSubsystem = GetWorld()->GetSubsystem<UCPickupSubsystem>())
+	{
+		PickupSubsystem->ClearSpawnPickupOverride();
+	}
+
+	Super::Deinitialize();
+}
+
+bool UCMassPickupSubsystem::SpawnPickupEntity(const FCItem& Item, const int32 Quantity, const FTransform& Transform)
+{
+	UWorld* World = GetWorld();
+	UMassEntitySubsystem* EntitySubsystem = World->GetSubsystem<UMassEntitySubsystem>();
+	if (EntitySubsystem == nullptr || !m_PickupArchetype.IsValid() || Item.ItemDescriptor == nullptr || Quantity <= 0)
+	{
+		return false;
+	}
+
+	FMassEntityManager& EntityManager = EntitySubsystem->GetMutableEntityManager();
+	const FMassEntityHandle Entity = EntityManager.CreateEntity(m_PickupArchetype);
+
+	EntityManager.GetFragmentDataChecked<FTransformFragment>(Entity).SetTransform(Transform);
+
+	FCPickupItemFragment& ItemFragment = EntityManager.GetFragmentDataChecked<FCPickupItemFragment>(Entity);
+	ItemFragment.Item = Item;
+	ItemFragment.Item.Quantity = Quantity;
+
+	++m_Descriptors.FindOrAdd(Item.ItemDescriptor);
+	++m_EntityCount;
+
+	const UCPickupSubsystem* PickupSubsystem = World->GetSubsystem<UCPickupSubsystem>();
+	const float Lifetime = PickupSubsystem != nullptr ? PickupSubsystem->GetPickupLifetime(Item.ItemDescriptor, Item.Rarity) : 0.0f;
+	if (Lifetime > 0.0f)
+	{
+		// Nothing expired while the buckets were empty so there's no need to walk the buckets in between
+		if (m_ExpiryBuckets.Num() == 0)
+		{
+			m_NextExpiryBucket = GetBucket(World->GetTimeSeconds());
+		}
+
+		// Never put an entity in a bucket that has already been processed
+		const int32 Bucket = FMath::Max(GetBucket(World->GetTimeSeconds() + Lifetime), m_NextExpiryBucket);
+		m_ExpiryBuckets.FindOrAdd(Bucket).Add(Entity);
+	}
+
+	// Drop the entries of entities that are already gone once in a while so the spawn order doesn't grow forever
+	if (m_SpawnOrder.Num() - m_SpawnOrderHead > m_EntityCount * 2 + UnrealInventory::MassPickups::SpawnOrderSlack)
+	{
+		m_SpawnOrder.RemoveAt(0, m_SpawnOrderHead, EAllowShrinking::No);
+		m_SpawnOrderHead = 0;
+		m_SpawnOrder.RemoveAll([&EntityManager](const FMassEntityHandle& Entry) { return !EntityManager.IsEntityValid(Entry); });
+	}
+
+	m_SpawnOrder.Add(Entity);
+
+	EnforcePickupCap(EntityManager);
+
+	return true;
+}
+
+void UCMassPickupSubsystem::ReleasePickupEntity(FCPickupItemFragment& ItemFragment)
+{
+	UCItemDescriptorBase* ItemDescriptor = ItemFragment.Item.ItemDescriptor;
+	if (ItemDescriptor == nullptr)
+	{
+		return;
+	}
+
+	ItemFragment.Item.ItemDescriptor = nullptr;
+	--m_EntityCount;
+
+	// The descriptor can be garbage collected again once nothing on the ground uses it
+	int32* UseCount = m_Descriptors.Find(ItemDescriptor);
+	if (UseCount != nullptr && --(*UseCount) <= 0)
+	{
+		m_Descriptors.Remove(ItemDescriptor);
+	}
+}
+
+void UCMassPickupSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	UMassEntitySubsystem* EntitySubsystem = GetWorld()->GetSubsystem<UMassEntitySubsystem>();
+	if (EntitySubsystem == nullptr)
+	{
+		return;
+	}
+
+	FMassEntityManager& EntityManager = EntitySubsystem->GetMutableEntityManager();
+
+	// Destroy everything that expired, the buckets in between are usually empty so this is cheap
+	const int32 CurrentBucket = GetBucket(GetWorld()->GetTimeSeconds());
+
+	for (; m_NextExpiryBucket <= CurrentBucket && m_ExpiryBuckets.Num() > 0; ++m_NextExpiryBucket)
+	{
+		TArray<FMassEntityHandle> Expired;
+		if (m_ExpiryBuckets.RemoveAndCopyValue(m_NextExpiryBucket, Expired))
+		{
+			for (const FMassEntityHandle Entity : Expired)
+			{
+				DestroyPickupEntity(EntityManager, Entity);
+			}
+		}
+	}
+
+	if (m_ExpiryBuckets.Num() == 0)
+	{
+		m_NextExpiryBucket = CurrentBucket + 1;
+	}
+}
+
+TStatId UCMassPickupSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCMassPickupSubsystem, STATGROUP_Tickables);
+}
+
+bool UCMassPickupSubsystem::IsTickable() const
+{
+	return Super::IsTickable() && m_ExpiryBuckets.Num() > 0;
+}
+
+void UCMassPickupSubsystem::DestroyPickupEntity(FMassEntityManager& EntityManager, const FMassEntityHandle Entity)
+{
+	if (!EntityManager.IsEntityValid(Entity))
+	{
+		return;
+	}
+
+	// Already released, it's destroyed with the next deferred commands
+	FCPickupItemFragment& ItemFragment = EntityManager.GetFragmentDataChecked<FCPickupItemFragment>(Entity);
+	if (ItemFragment.Item.ItemDescriptor == nullptr)
+	{
+		return;
+	}
+
+	// A promoted entity takes its actor with it, the actor's own lifetime started later so it never expires first
+	if (ACItemActor* Actor = EntityManager.GetFragmentDataChecked<FCPickupActorFragment>(Entity).Actor.Get())
+	{
+		Actor->Destroy();
+	}
+
+	ReleasePickupEntity(ItemFragment);
+
+	// Mass may be in the middle of processing, so the entity only goes once the deferred commands are flushed
+	EntityManager.Defer().DestroyEntity(Entity);
+}
+
+void UCMassPickupSubsystem::EnforcePickupCap(FMassEntityManager& EntityManager)
+{
+	const UCPickupSubsystem* PickupSubsystem = GetWorld()->GetSubsystem<UCPickupSubsystem>();
+	const int32 MaxPickups = PickupSubsystem != nullptr ? PickupSubsystem->GetMaxPickups() : 0;
+	if (MaxPickups <= 0)
+	{
+		return;
+	}
+
+	while (m_EntityCount > MaxPickups && m_SpawnOrderHead < m_SpawnOrder.Num())
+	{
+		DestroyPickupEntity(EntityManager, m_SpawnOrder[m_SpawnOrderHead++]);
+	}
+}
+
+bool UCMassPickupSubsystem::DoesSupportWorldType(EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
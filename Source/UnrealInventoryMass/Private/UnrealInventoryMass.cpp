@@ -0,0 +1,17 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "UnrealInventoryMass.h"
+
+#define LOCTEXT_NAMESPACE "FUnrealInventoryMassModule"
+
+void FUnrealInventoryMassModule::StartupModule()
+{
+}
+
+void FUnrealInventoryMassModule::ShutdownModule()
+{
+}
+
+#undef LOCTEXT_NAMESPACE
+
+IMPLEMENT_MODULE(FUnrealInventoryMassModule, UnrealInventoryMass)
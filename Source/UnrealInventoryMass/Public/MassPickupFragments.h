@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ItemDataAsset.h"
+
+#include <CoreMinimal.h>
+#include <MassEntityTypes.h>
+
+#include "MassPickupFragments.generated.h"
+
+class ACItemActor;
+
+/** What's lying on the ground, the descriptor is kept alive by UCMassPickupSubsystem until the entity is released. */
+USTRUCT()
+struct UNREALINVENTORYMASS_API FCPickupItemFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	/** The whole item including its quantity, null once the entity was released and is about to be destroyed. */
+	FCItem Item;
+};
+
+/** The actor standing in for the entity while a player is close, null while the entity isn't promoted. */
+USTRUCT()
+struct UNREALINVENTORYMASS_API FCPickupActorFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	/** Stale once the actor is picked up or despawned, the entity is then destroyed as well. */
+	TWeakObjectPtr<ACItemActor> Actor;
+};
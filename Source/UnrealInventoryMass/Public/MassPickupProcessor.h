@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <CoreMinimal.h>
+#include <MassEntityQuery.h>
+#include <MassProcessor.h>
+
+#include "MassPickupProcessor.generated.h"
+
+/**
+ * Promotes pickup entities to ACItemActors when a player comes close and demotes them again once every player has left, see UCMassPickupSubsystem.
+ * Players are bucketed into cells as large as the demote radius so entities that aren't next to a player are rejected with a single lookup.
+ * Entities whose actor was picked up or despawned are destroyed.
+ */
+UCLASS()
+class UNREALINVENTORYMASS_API UCPickupPromotionProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UCPickupPromotionProcessor();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+private:
+	FMassEntityQuery m_EntityQuery;
+};
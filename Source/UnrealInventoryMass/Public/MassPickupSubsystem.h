@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <CoreMinimal.h>
+#include <MassArchetypeTypes.h>
+#include <MassEntityTypes.h>
+#include <Subsystems/WorldSubsystem.h>
+
+#include "MassPickupSubsystem.generated.h"
+
+class UCItemDescriptorBase;
+struct FCItem;
+struct FCPickupItemFragment;
+struct FMassEntityManager;
+
+/**
+ * Keeps dropped items as Mass entities instead of ACItemActors. An entity is a transform and a few bytes of item data, not a replicated actor with components,
+ * so a server can hold hundreds of thousands of them. UCPickupPromotionProcessor turns an entity into a real pickup actor once a player comes within
+ * Promote Radius and back into an entity once every player is further than Demote Radius.
+ * Only created when Enabled is set under [/Script/UnrealInventoryMass.CMassPickupSubsystem] in the game ini, pickups are plain actors otherwise.
+ * Entities expire after the lifetime UCPickupSubsystem gives their item and the oldest are destroyed once there are more than its Max Pickups,
+ * using the same expiry buckets so a frame only costs as much as the entities that expire during it.
+ */
+UCLASS(Config = Game)
+class UNREALINVENTORYMASS_API UCMassPickupSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** Spawn a pickup for the item as an entity, it's promoted to an actor once a player comes close. */
+	bool SpawnPickupEntity(const FCItem& Item, const int32 Quantity, const FTransform& Transform);
+
+	/** Let go of the item of an entity that's about to be destroyed, every path that destroys a pickup entity has to call this once. */
+	void ReleasePickupEntity(FCPickupItemFragment& ItemFragment);
+
+	float GetPromoteRadius() const { return m_PromoteRadius; }
+	float GetDemoteRadius() const { return FMath::Max(m_DemoteRadius, m_PromoteRadius); }
+	int32 GetMaxPromotionsPerFrame() const { return m_MaxPromotionsPerFrame; }
+
+	int32 GetPickupEntityCount() const { return m_EntityCount; }
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual bool IsTickable() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(EWorldType::Type WorldType) const override;
+
+	UPROPERTY(Config, EditAnywhere, Category = "UnrealInventory|Config", meta = (DisplayName = "Enabled"))
+	bool m_bEnabled = false;
+
+	UPROPERTY(Config, EditAnywhere, Category = "UnrealInventory|Config", meta = (DisplayName = "Promote Radius"))
+	float m_PromoteRadius = 1500.0f;
+
+	/** Larger than Promote Radius so pickups don't flip back and forth when a player stands at the edge. */
+	UPROPERTY(Config, EditAnywhere, Category = "UnrealInventory|Config", meta = (DisplayName = "Demote Radius"))
+	float m_DemoteRadius = 2000.0f;
+
+	/** Spawning actors is expensive, the rest are promoted over the next frames. */
+	UPROPERTY(Config, EditAnywhere, Category = "UnrealInventory|Config", meta = (DisplayName = "Max Promotions Per Frame", ClampMin = "1"))
+	int32 m_MaxPromotionsPerFrame = 64;
+
+private:
+	/** Release and destroy the entity along with the actor standing in for it, if it's still around. */
+	void DestroyPickupEntity(FMassEntityManager& EntityManager, const FMassEntityHandle Entity);
+
+	/** Destroy the oldest entities while there are more than UCPickupSubsystem allows. */
+	void EnforcePickupCap(FMassEntityManager& EntityManager);
+
+	int32 GetBucket(const float Time) const { return FMath::FloorToInt(Time / m_ExpiryBucketSize); }
+
+	FMassArchetypeHandle m_PickupArchetype;
+
+	/** Fragments can't hold references so every descriptor an entity uses is kept alive here, along with how many live entities use it. */
+	UPROPERTY()
+	TMap<UCItemDescriptorBase*, int32> m_Descriptors;
+
+	/** Live entities, the ones released but not destroyed yet don't count. */
+	int32 m_EntityCount = 0;
+
+	/** Copied from UCPickupSubsystem on Initialize. */
+	float m_ExpiryBucketSize = 1.0f;
+
+	/** Entities by the bucket they expire in, entities that are already gone are skipped when the bucket is due. */
+	TMap<int32, TArray<FMassEntityHandle>> m_ExpiryBuckets;
+	int32 m_NextExpiryBucket = 0;
+
+	/** Every entity in the order they were spawned in, consumed from m_SpawnOrderHead. */
+	TArray<FMassEntityHandle> m_SpawnOrder;
+	int32 m_SpawnOrderHead = 0;
+};